@@ -0,0 +1,175 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "analyse.h"
+#include "board.h"
+#include "move.h"
+#include "movegen.h"
+#include "search.h"
+#include "thread.h"
+#include "transposition.h"
+#include "util.h"
+
+// shared by the workers, lines are read one at a time and
+// results are written a whole buffer at a time
+FILE *analyseIn, *analyseOut;
+pthread_mutex_t analyseInLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t analyseOutLock = PTHREAD_MUTEX_INITIALIZER;
+atomic_uint_fast64_t analysed;
+
+// workers done, the progress loop wakes on the last instead of a full sleep
+pthread_mutex_t analyseDoneLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t analyseDone = PTHREAD_COND_INITIALIZER;
+int analyseFinished;
+int analyseNodes, analyseDepth;
+
+void AnalyseFlush(AnalyseJob* job) {
+  pthread_mutex_lock(&analyseOutLock);
+  fwrite(job->buffer, 1, job->len, analyseOut);
+  pthread_mutex_unlock(&analyseOutLock);
+
+  job->len = 0;
+}
+
+void* AnalyseWorker(void* arg) {
+  AnalyseJob* job = (AnalyseJob*)arg;
+
+  // a pool of one, searched from this thread with its own board and tables
+  ThreadData* thread = CreatePool(1);
+  SearchParams params = {0};
+  params.quiet = 1;
+  params.sharedTT = 1;
+  params.nodes = analyseNodes;
+  params.depth = analyseDepth ? analyseDepth : MAX_SEARCH_PLY - 1;
+
+  Board board;
+  Move moves[MAX_MOVES];
+  char line[ANALYSE_LINE];
+
+  for (;;) {
+    pthread_mutex_lock(&analyseInLock);
+    char* read = fgets(line, sizeof(line), analyseIn);
+    pthread_mutex_unlock(&analyseInLock);
+
+    if (!read)
+      break;
+
+    // the fen ends at the first ';' so that book and training lines can be fed back
+    line[strcspn(line, ";\r\n")] = '\0';
+    if (strlen(line) < 8)
+      continue;
+
+    ParseFen(line, &board);
+
+    Move move = NULL_MOVE;
+    int score = board.checkers ? -CHECKMATE : 0;
+
+    if (GenerateLegalMoves(moves, &board)) {
+      params.start = GetTimeMS();
+      params.stopped = 0;
+      score = BestMove(&board, &params, thread);
+      move = thread->data.bestMove;
+    }
+
+    int whiteScore = board.side == WHITE ? score : -score;
+
+    if (job->len + ANALYSE_LINE + 32 > ANALYSE_BUFFER)
+      AnalyseFlush(job);
+
+    job->len += sprintf(job->buffer + job->len, "%s;%s;%d\n", line, move ? MoveToStr(move) : "0000", whiteScore);
+    atomic_fetch_add(&analysed, 1);
+  }
+
+  AnalyseFlush(job);
+  FreePool(thread);
+  pthread_mutex_lock(&analyseDoneLock);
+  analyseFinished++;
+  pthread_cond_signal(&analyseDone);
+  pthread_mutex_unlock(&analyseDoneLock);
+
+  return NULL;
+}
+
+// berserk analyse <fens> depth|nodes <n> [threads] [out]
+// Every worker searches its own positions on a single thread, results are
+// fen;bestmove;score lines with a white relative score, in the order they finish
+void Analyse(char* in, char* out, int threads, int depth, int nodes) {
+  analyseIn = fopen(in, "r");
+  if (analyseIn == NULL) {
+    printf("Unable to open %s\n", in);
+    return;
+  }
+
+  analyseOut = out ? fopen(out, "w") : stdout;
+  if (analyseOut == NULL) {
+    printf("Unable to open %s\n", out);
+    fclose(analyseIn);
+    return;
+  }
+
+  analyseDepth = depth;
+  analyseNodes = depth ? 0 : nodes;
+  atomic_store(&analysed, 0);
+  analyseFinished = 0;
+
+  // unrelated positions share the hash table, as in datagen, but it is never aged
+  TTInit(16 * threads, NULL);
+
+  pthread_t* workers = malloc(sizeof(pthread_t) * threads);
+  AnalyseJob* jobs = calloc(threads, sizeof(AnalyseJob));
+
+  long start = GetTimeMS();
+  for (int i = 0; i < threads; i++)
+    pthread_create(&workers[i], NULL, AnalyseWorker, &jobs[i]);
+
+  // progress is only reported when it cannot mix with the results
+  pthread_mutex_lock(&analyseDoneLock);
+  while (out && analyseFinished < threads) {
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec++;
+
+    if (!pthread_cond_timedwait(&analyseDone, &analyseDoneLock, &until))
+      continue;
+
+    uint64_t done = atomic_load(&analysed);
+    long elapsed = max(1, GetTimeMS() - start);
+    printf("Analysed %" PRIu64 " positions (%" PRIu64 "/s)\r", done, 1000 * done / elapsed);
+    fflush(stdout);
+  }
+  pthread_mutex_unlock(&analyseDoneLock);
+
+  for (int i = 0; i < threads; i++)
+    pthread_join(workers[i], NULL);
+
+  fclose(analyseIn);
+  if (out) {
+    fclose(analyseOut);
+    printf("\nAnalysed %" PRIu64 " positions in %ld ms\n", atomic_load(&analysed), GetTimeMS() - start);
+  } else {
+    fflush(stdout);
+  }
+
+  free(jobs);
+  free(workers);
+}
\ No newline at end of file
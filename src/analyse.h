@@ -0,0 +1,34 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef ANALYSE_H
+#define ANALYSE_H
+
+#include "types.h"
+
+#define ANALYSE_LINE 512
+#define ANALYSE_BUFFER 65536 // per worker output, written out whole
+
+typedef struct {
+  size_t len;
+  char buffer[ANALYSE_BUFFER];
+} AnalyseJob;
+
+void Analyse(char* in, char* out, int threads, int depth, int nodes);
+void* AnalyseWorker(void* arg);
+void AnalyseFlush(AnalyseJob* job);
+
+#endif
\ No newline at end of file
@@ -27,6 +27,24 @@
 #include "movegen.h"
 #include "random.h"
 
+// Slider tables are indexed with pext when it is fast and with magics otherwise.
+// A dispatch build decides at startup and writes the instruction out, see bits()
+#if defined(PEXT)
+#define USE_PEXT 1
+#define Pext(bb, mask) _pext_u64(bb, mask)
+#elif defined(DISPATCH)
+#define USE_PEXT CPU.pext
+#define Pext(bb, mask)                                                                                                 \
+  ({                                                                                                                   \
+    BitBoard extracted_;                                                                                               \
+    __asm__("pextq %2, %1, %0" : "=r"(extracted_) : "r"((BitBoard)(bb)), "r"((BitBoard)(mask)));                      \
+    extracted_;                                                                                                        \
+  })
+#else
+#define USE_PEXT 0
+#define Pext(bb, mask) 0
+#endif
+
 // This file was built using all the logic found in the BBC video guide on youtube
 // I highly recommend it to understand how magic bitboards work/generated
 // https://www.youtube.com/channel/UCB9-prLkPwgvlKKqDgXhsMQ/videos
@@ -67,8 +85,46 @@ BitBoard KING_ATTACKS[64];
 BitBoard ROOK_MASKS[64];
 BitBoard BISHOP_MASKS[64];
 
-uint64_t ROOK_MAGICS[64];
-uint64_t BISHOP_MAGICS[64];
+// found once with FindMagicNumber, searching for them made up most of the startup time
+// clang-format off
+const uint64_t ROOK_MAGICS[64] = {
+    0x80800015C0082080ULL, 0x00C0100140002000ULL, 0x0100104009042000ULL, 0x0480080080100004ULL,
+    0x1080040008008002ULL, 0x1200080410020001ULL, 0x030004CA00040500ULL, 0x408000A480004900ULL,
+    0x0422800024904000ULL, 0x6000400050002001ULL, 0x1221002005021240ULL, 0x0000808008001000ULL,
+    0x2050808004000800ULL, 0x0042000200080410ULL, 0x1004000241084410ULL, 0x080200040484690AULL,
+    0x81C0808000284004ULL, 0x09C0018020008040ULL, 0x4000420020801200ULL, 0x4008008010000882ULL,
+    0x8038008004008008ULL, 0x0802808002000400ULL, 0x0C10440021020890ULL, 0x0000020000840041ULL,
+    0x0080005040002001ULL, 0x0000400480200080ULL, 0x0000104100200101ULL, 0x0010001080800800ULL,
+    0x0000040080800800ULL, 0x2048020080040080ULL, 0x0880120400810850ULL, 0x028809020004884CULL,
+    0x2440102040800086ULL, 0x1020100020404000ULL, 0x0861200184801000ULL, 0x0200801000800800ULL,
+    0x0010080080800400ULL, 0x2202001002000409ULL, 0x04401022040008A1ULL, 0x0802049106000054ULL,
+    0x0040804000228000ULL, 0x0050004020014010ULL, 0x2020200010008080ULL, 0x0010008100080800ULL,
+    0x0028000400088080ULL, 0x4112010488020010ULL, 0x0462000408020001ULL, 0x10400CA841020004ULL,
+    0x8006320146810200ULL, 0x0000812000400280ULL, 0x0010144020090100ULL, 0x008A001008452200ULL,
+    0x0018004004020040ULL, 0x0020020004008080ULL, 0x0006011002080400ULL, 0x0000024700B40200ULL,
+    0x0000410080002011ULL, 0x040811042182C001ULL, 0x58201041000A2001ULL, 0x0C00041001210009ULL,
+    0x000200846010182AULL, 0x0001000208040013ULL, 0x9005000082002441ULL, 0x0484802102C40186ULL
+};
+
+const uint64_t BISHOP_MAGICS[64] = {
+    0x0020828081010200ULL, 0x4020410421004045ULL, 0x4084080081030428ULL, 0x2002208200400040ULL,
+    0x40240504102D0220ULL, 0x000A081424100200ULL, 0x0004108410080200ULL, 0x4040808050108400ULL,
+    0x2004420822041042ULL, 0x0006101000890054ULL, 0x06085010C0810800ULL, 0x08000444008A080CULL,
+    0x000A0D1041001000ULL, 0x1040008220600200ULL, 0x0010110110100400ULL, 0x00000830880C1040ULL,
+    0x8840400510041108ULL, 0x0502000818510400ULL, 0x02411008080B0010ULL, 0x800406084400080EULL,
+    0x4801004590400190ULL, 0x8101000080603200ULL, 0x0301110044100400ULL, 0x004020208A080200ULL,
+    0x010844180AA01800ULL, 0x0904204004588880ULL, 0x1218510908020400ULL, 0x9008080040202120ULL,
+    0x0120840202802000ULL, 0x5118024004806020ULL, 0x0942088684040120ULL, 0x0009010190440891ULL,
+    0x3041101021882010ULL, 0x1000822040080801ULL, 0x0410280800010A00ULL, 0xC020400808038200ULL,
+    0x0204200200402080ULL, 0x8090004200134100ULL, 0x8110010304204460ULL, 0x4021086200018A00ULL,
+    0xC10808A208A01000ULL, 0x0024308818048410ULL, 0x4002010448004101ULL, 0x0402012011008802ULL,
+    0x0000102012000041ULL, 0x00A1014101004200ULL, 0x0002820424008108ULL, 0xA210010069010880ULL,
+    0x0800421011082208ULL, 0x8000804842102000ULL, 0x0400050088040015ULL, 0x0001020084043004ULL,
+    0x02250C4010410040ULL, 0x200C910210010000ULL, 0x0A12029004108000ULL, 0x8028C84284014009ULL,
+    0x00053C0200A2E000ULL, 0x1060102401080822ULL, 0x800404420082210DULL, 0x0100708002050412ULL,
+    0x1100404240105100ULL, 0x08202120081042C0ULL, 0x0600204801082480ULL, 0x0A02A00202021220ULL
+};
+// clang-format on
 
 void InitBetweenSquares() {
   int i;
@@ -356,6 +412,7 @@ BitBoard SetPieceLayoutOccupancy(int idx, int bits, BitBoard attacks) {
   return occupany;
 }
 
+// how ROOK_MAGICS and BISHOP_MAGICS were generated
 uint64_t FindMagicNumber(int sq, int n, int isBishop) {
   int numOccupancies = 1 << n;
 
@@ -396,16 +453,6 @@ uint64_t FindMagicNumber(int sq, int n, int isBishop) {
   return 0;
 }
 
-void InitBishopMagics() {
-  for (int i = 0; i < 64; i++)
-    BISHOP_MAGICS[i] = FindMagicNumber(i, BISHOP_RELEVANT_BITS[i], 1);
-}
-
-void InitRookMagics() {
-  for (int i = 0; i < 64; i++)
-    ROOK_MAGICS[i] = FindMagicNumber(i, ROOK_RELEVANT_BITS[i], 0);
-}
-
 void InitBishopAttacks() {
   for (int sq = 0; sq < 64; sq++) {
     BitBoard mask = BISHOP_MASKS[sq];
@@ -415,12 +462,8 @@ void InitBishopAttacks() {
     for (int i = 0; i < n; i++) {
       BitBoard occupancy = SetPieceLayoutOccupancy(i, bits, mask);
 
-#ifndef PEXT
-      int idx = (occupancy * BISHOP_MAGICS[sq]) >> (64 - bits);
+      int idx = USE_PEXT ? (int)Pext(occupancy, mask) : (int)((occupancy * BISHOP_MAGICS[sq]) >> (64 - bits));
       BISHOP_ATTACKS[sq][idx] = GetBishopAttacksOTF(sq, occupancy);
-#else
-      BISHOP_ATTACKS[sq][_pext_u64(occupancy, mask)] = GetBishopAttacksOTF(sq, occupancy);
-#endif
     }
   }
 }
@@ -434,12 +477,8 @@ void InitRookAttacks() {
     for (int i = 0; i < n; i++) {
       BitBoard occupancy = SetPieceLayoutOccupancy(i, bits, mask);
 
-#ifndef PEXT
-      int idx = (occupancy * ROOK_MAGICS[sq]) >> (64 - bits);
+      int idx = USE_PEXT ? (int)Pext(occupancy, mask) : (int)((occupancy * ROOK_MAGICS[sq]) >> (64 - bits));
       ROOK_ATTACKS[sq][idx] = GetRookAttacksOTF(sq, occupancy);
-#else
-      ROOK_ATTACKS[sq][_pext_u64(occupancy, mask)] = GetRookAttacksOTF(sq, occupancy);
-#endif
     }
   }
 }
@@ -455,11 +494,6 @@ void InitAttacks() {
   InitBishopMasks();
   InitRookMasks();
 
-#ifndef PEXT
-  InitBishopMagics();
-  InitRookMagics();
-#endif
-
   InitBishopAttacks();
   InitRookAttacks();
 }
@@ -469,27 +503,25 @@ inline BitBoard GetPawnAttacks(int sq, int color) { return PAWN_ATTACKS[color][s
 inline BitBoard GetKnightAttacks(int sq) { return KNIGHT_ATTACKS[sq]; }
 
 inline BitBoard GetBishopAttacks(int sq, BitBoard occupancy) {
-#ifndef PEXT
+  if (USE_PEXT)
+    return BISHOP_ATTACKS[sq][Pext(occupancy, BISHOP_MASKS[sq])];
+
   occupancy &= BISHOP_MASKS[sq];
   occupancy *= BISHOP_MAGICS[sq];
   occupancy >>= 64 - BISHOP_RELEVANT_BITS[sq];
 
   return BISHOP_ATTACKS[sq][occupancy];
-#else
-  return BISHOP_ATTACKS[sq][_pext_u64(occupancy, BISHOP_MASKS[sq])];
-#endif
 }
 
 inline BitBoard GetRookAttacks(int sq, BitBoard occupancy) {
-#ifndef PEXT
+  if (USE_PEXT)
+    return ROOK_ATTACKS[sq][Pext(occupancy, ROOK_MASKS[sq])];
+
   occupancy &= ROOK_MASKS[sq];
   occupancy *= ROOK_MAGICS[sq];
   occupancy >>= 64 - ROOK_RELEVANT_BITS[sq];
 
   return ROOK_ATTACKS[sq][occupancy];
-#else
-  return ROOK_ATTACKS[sq][_pext_u64(occupancy, ROOK_MASKS[sq])];
-#endif
 }
 
 inline BitBoard GetQueenAttacks(int sq, BitBoard occupancy) {
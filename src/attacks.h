@@ -33,8 +33,8 @@ extern BitBoard KING_ATTACKS[64];
 extern BitBoard ROOK_MASKS[64];
 extern BitBoard BISHOP_MASKS[64];
 
-extern uint64_t ROOK_MAGICS[64];
-extern uint64_t BISHOP_MAGICS[64];
+extern const uint64_t ROOK_MAGICS[64];
+extern const uint64_t BISHOP_MAGICS[64];
 
 void InitBetweenSquares();
 void InitPinnedMovementSquares();
@@ -42,10 +42,8 @@ void initPawnSpans();
 void InitPawnAttacks();
 void InitKnightAttacks();
 void InitBishopMasks();
-void InitBishopMagics();
 void InitBishopAttacks();
 void InitRookMasks();
-void InitRookMagics();
 void InitRookAttacks();
 void InitKingAttacks();
 void InitAttacks();
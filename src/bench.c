@@ -14,14 +14,24 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <math.h>
 #include <stdio.h>
-#include <string.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "attacks.h"
 #include "bench.h"
+#include "bits.h"
 #include "board.h"
+#include "eval.h"
+#include "kernels.h"
 #include "move.h"
+#include "movegen.h"
+#include "profile.h"
+#include "random.h"
 #include "search.h"
+#include "see.h"
+#include "stats.h"
 #include "thread.h"
 #include "transposition.h"
 #include "types.h"
@@ -81,45 +91,401 @@ char* benchmarks[] = {"r3k2r/2pb1ppp/2pp1q2/p7/1nP1B3/1P2P3/P2N1PPP/R2QK2R w KQk
 
 const int NUM_BENCH_POSITIONS = 50;
 
-void Bench() {
+// One fen per line, anything after the fen fields is ignored by ParseFen
+char** LoadBenchPositions(char* path, int* n) {
+  FILE* fp = fopen(path, "r");
+  if (fp == NULL)
+    return NULL;
+
+  int size = 64;
+  char** fens = malloc(sizeof(char*) * size);
+  char buffer[256];
+
+  *n = 0;
+  while (fgets(buffer, sizeof(buffer), fp)) {
+    if (strlen(buffer) < 8)
+      continue;
+
+    if (*n == size)
+      fens = realloc(fens, sizeof(char*) * (size *= 2));
+
+    fens[(*n)++] = strdup(buffer);
+  }
+
+  fclose(fp);
+  return fens;
+}
+
+int CompareNps(const void* a, const void* b) {
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+  return (x > y) - (x < y);
+}
+
+// berserk bench [depth] [threads] [hash] [file] [runs] [format]
+// The default arguments give the signature bench. Format is human, json or csv,
+// where the machine readable ones list every position of every run
+void Bench(int depth, int threadCount, int hash, char* file, int runs, char* format) {
+  int n = NUM_BENCH_POSITIONS;
+  char** fens = benchmarks;
+
+  if (file && strcmp(file, "default")) {
+    fens = LoadBenchPositions(file, &n);
+    if (!fens || !n) {
+      printf("Unable to load bench positions from %s\n", file);
+      return;
+    }
+  }
+
+  int json = !strcmp(format, "json"), csv = !strcmp(format, "csv"), human = !json && !csv;
+
   Board board;
-  SearchParams params = {.depth = 13};
-  ThreadData* threads = CreatePool(1);
+  SearchParams params = {.depth = depth, .quiet = !human};
+  ThreadData* threads = CreatePool(threadCount);
 
-  Move bestMoves[NUM_BENCH_POSITIONS];
-  int scores[NUM_BENCH_POSITIONS];
-  int nodes[NUM_BENCH_POSITIONS];
-  long times[NUM_BENCH_POSITIONS];
+  if ((uint64_t)hash != TT.size)
+    TTInit(hash, threads);
 
-  long startTime = GetTimeMS();
-  for (int i = 0; i < NUM_BENCH_POSITIONS; i++) {
-    TTClear();
-    ResetThreadPool(&board, &params, threads);
+  Move* bestMoves = malloc(sizeof(Move) * n * runs);
+  int* scores = malloc(sizeof(int) * n * runs);
+  uint64_t* nodes = malloc(sizeof(uint64_t) * n * runs);
+  long* times = malloc(sizeof(long) * n * runs);
 
-    params.start = GetTimeMS();
+  uint64_t* runNodes = calloc(runs, sizeof(uint64_t));
+  uint64_t* runNps = malloc(sizeof(uint64_t) * runs);
+  long* runTimes = malloc(sizeof(long) * runs);
 
-    ParseFen(benchmarks[i], &board);
+  for (int r = 0; r < runs; r++) {
+    long startTime = GetTimeMS();
+    for (int i = 0; i < n; i++) {
+      int j = r * n + i;
 
-    BestMove(&board, &params, threads);
+      TTClear(threads);
+      ResetThreadPool(&board, &params, threads);
 
-    times[i] = GetTimeMS() - params.start;
-    bestMoves[i] = threads[0].data.bestMove;
-    scores[i] = threads[0].data.score;
-    nodes[i] = threads[0].data.nodes;
+      params.start = GetTimeMS();
+      params.stopped = 0;
+
+      ParseFen(fens[i], &board);
+
+      BestMove(&board, &params, threads);
+
+      ThreadData* best = BestThread(threads);
+      times[j] = GetTimeMS() - params.start;
+      bestMoves[j] = best->data.bestMove;
+      scores[j] = best->data.score;
+      nodes[j] = NodesSearched(threads);
+      runNodes[r] += nodes[j];
+    }
+
+    runTimes[r] = GetTimeMS() - startTime;
+    runNps[r] = 1000 * runNodes[r] / (runTimes[r] + 1);
   }
-  long totalTime = GetTimeMS() - startTime;
 
-  printf("\n\n");
+  if (human) {
+    printf("\n\n");
+    for (int i = 0; i < n; i++) {
+      printf("Bench #%2d: bestmove %5s score %5d %12" PRIu64 " nodes %8d nps\n", i + 1, MoveToStr(bestMoves[i]),
+             scores[i], nodes[i], (int)(1000.0 * nodes[i] / (times[i] + 1)));
+    }
+
+    printf("\nResults: %41" PRIu64 " nodes %8d nps\n", runNodes[0], (int)runNps[0]);
+    printf("Pawn hash: %39" PRIu64 " probes %7.2f%% hits\n", threads->pawnProbes,
+           100.0 * threads->pawnHits / max(1, threads->pawnProbes));
+    printf("Quiesce: %41" PRIu64 " nodes %8.2f%% lazy\n\n", threads->qsNodes,
+           100.0 * threads->lazyEvals / max(1, threads->qsNodes));
+
+#ifdef STATS
+    PrintStats(threads);
+#endif
+#ifdef PROFILE
+    PrintProfile(threads);
+#endif
+  } else if (csv) {
+    printf("run,position,bestmove,score,depth,nodes,time,nps\n");
+    for (int j = 0; j < n * runs; j++)
+      printf("%d,%d,%s,%d,%d,%" PRIu64 ",%ld,%" PRIu64 "\n", j / n + 1, j % n + 1, MoveToStr(bestMoves[j]), scores[j],
+             depth, nodes[j], times[j], 1000 * nodes[j] / (times[j] + 1));
+  } else {
+    printf("{\"depth\": %d, \"threads\": %d, \"hash\": %d, \"positions\": [\n", depth, threadCount, hash);
+    for (int j = 0; j < n * runs; j++)
+      printf("  {\"run\": %d, \"position\": %d, \"bestmove\": \"%s\", \"score\": %d, \"depth\": %d, \"nodes\": %" PRIu64
+             ", \"time\": %ld, \"nps\": %" PRIu64 "}%s\n",
+             j / n + 1, j % n + 1, MoveToStr(bestMoves[j]), scores[j], depth, nodes[j], times[j],
+             1000 * nodes[j] / (times[j] + 1), j < n * runs - 1 ? "," : "");
+    printf("], \"runs\": [");
+    for (int r = 0; r < runs; r++)
+      printf("{\"nodes\": %" PRIu64 ", \"time\": %ld, \"nps\": %" PRIu64 "}%s", runNodes[r], runTimes[r], runNps[r],
+             r < runs - 1 ? ", " : "");
+    printf("]");
+  }
+
+  // spread of the speed over the runs, for telling noise from a regression
+  if (runs > 1) {
+    double mean = 0, variance = 0;
+    for (int r = 0; r < runs; r++)
+      mean += (double)runNps[r] / runs;
+    for (int r = 0; r < runs; r++)
+      variance += (runNps[r] - mean) * (runNps[r] - mean) / (runs - 1);
+
+    qsort(runNps, runs, sizeof(uint64_t), CompareNps);
+    double median = runs & 1 ? runNps[runs / 2] : (runNps[runs / 2 - 1] + runNps[runs / 2]) / 2.0;
+
+    if (human)
+      printf("Runs: %4d median %10.0f nps mean %10.0f nps stddev %8.0f (%.2f%%)\n\n", runs, median, mean,
+             sqrt(variance), 100 * sqrt(variance) / max(1, mean));
+    else if (json)
+      printf(", \"median\": %.0f, \"mean\": %.0f, \"variance\": %.0f", median, mean, variance);
+    else
+      printf("median,%.0f\nmean,%.0f\nvariance,%.0f\n", median, mean, variance);
+  }
+
+  if (json)
+    printf("}\n");
+
+  free(runTimes);
+  free(runNps);
+  free(runNodes);
+  free(times);
+  free(nodes);
+  free(scores);
+  free(bestMoves);
+
+  if (fens != benchmarks) {
+    for (int i = 0; i < n; i++)
+      free(fens[i]);
+    free(fens);
+  }
+
+  FreePool(threads);
+}
+
+// Compares the vector and scalar mobility kernels over the pieces of the bench set
+void MobilityBench() {
+  BitBoard movements[NUM_BENCH_POSITIONS * 2][16];
+  BitBoard masks[NUM_BENCH_POSITIONS * 2];
+  int counts[NUM_BENCH_POSITIONS * 2];
+  memset(counts, 0, sizeof(counts));
+
+  Board board;
   for (int i = 0; i < NUM_BENCH_POSITIONS; i++) {
-    printf("Bench #%2d: bestmove %5s score %5d %12d nodes %8d nps\n", i + 1, MoveToStr(bestMoves[i]), scores[i],
-           nodes[i], (int)(1000.0 * nodes[i] / (times[i] + 1)));
+    ParseFen(benchmarks[i], &board);
+
+    for (int side = WHITE; side <= BLACK; side++) {
+      int j = 2 * i + side;
+      masks[j] = ~board.occupancies[side];
+
+      for (int p = KNIGHT[side]; p <= QUEEN[side]; p += 2)
+        for (BitBoard pieces = board.pieces[p]; pieces; popLsb(pieces))
+          movements[j][counts[j]++] =
+              p == KNIGHT[side] ? GetKnightAttacks(lsb(pieces)) : board.sliderAttacks[lsb(pieces)];
+    }
+  }
+
+  const int iterations = 100000;
+  void (*kernels[2])(const BitBoard*, BitBoard, int, int*) = {BitsMasked, BitsMaskedScalar};
+  char* names[2] = {"vector", "scalar"};
+  uint64_t checksums[2] = {0};
+
+  printf("\n");
+  for (int k = 0; k < 2; k++) {
+    int out[16];
+
+    long startTime = GetTimeMS();
+    for (int it = 0; it < iterations; it++) {
+      for (int j = 0; j < NUM_BENCH_POSITIONS * 2; j++) {
+        kernels[k](movements[j], masks[j], counts[j], out);
+        for (int n = 0; n < counts[j]; n++)
+          checksums[k] += out[n];
+      }
+    }
+    long time = GetTimeMS() - startTime;
+
+    printf("Mobility %s: %8ld ms %10.2f ns/side checksum %" PRIu64 "\n", names[k], time,
+           1e6 * time / ((double)iterations * NUM_BENCH_POSITIONS * 2), checksums[k]);
   }
 
-  int totalNodes = 0;
-  for (int i = 0; i < NUM_BENCH_POSITIONS; i++)
-    totalNodes += nodes[i];
+  if (checksums[0] != checksums[1])
+    printf("Mobility kernels DISAGREE!\n");
+  printf("\n");
+}
+
+void MicroResult(char* name, long time, uint64_t ops, uint64_t checksum) {
+  printf("%-22s %8ld ms %10.2f ns/op %12" PRIu64 " ops checksum %016" PRIx64 "\n", name, time,
+         1e6 * time / max(1, ops), ops, checksum);
+}
+
+// stale eval (and pawn) hash entries for a position, so that Evaluate does the full work
+void MicroInvalidate(Board* board, ThreadData* thread, int pawns) {
+  thread->evalHashTable[board->zobrist & thread->evalHashMask].key = ~(uint32_t)(board->zobrist >> 32);
+
+  if (pawns)
+    memset(&thread->pawnHashTable[board->pawnHash & thread->pawnHashMask], 0, sizeof(PawnHashBucket));
+}
 
-  printf("\nResults: %41d nodes %8d nps\n\n", totalNodes, (int)(1000.0 * totalNodes / (totalTime + 1)));
+// ns/op of the core kernels over the bench set, to compare builds (magic vs pext,
+// compiler flags) without the noise of a search. Every kernel feeds a checksum
+// that is printed, so that none of the work can be optimized away
+void MicroBench(int passes) {
+  int n = NUM_BENCH_POSITIONS;
+
+  Board* boards = malloc(n * sizeof(Board));
+  Move(*moves)[MAX_MOVES] = malloc(n * sizeof(*moves));
+  int* counts = malloc(n * sizeof(int));
+  int* tacticals = malloc(n * sizeof(int));
+
+  for (int i = 0; i < n; i++) {
+    ParseFen(benchmarks[i], &boards[i]);
+
+    MoveList list;
+    list.nTactical = list.nQuiets = 0;
+    GenerateTacticalMoves(&list, &boards[i]);
+    tacticals[i] = list.nTactical;
+    GenerateQuietMoves(&list, &boards[i]);
+
+    counts[i] = list.nTactical + list.nQuiets;
+    for (int j = 0; j < counts[i]; j++)
+      moves[i][j] = list.moves[j].move;
+  }
 
-  free(threads);
-}
\ No newline at end of file
+  ThreadData* thread = CreatePool(1);
+  uint64_t ops, checksum;
+  long startTime;
+
+  printf("\nMicrobench over %d positions, %d passes\n\n", n, passes);
+
+  // sliders from every square with the occupancy of each position, perturbed
+  // by the pass so that the lookups cannot be hoisted out of the loop
+  ops = checksum = 0, startTime = GetTimeMS();
+  for (int p = 0; p < passes * 4; p++)
+    for (int i = 0; i < n; i++)
+      for (int sq = 0; sq < 64; sq++)
+        checksum += GetBishopAttacks(sq, boards[i].occupancies[BOTH] ^ p), ops++;
+  MicroResult("GetBishopAttacks", GetTimeMS() - startTime, ops, checksum);
+
+  ops = checksum = 0, startTime = GetTimeMS();
+  for (int p = 0; p < passes * 4; p++)
+    for (int i = 0; i < n; i++)
+      for (int sq = 0; sq < 64; sq++)
+        checksum += GetRookAttacks(sq, boards[i].occupancies[BOTH] ^ p), ops++;
+  MicroResult("GetRookAttacks", GetTimeMS() - startTime, ops, checksum);
+
+  ops = checksum = 0, startTime = GetTimeMS();
+  for (int p = 0; p < passes; p++)
+    for (int i = 0; i < n; i++)
+      for (int j = 0; j < tacticals[i]; j++)
+        checksum += (uint64_t)SEE(&boards[i], moves[i][j], 0) << (j & 63), ops++;
+  MicroResult("SEE", GetTimeMS() - startTime, ops, checksum);
+
+  ops = checksum = 0, startTime = GetTimeMS();
+  for (int p = 0; p < passes; p++) {
+    for (int i = 0; i < n; i++) {
+      for (int j = 0; j < counts[i]; j++) {
+        MakeMove(moves[i][j], &boards[i]);
+        checksum += boards[i].zobrist;
+        UndoMove(moves[i][j], &boards[i]);
+        ops++;
+      }
+    }
+  }
+  MicroResult("MakeMove+UndoMove", GetTimeMS() - startTime, ops, checksum);
+
+  ops = checksum = 0, startTime = GetTimeMS();
+  for (int p = 0; p < passes * 4; p++) {
+    for (int i = 0; i < n; i++) {
+      MoveList list;
+      list.nTactical = list.nQuiets = 0;
+      GenerateTacticalMoves(&list, &boards[i]);
+      checksum += list.nTactical + list.moves[0].move, ops++;
+    }
+  }
+  MicroResult("GenerateTacticalMoves", GetTimeMS() - startTime, ops, checksum);
+
+  ops = checksum = 0, startTime = GetTimeMS();
+  for (int p = 0; p < passes * 4; p++) {
+    for (int i = 0; i < n; i++) {
+      MoveList list;
+      list.nTactical = list.nQuiets = 0;
+      GenerateQuietMoves(&list, &boards[i]);
+      checksum += list.nQuiets + list.moves[0].move, ops++;
+    }
+  }
+  MicroResult("GenerateQuietMoves", GetTimeMS() - startTime, ops, checksum);
+
+  for (int pawns = 0; pawns <= 1; pawns++) {
+    ops = checksum = 0, startTime = GetTimeMS();
+    for (int p = 0; p < passes; p++) {
+      for (int i = 0; i < n; i++) {
+        MicroInvalidate(&boards[i], thread, pawns);
+        checksum += Evaluate(&boards[i], thread), ops++;
+      }
+    }
+    MicroResult(pawns ? "Evaluate (no pawn hash)" : "Evaluate", GetTimeMS() - startTime, ops, checksum);
+  }
+
+  // random keys, so that every access is a cache miss as in a search
+  uint64_t* keys = malloc(passes * n * sizeof(uint64_t));
+  for (int i = 0; i < passes * n; i++)
+    keys[i] = RandomUInt64();
+
+  ops = checksum = 0, startTime = GetTimeMS();
+  for (int i = 0; i < passes * n; i++)
+    TTPut(keys[i], i & 63, i, TT_EXACT, NULL_MOVE, 0, i), ops++;
+  MicroResult("TTPut", GetTimeMS() - startTime, ops, ops);
+
+  ops = checksum = 0, startTime = GetTimeMS();
+  for (int i = 0; i < passes * n; i++) {
+    TTData tt;
+    checksum += TTProbe(keys[i], &tt) ? tt.score : 0, ops++;
+  }
+  MicroResult("TTProbe", GetTimeMS() - startTime, ops, checksum);
+  printf("\n");
+
+  FreePool(thread);
+  free(keys);
+  free(tacticals);
+  free(counts);
+  free(moves);
+  free(boards);
+}
+
+// Time to depth over the bench set for 1, 2, 4 ... maxThreads threads
+void SMPBench(int maxThreads, int depth) {
+  Board board;
+  SearchParams params = {.depth = depth};
+
+  int counts[16], n = 0;
+  long times[16];
+  uint64_t nodes[16];
+
+  for (int count = 1; n < 16; count = min(count * 2, maxThreads)) {
+    ThreadData* threads = CreatePool(count);
+
+    counts[n] = count;
+    nodes[n] = 0;
+
+    long startTime = GetTimeMS();
+    for (int i = 0; i < NUM_BENCH_POSITIONS; i++) {
+      TTClear(threads);
+      ParseFen(benchmarks[i], &board);
+      ResetThreadPool(&board, &params, threads);
+
+      params.start = GetTimeMS();
+      params.stopped = 0;
+      BestMove(&board, &params, threads);
+
+      nodes[n] += NodesSearched(threads);
+    }
+    times[n++] = GetTimeMS() - startTime;
+
+    FreePool(threads);
+
+    if (count == maxThreads)
+      break;
+  }
+
+  printf("\n\n");
+  for (int i = 0; i < n; i++)
+    printf("Threads %3d: %8ld ms %14" PRIu64 " nodes %10d nps %6.2fx speedup\n", counts[i], times[i], nodes[i],
+           (int)(1000.0 * nodes[i] / (times[i] + 1)), (double)(times[0] + 1) / (times[i] + 1));
+  printf("\n");
+}
@@ -17,6 +17,15 @@
 #ifndef BENCH_H
 #define BENCH_H
 
-void Bench();
+#include "types.h"
+
+char** LoadBenchPositions(char* path, int* n);
+int CompareNps(const void* a, const void* b);
+void Bench(int depth, int threadCount, int hash, char* file, int runs, char* format);
+void SMPBench(int maxThreads, int depth);
+void MobilityBench();
+void MicroResult(char* name, long time, uint64_t ops, uint64_t checksum);
+void MicroInvalidate(Board* board, ThreadData* thread, int pawns);
+void MicroBench(int passes);
 
 #endif
\ No newline at end of file
@@ -14,13 +14,23 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "analyse.h"
 #include "attacks.h"
 #include "bench.h"
 #include "bits.h"
 #include "board.h"
+#include "book.h"
+#include "cluster.h"
+#include "cpu.h"
+#include "datagen.h"
 #include "eval.h"
+#include "kernels.h"
+#include "nnue.h"
+#include "numa.h"
 #include "random.h"
 #include "search.h"
 #include "transposition.h"
@@ -32,21 +42,91 @@
 
 // Welcome to berserk
 int main(int argc, char** argv) {
+  long startTime = GetTimeMS();
+
+  // the slider tables and the kernels depend on what the cpu can do
+  InitCPU();
+  InitKernels();
+
   SeedRandom(0);
 
   InitPSQT();
   InitZobristKeys();
   InitPruningAndReductionTables();
   InitAttacks();
+  InitNuma();
+  InitNNUE();
+
+  TTInit(32, NULL);
 
-  TTInit(32);
+  long startupTime = GetTimeMS() - startTime;
 
   // Compliance for OpenBench
-  if (argc > 1 && !strncmp(argv[1], "bench", 5)) {
-    Bench();
+  if (argc > 2 && !strncmp(argv[1], "bench", 5) && !strncmp(argv[2], "smp", 3)) {
+    // berserk bench smp [threads] [depth]
+    int threads = argc > 3 ? max(1, min(256, atoi(argv[3]))) : 8;
+    int depth = argc > 4 ? max(1, min(MAX_SEARCH_PLY - 1, atoi(argv[4]))) : 13;
+
+    SMPBench(threads, depth);
+  } else if (argc > 2 && !strncmp(argv[1], "bench", 5) && !strncmp(argv[2], "startup", 7)) {
+    // everything that happens before the engine can answer "uci"
+    printf("Startup: %ld ms\n", startupTime);
+  } else if (argc > 2 && !strncmp(argv[1], "bench", 5) && !strncmp(argv[2], "mobility", 8)) {
+    MobilityBench();
+  } else if (argc > 2 && !strncmp(argv[1], "bench", 5) && !strncmp(argv[2], "micro", 5)) {
+    // berserk bench micro [passes]
+    MicroBench(argc > 3 ? max(1, atoi(argv[3])) : 20000);
+  } else if (argc > 1 && !strncmp(argv[1], "bench", 5)) {
+    // berserk bench [depth] [threads] [hash] [file] [runs] [human|json|csv]
+    int depth = argc > 2 && atoi(argv[2]) > 0 ? min(MAX_SEARCH_PLY - 1, atoi(argv[2])) : 13;
+    int threads = argc > 3 ? max(1, min(256, atoi(argv[3]))) : 1;
+    int hash = argc > 4 ? max(1, min(65536, atoi(argv[4]))) : 32;
+    char* file = argc > 5 ? argv[5] : NULL;
+    int runs = argc > 6 ? max(1, atoi(argv[6])) : 1;
+    char* format = argc > 7 ? argv[7] : "human";
+
+    Bench(depth, threads, hash, file, runs, format);
   } else if (argc > 1 && !strncmp(argv[1], "tune", 4)) {
 #ifdef TUNE
-    Tune();
+    // berserk tune [path] [threads] [batch size]
+    char* path = argc > 2 ? argv[2] : EPD_FILE_PATH;
+    int threads = argc > 3 ? max(1, min(1024, atoi(argv[3]))) : 0;
+    int batchSize = argc > 4 ? max(0, atoi(argv[4])) : 0;
+
+    Tune(path, threads, batchSize);
+#endif
+  } else if (argc > 2 && !strncmp(argv[1], "datagen", 7)) {
+    // berserk datagen <out.bin> [threads] [positions] [nodes] [depth]
+    int threads = argc > 3 ? max(1, min(1024, atoi(argv[3]))) : 1;
+    uint64_t positions = argc > 4 ? strtoull(argv[4], NULL, 10) : 1000000;
+    int nodes = argc > 5 ? max(1, atoi(argv[5])) : 5000;
+    int depth = argc > 6 ? max(0, min(MAX_SEARCH_PLY - 1, atoi(argv[6]))) : 0;
+
+    Datagen(argv[2], threads, positions, nodes, depth);
+  } else if (argc > 4 && !strncmp(argv[1], "analyse", 7)) {
+    // berserk analyse <fens> depth|nodes <n> [threads] [out]
+    if (strcmp(argv[3], "depth") && strcmp(argv[3], "nodes")) {
+      printf("Usage: berserk analyse <fens> depth|nodes <n> [threads] [out]\n");
+      return 1;
+    }
+
+    int count = max(1, atoi(argv[4]));
+    int depth = !strcmp(argv[3], "depth") ? min(MAX_SEARCH_PLY - 1, count) : 0;
+    int threads = argc > 5 ? max(1, min(1024, atoi(argv[5]))) : 1;
+
+    Analyse(argv[2], argc > 6 ? argv[6] : NULL, threads, depth, count);
+  } else if (argc > 2 && !strncmp(argv[1], "cluster", 7)) {
+    // berserk cluster <port> [threads] [hash] [address]
+    int threads = argc > 3 ? max(1, min(256, atoi(argv[3]))) : 1;
+    int hash = argc > 4 ? max(4, min(65536, atoi(argv[4]))) : 32;
+
+    ClusterServe(atoi(argv[2]), threads, hash, argc > 5 ? argv[5] : NULL);
+  } else if (argc > 3 && !strncmp(argv[1], "makebook", 8)) {
+    // berserk makebook <fen;move[;weight] lines> <out.bin>
+    MakeBook(argv[2], argv[3]);
+  } else if (argc > 3 && !strncmp(argv[1], "convert", 7)) {
+#ifdef TUNE
+    ConvertPositions(argv[2], argv[3]);
 #endif
   } else {
     UCILoop();
@@ -65,7 +65,7 @@ const BitBoard FORWARD_RANK_MASKS[2][8] = {{
 const BitBoard DARK_SQS = 0x55AA55AA55AA55AAULL;
 const BitBoard CENTER_SQS = (D_FILE | E_FILE) & (RANK_4 | RANK_5);
 
-#ifndef POPCOUNT
+#if !defined(POPCOUNT) && !defined(DISPATCH)
 inline int bits(BitBoard bb) {
   int c;
   for (c = 0; bb; bb &= bb - 1)
@@ -74,6 +74,11 @@ inline int bits(BitBoard bb) {
 }
 #endif
 
+inline void BitsMaskedScalar(const BitBoard* bbs, BitBoard mask, int n, int* counts) {
+  for (int i = 0; i < n; i++)
+    counts[i] = bits(bbs[i] & mask);
+}
+
 inline int popAndGetLsb(BitBoard* bb) {
   int sq = lsb(*bb);
   popLsb(*bb);
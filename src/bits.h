@@ -17,6 +17,7 @@
 #ifndef BITS_H
 #define BITS_H
 
+#include "cpu.h"
 #include "types.h"
 
 enum {
@@ -61,10 +62,20 @@ extern const uint8_t SQ_SIDE[64];
 #define msb(bb) (63 ^ __builtin_clzll(bb))
 #define subset(a, b) (((a) & (b)) == (a))
 
-#ifndef POPCOUNT
-int bits(BitBoard bb);
-#else
+// a dispatch build checks for popcnt at runtime, the instruction is not
+// known to the compiler without -mpopcnt so it is written out
+#if defined(POPCOUNT)
 #define bits(bb) (__builtin_popcountll(bb))
+#elif defined(DISPATCH)
+#define bits(bb) (CPU.popcnt ? PopcntAsm(bb) : __builtin_popcountll(bb))
+#define PopcntAsm(bb)                                                                                                  \
+  ({                                                                                                                   \
+    BitBoard count_;                                                                                                   \
+    __asm__("popcntq %1, %0" : "=r"(count_) : "r"((BitBoard)(bb)));                                                    \
+    (int)count_;                                                                                                       \
+  })
+#else
+int bits(BitBoard bb);
 #endif
 
 #define ShiftN(bb) ((bb) >> 8)
@@ -78,6 +89,7 @@ int bits(BitBoard bb);
 #define ShiftNW(bb) (((bb) & ~A_FILE) >> 9)
 #define ShiftSE(bb) (((bb) & ~H_FILE) << 9)
 
+void BitsMaskedScalar(const BitBoard* bbs, BitBoard mask, int n, int* counts);
 int popAndGetLsb(BitBoard* bb);
 BitBoard Fill(BitBoard initial, int direction);
 void PrintBB(BitBoard bb);
@@ -27,6 +27,7 @@
 #include "movegen.h"
 #include "transposition.h"
 #include "types.h"
+#include "util.h"
 #include "zobrist.h"
 
 const BitBoard EMPTY = 0ULL;
@@ -78,10 +79,7 @@ const uint64_t NON_PAWN_PIECE_MASK[] = {0x0F0F0F0F00, 0xF0F0F0F000};
 void ClearBoard(Board* board) {
   memset(board->pieces, EMPTY, sizeof(board->pieces));
   memset(board->occupancies, EMPTY, sizeof(board->occupancies));
-  memset(board->zobristHistory, EMPTY, sizeof(board->zobristHistory));
-  memset(board->castlingHistory, EMPTY, sizeof(board->castlingHistory));
-  memset(board->captureHistory, EMPTY, sizeof(board->captureHistory));
-  memset(board->halfMoveHistory, 0, sizeof(board->halfMoveHistory));
+  memset(board->history, 0, sizeof(board->history));
 
   for (int i = 0; i < 64; i++)
     board->squares[i] = NO_PIECE;
@@ -165,6 +163,7 @@ void ParseFen(char* fen, Board* board) {
 
   SetOccupancies(board);
   SetSpecialPieces(board);
+  SetSliderAttacks(board);
 
   board->zobrist = Zobrist(board);
   board->mat = MaterialValue(board, board->side) - MaterialValue(board, board->xside);
@@ -278,21 +277,98 @@ inline void SetOccupancies(Board* board) {
   board->occupancies[BOTH] = board->occupancies[WHITE] | board->occupancies[BLACK];
 }
 
+// Mobility attacks of a slider, bishops see through their own queens and rooks
+// through their own rooks and queens (batteries shouldn't limit mobility)
+inline BitBoard SliderAttacks(int piece, int sq, Board* board) {
+  int side = piece & 1;
+
+  switch (PIECE_TYPE[piece]) {
+  case BISHOP_TYPE:
+    return GetBishopAttacks(sq, board->occupancies[BOTH] ^ board->pieces[QUEEN[side]]);
+  case ROOK_TYPE:
+    return GetRookAttacks(sq, board->occupancies[BOTH] ^ board->pieces[ROOK[side]] ^ board->pieces[QUEEN[side]]);
+  case QUEEN_TYPE:
+    return GetQueenAttacks(sq, board->occupancies[BOTH]);
+  default:
+    return EMPTY;
+  }
+}
+
+inline void SetSliderAttacks(Board* board) {
+  BitBoard sliders = board->occupancies[BOTH] & ~(board->pieces[PAWN_WHITE] | board->pieces[PAWN_BLACK] |
+                                                  board->pieces[KNIGHT_WHITE] | board->pieces[KNIGHT_BLACK] |
+                                                  board->pieces[KING_WHITE] | board->pieces[KING_BLACK]);
+
+  while (sliders) {
+    int sq = lsb(sliders);
+    board->sliderAttacks[sq] = SliderAttacks(board->squares[sq], sq, board);
+    popLsb(sliders);
+  }
+
+  board->sliderDirty = EMPTY;
+}
+
+// Brings sliderAttacks up to date with every square changed since the last update.
+// A slider's attacks can only differ if it sees one of the changed squares (or
+// stands on one), since every square up to its first blockers is the same
+inline void UpdateSliderAttacks(Board* board) {
+  BitBoard changed = board->sliderDirty;
+  if (!changed)
+    return;
+
+  BitBoard sliders = board->occupancies[BOTH] & ~(board->pieces[PAWN_WHITE] | board->pieces[PAWN_BLACK] |
+                                                  board->pieces[KNIGHT_WHITE] | board->pieces[KNIGHT_BLACK] |
+                                                  board->pieces[KING_WHITE] | board->pieces[KING_BLACK]);
+
+  while (sliders) {
+    int sq = lsb(sliders);
+
+    if ((changed & bit(sq)) || (board->sliderAttacks[sq] & changed))
+      board->sliderAttacks[sq] = SliderAttacks(board->squares[sq], sq, board);
+
+    popLsb(sliders);
+  }
+
+  board->sliderDirty = EMPTY;
+}
+
+// Squares whose contents change when side plays move
+inline BitBoard ChangedSquares(Move move, int side) {
+  int end = MoveEnd(move);
+  BitBoard changed = bit(MoveStart(move)) | bit(end);
+
+  if (MoveEP(move))
+    changed |= bit(end - PAWN_DIRECTIONS[side]);
+
+  if (MoveCastle(move))
+    changed |= end == G1 ? bit(H1) | bit(F1) : end == C1 ? bit(A1) | bit(D1) : end == G8 ? bit(H8) | bit(F8)
+                                                                                           : bit(A8) | bit(D8);
+
+  return changed;
+}
+
 // Special pieces are those giving check, and those that are pinned
-// these must be recalculated every move for faster move legality purposes
+// this is the full calculation, MakeMove only looks at what the move changed
 inline void SetSpecialPieces(Board* board) {
   int kingSq = lsb(board->pieces[KING[board->side]]);
 
-  // Reset pinned pieces
-  board->pinned = EMPTY;
   // checked can be initialized easily with non-blockable checks
   board->checkers = (GetKnightAttacks(kingSq) & board->pieces[KNIGHT[board->xside]]) |
                     (GetPawnAttacks(kingSq, board->side) & board->pieces[PAWN[board->xside]]);
 
+  SetPinsAndSliderChecks(board);
+}
+
+// Pins are kept for both sides (movegen uses ours, eval uses both). Any slider
+// with a clear line to the king to move is a checker, and is added to checkers
+inline void SetPinsAndSliderChecks(Board* board) {
+  // Reset pinned pieces
+  board->pinned = EMPTY;
+
   // for each side
   for (int kingColor = WHITE; kingColor <= BLACK; kingColor++) {
     int enemyColor = 1 - kingColor;
-    kingSq = lsb(board->pieces[KING[kingColor]]);
+    int kingSq = lsb(board->pieces[KING[kingColor]]);
 
     // get full rook/bishop rays from the king that intersect that piece type of the enemy
     BitBoard enemyPiece =
@@ -312,8 +388,6 @@ inline void SetSpecialPieces(Board* board) {
         // just 1? then its pinned
         board->pinned |= (blockers & board->occupancies[kingColor]);
 
-      // TODO: Similar logic can be applied for discoveries, but apply for self pieces
-
       popLsb(enemyPiece);
     }
   }
@@ -336,15 +410,17 @@ void MakeMove(Move move, Board* board) {
   int endSameSideOurKing = SQ_SIDE[lsb(board->pieces[KING[board->side]])] == SQ_SIDE[end];
 
   // store hard to recalculate values
-  board->zobristHistory[board->moveNo] = board->zobrist;
-  board->pawnHashHistory[board->moveNo] = board->pawnHash;
-  board->castlingHistory[board->moveNo] = board->castling;
-  board->epSquareHistory[board->moveNo] = board->epSquare;
-  board->captureHistory[board->moveNo] = NO_PIECE; // this might get overwritten
-  board->halfMoveHistory[board->moveNo] = board->halfMove;
-  board->checkersHistory[board->moveNo] = board->checkers;
-  board->pinnedHistory[board->moveNo] = board->pinned;
-  board->materialHistory[board->moveNo] = board->mat;
+  BoardState* state = &board->history[board->moveNo & BOARD_HISTORY_MASK];
+  *state = (BoardState){.zobrist = board->zobrist,
+                        .pawnHash = board->pawnHash,
+                        .checkers = board->checkers,
+                        .pinned = board->pinned,
+                        .mat = board->mat,
+                        .castling = board->castling,
+                        .epSquare = board->epSquare,
+                        .halfMove = board->halfMove,
+                        .capture = NO_PIECE, // this might get overwritten
+                        .move = move};
 
   popBit(board->pieces[piece], start);
   setBit(board->pieces[piece], end);
@@ -366,7 +442,7 @@ void MakeMove(Move move, Board* board) {
     board->halfMove++;
 
   if (capture && !ep) {
-    board->captureHistory[board->moveNo] = captured;
+    state->capture = captured;
     popBit(board->pieces[captured], end);
 
     board->mat += PSQT[captured][endSameSideOurKing][end];
@@ -475,6 +551,7 @@ void MakeMove(Move move, Board* board) {
   board->zobrist ^= ZOBRIST_CASTLE_KEYS[board->castling];
 
   SetOccupancies(board);
+  board->sliderDirty |= ChangedSquares(move, board->side);
   if (piece > QUEEN_BLACK)
     board->mat = MaterialValue(board, board->side) - MaterialValue(board, board->xside);
 
@@ -485,8 +562,15 @@ void MakeMove(Move move, Board* board) {
   board->mat = -board->mat;
 
   // special pieces must be loaded after the side has changed
-  // this is because the new side to move will be the one in check
-  SetSpecialPieces(board);
+  // this is because the new side to move will be the one in check.
+  // Only the moved piece can give a knight or pawn check, slider checks
+  // (direct or discovered) come out of the pin scan
+  int kingSq = lsb(board->pieces[KING[board->side]]);
+  int moved = promoted ? promoted : piece;
+  board->checkers = PIECE_TYPE[moved] == KNIGHT_TYPE ? GetKnightAttacks(kingSq) & bit(end)
+                    : PIECE_TYPE[moved] == PAWN_TYPE ? GetPawnAttacks(kingSq, board->side) & bit(end)
+                                                     : EMPTY;
+  SetPinsAndSliderChecks(board);
 
   // Prefetch the hash entry for this board position
   TTPrefetch(board->zobrist);
@@ -506,14 +590,15 @@ void UndoMove(Move move, Board* board) {
   board->moveNo--;
 
   // reload historical values
-  board->epSquare = board->epSquareHistory[board->moveNo];
-  board->castling = board->castlingHistory[board->moveNo];
-  board->zobrist = board->zobristHistory[board->moveNo];
-  board->pawnHash = board->pawnHashHistory[board->moveNo];
-  board->halfMove = board->halfMoveHistory[board->moveNo];
-  board->checkers = board->checkersHistory[board->moveNo];
-  board->pinned = board->pinnedHistory[board->moveNo];
-  board->mat = board->materialHistory[board->moveNo];
+  BoardState* state = &board->history[board->moveNo & BOARD_HISTORY_MASK];
+  board->epSquare = state->epSquare;
+  board->castling = state->castling;
+  board->zobrist = state->zobrist;
+  board->pawnHash = state->pawnHash;
+  board->halfMove = state->halfMove;
+  board->checkers = state->checkers;
+  board->pinned = state->pinned;
+  board->mat = state->mat;
 
   popBit(board->pieces[piece], end);
   setBit(board->pieces[piece], start);
@@ -524,7 +609,7 @@ void UndoMove(Move move, Board* board) {
   // board->mat -= PSQT[piece][end] - PSQT[piece][start];
 
   if (capture) {
-    int captured = board->captureHistory[board->moveNo];
+    int captured = state->capture;
     setBit(board->pieces[captured], end);
 
     if (!ep) {
@@ -578,6 +663,7 @@ void UndoMove(Move move, Board* board) {
   }
 
   SetOccupancies(board);
+  board->sliderDirty |= ChangedSquares(move, board->side);
 }
 
 int DoesMoveCheck(Move move, Board* board) {
@@ -672,9 +758,10 @@ int DoesMoveCheck(Move move, Board* board) {
 inline int IsRepetition(Board* board, int ply) {
   int reps = 0;
 
-  // Check as far back as the last non-reversible move
-  for (int i = board->moveNo - 2; i >= 0 && i >= board->moveNo - board->halfMove; i -= 2) {
-    if (board->zobristHistory[i] == board->zobrist) {
+  // Check as far back as the last non-reversible move, or as far as the ring goes
+  int stop = board->moveNo - min(board->halfMove, BOARD_HISTORY_SIZE);
+  for (int i = board->moveNo - 2; i >= 0 && i >= stop; i -= 2) {
+    if (board->history[i & BOARD_HISTORY_MASK].zobrist == board->zobrist) {
       if (i > board->moveNo - ply) // within our search tree
         return 1;
 
@@ -688,14 +775,16 @@ inline int IsRepetition(Board* board, int ply) {
 }
 
 void MakeNullMove(Board* board) {
-  board->zobristHistory[board->moveNo] = board->zobrist;
-  board->castlingHistory[board->moveNo] = board->castling;
-  board->epSquareHistory[board->moveNo] = board->epSquare;
-  board->captureHistory[board->moveNo] = NO_PIECE;
-  board->halfMoveHistory[board->moveNo] = board->halfMove;
-  board->checkersHistory[board->moveNo] = board->checkers;
-  board->pinnedHistory[board->moveNo] = board->pinned;
-  board->materialHistory[board->moveNo] = board->mat;
+  board->history[board->moveNo & BOARD_HISTORY_MASK] = (BoardState){.zobrist = board->zobrist,
+                                               .pawnHash = board->pawnHash,
+                                               .checkers = board->checkers,
+                                               .pinned = board->pinned,
+                                               .mat = board->mat,
+                                               .castling = board->castling,
+                                               .epSquare = board->epSquare,
+                                               .halfMove = board->halfMove,
+                                               .capture = NO_PIECE,
+                                               .move = NULL_MOVE};
 
   board->halfMove++;
 
@@ -719,13 +808,14 @@ void UndoNullMove(Board* board) {
   board->xside ^= 1;
   board->moveNo--;
 
-  board->zobrist = board->zobristHistory[board->moveNo];
-  board->castling = board->castlingHistory[board->moveNo];
-  board->epSquare = board->epSquareHistory[board->moveNo];
-  board->halfMove = board->halfMoveHistory[board->moveNo];
-  board->checkers = board->checkersHistory[board->moveNo];
-  board->pinned = board->pinnedHistory[board->moveNo];
-  board->mat = board->materialHistory[board->moveNo];
+  BoardState* state = &board->history[board->moveNo & BOARD_HISTORY_MASK];
+  board->zobrist = state->zobrist;
+  board->castling = state->castling;
+  board->epSquare = state->epSquare;
+  board->halfMove = state->halfMove;
+  board->checkers = state->checkers;
+  board->pinned = state->pinned;
+  board->mat = state->mat;
 }
 
 int MoveIsLegal(Move move, Board* board) {
@@ -46,7 +46,12 @@ void BoardToFen(char* fen, Board* board);
 void PrintBoard(Board* board);
 
 void SetSpecialPieces(Board* board);
+void SetPinsAndSliderChecks(Board* board);
 void SetOccupancies(Board* board);
+BitBoard SliderAttacks(int piece, int sq, Board* board);
+void SetSliderAttacks(Board* board);
+void UpdateSliderAttacks(Board* board);
+BitBoard ChangedSquares(Move move, int side);
 
 int DoesMoveCheck(Move move, Board* board);
 int IsRepetition(Board* board, int ply);
@@ -0,0 +1,228 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "board.h"
+#include "book.h"
+#include "move.h"
+#include "random.h"
+#include "types.h"
+#include "util.h"
+
+// entries are kept as they are on disk, big endian
+#define BE64(x) __builtin_bswap64(x)
+#define BE16(x) __builtin_bswap16(x)
+
+Book BOOK = {0};
+
+void BookFree() {
+#if defined(__linux__)
+  if (BOOK.mapped)
+    munmap(BOOK.entries, BOOK.size);
+  else
+#endif
+    free(BOOK.entries);
+
+  BOOK = (Book){0};
+}
+
+// The file is mapped read only and shared, so every engine process on the
+// host uses the same page cached copy of it
+int BookLoad(char* path) {
+  BookFree();
+
+  if (!strcmp(path, "<empty>"))
+    return 1;
+
+#if defined(__linux__)
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return 0;
+
+  struct stat st;
+  if (!fstat(fd, &st) && st.st_size >= (off_t)sizeof(BookEntry)) {
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data != MAP_FAILED) {
+      madvise(data, st.st_size, MADV_RANDOM);
+      BOOK = (Book){.entries = data, .size = st.st_size, .mapped = 1};
+    }
+  }
+  close(fd);
+#endif
+
+  if (!BOOK.entries) {
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL)
+      return 0;
+
+    fseek(fp, 0, SEEK_END);
+    size_t size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    BookEntry* entries = malloc(size);
+    if (fread(entries, 1, size, fp) != size) {
+      fclose(fp);
+      free(entries);
+      return 0;
+    }
+    fclose(fp);
+
+    BOOK = (Book){.entries = entries, .size = size, .mapped = 0};
+  }
+
+  BOOK.count = BOOK.size / sizeof(BookEntry);
+  return 1;
+}
+
+// Binary search for the position, then a move picked with probability
+// proportional to its weight. Moves that are not legal here are skipped
+Move BookProbe(Board* board) {
+  if (!BOOK.count)
+    return NULL_MOVE;
+
+  uint64_t key = board->zobrist;
+
+  size_t lo = 0, hi = BOOK.count;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (BE64(BOOK.entries[mid].key) < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  Move moves[MAX_MOVES];
+  int weights[MAX_MOVES];
+  int n = 0, total = 0;
+
+  for (size_t i = lo; i < BOOK.count && BE64(BOOK.entries[i].key) == key && n < MAX_MOVES; i++) {
+    Move move = UnpackMove(BE16(BOOK.entries[i].move), board);
+    int weight = BE16(BOOK.entries[i].weight);
+
+    if (!weight || !MoveIsLegal(move, board))
+      continue;
+
+    moves[n] = move;
+    weights[n++] = weight;
+    total += weight;
+  }
+
+  if (!total)
+    return NULL_MOVE;
+
+  int pick = RandomUInt64() % total;
+  for (int i = 0; i < n; i++)
+    if ((pick -= weights[i]) < 0)
+      return moves[i];
+
+  return moves[n - 1];
+}
+
+// by key, then by move so that duplicates are next to each other
+int CompareBookEntries(const void* a, const void* b) {
+  const BookEntry* x = a;
+  const BookEntry* y = b;
+
+  if (x->key != y->key)
+    return x->key < y->key ? -1 : 1;
+  return x->move - y->move;
+}
+
+// Builds a book from "fen;move[;weight]" lines (the format of the NoobBookCache
+// file), the weights of repeated moves are added up
+void MakeBook(char* in, char* out) {
+  FILE* fin = fopen(in, "r");
+  if (fin == NULL) {
+    printf("Unable to open %s\n", in);
+    return;
+  }
+
+  size_t n = 0, capacity = 1 << 16;
+  BookEntry* entries = malloc(capacity * sizeof(BookEntry));
+
+  char line[512];
+  Board board;
+  size_t skipped = 0;
+
+  while (fgets(line, sizeof(line), fin)) {
+    char* moveStr = strchr(line, ';');
+    if (!moveStr) {
+      skipped++;
+      continue;
+    }
+
+    *moveStr++ = '\0';
+    size_t len = strcspn(moveStr, ";\r\n");
+    int weight = moveStr[len] == ';' ? atoi(moveStr + len + 1) : 1;
+    moveStr[len] = '\0';
+
+    ParseFen(line, &board);
+    Move move = ParseMove(moveStr, &board);
+    if (!move) {
+      skipped++;
+      continue;
+    }
+
+    if (n == capacity) {
+      capacity *= 2;
+      entries = realloc(entries, capacity * sizeof(BookEntry));
+    }
+
+    entries[n++] = (BookEntry){.key = board.zobrist, .move = PackMove(move), .weight = max(1, min(65535, weight))};
+  }
+  fclose(fin);
+
+  qsort(entries, n, sizeof(BookEntry), CompareBookEntries);
+
+  // merge repeated moves, then write big endian
+  size_t unique = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (unique && entries[unique - 1].key == entries[i].key && entries[unique - 1].move == entries[i].move)
+      entries[unique - 1].weight = min(65535, entries[unique - 1].weight + entries[i].weight);
+    else
+      entries[unique++] = entries[i];
+  }
+
+  for (size_t i = 0; i < unique; i++) {
+    entries[i].key = BE64(entries[i].key);
+    entries[i].move = BE16(entries[i].move);
+    entries[i].weight = BE16(entries[i].weight);
+  }
+
+  FILE* fout = fopen(out, "wb");
+  if (fout == NULL) {
+    printf("Unable to open %s\n", out);
+    free(entries);
+    return;
+  }
+
+  fwrite(entries, sizeof(BookEntry), unique, fout);
+  fclose(fout);
+  free(entries);
+
+  printf("Wrote %zu book entries to %s (%zu lines skipped)\n", unique, out, skipped);
+}
\ No newline at end of file
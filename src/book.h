@@ -0,0 +1,48 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef BOOK_H
+#define BOOK_H
+
+#include "types.h"
+
+// Polyglot's 16 byte entry, big endian and sorted by key. Keys are the
+// engine's own zobrist and moves are PackMove'd, so books are built with
+// "berserk makebook" rather than taken from Polyglot tools
+typedef struct {
+  uint64_t key;
+  uint16_t move;
+  uint16_t weight;
+  uint32_t learn;
+} BookEntry;
+
+typedef struct {
+  BookEntry* entries;
+  size_t count;
+  size_t size; // bytes, as mapped or allocated
+  int mapped;
+} Book;
+
+extern Book BOOK;
+
+int BookLoad(char* path);
+void BookFree();
+Move BookProbe(Board* board);
+int CompareBookEntries(const void* a, const void* b);
+void MakeBook(char* in, char* out);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,480 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "cluster.h"
+#include "search.h"
+#include "thread.h"
+#include "transposition.h"
+#include "util.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+Cluster CLUSTER = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER, .sending = PTHREAD_MUTEX_INITIALIZER, .answered = PTHREAD_COND_INITIALIZER};
+
+// the pool and search of a worker node, and the id of the search it answers
+ThreadData* clusterThreads;
+SearchParams clusterParams;
+uint32_t clusterSearchId;
+
+#ifndef _WIN32
+
+// "host:port,host:port", the workers are numbered from 1 in this order
+int ClusterConnect(char* nodes) {
+  ClusterClose();
+
+  char list[1024];
+  snprintf(list, sizeof(list), "%s", nodes);
+
+  for (char* node = strtok(list, ", "); node && CLUSTER.count < CLUSTER_MAX_NODES; node = strtok(NULL, ", ")) {
+    char* port = strrchr(node, ':');
+    if (!port)
+      continue;
+    *port++ = '\0';
+
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM}, *addrs;
+    if (getaddrinfo(node, port, &hints, &addrs))
+      continue;
+
+    int fd = -1;
+    for (struct addrinfo* addr = addrs; addr && fd < 0; addr = addr->ai_next) {
+      fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+      if (fd >= 0 && connect(fd, addr->ai_addr, addr->ai_addrlen))
+        close(fd), fd = -1;
+    }
+    freeaddrinfo(addrs);
+
+    if (fd < 0)
+      continue;
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    CLUSTER.fds[CLUSTER.count++] = fd;
+  }
+
+  if (CLUSTER.count)
+    pthread_create(&CLUSTER.io, NULL, ClusterIOLoop, NULL);
+
+  return CLUSTER.count;
+}
+
+void ClusterClose() {
+  if (!CLUSTER.count || CLUSTER.worker)
+    return;
+
+  CLUSTER.stop = 1;
+  pthread_join(CLUSTER.io, NULL);
+  CLUSTER.stop = 0;
+
+  for (int i = 0; i < CLUSTER.count; i++)
+    if (CLUSTER.fds[i] >= 0)
+      close(CLUSTER.fds[i]);
+
+  CLUSTER.count = 0;
+}
+
+// berserk cluster <port> [threads] [hash] [address]
+// Serves one master at a time and waits for the next when it disconnects.
+// Whoever connects drives the searches and writes into the hash table, so
+// a node without an address to listen on belongs on a trusted network only
+void ClusterServe(int port, int threads, int hash, char* address) {
+  struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_ANY)};
+  if (address && inet_pton(AF_INET, address, &addr.sin_addr) != 1) {
+    printf("Invalid address %s\n", address);
+    return;
+  }
+
+  clusterThreads = CreatePool(threads);
+  TTInit(hash, clusterThreads);
+
+  int server = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  if (server < 0 || bind(server, (struct sockaddr*)&addr, sizeof(addr)) || listen(server, 1)) {
+    printf("Unable to listen on port %d\n", port);
+    FreePool(clusterThreads);
+    return;
+  }
+
+  printf("Cluster node listening on %s:%d with %d threads and %d MB hash\n", address ? address : "*", port, threads,
+         hash);
+
+  int fd;
+  while ((fd = accept(server, NULL, NULL)) >= 0) {
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    CLUSTER.worker = 1;
+    CLUSTER.fds[0] = fd;
+    CLUSTER.count = 1;
+    printf("Cluster master connected\n");
+
+    ClusterIOLoop(NULL);
+
+    clusterParams.stopped = 1;
+    ThreadWaitUntilSleep(clusterThreads);
+    CLUSTER.count = 0;
+    printf("Cluster master disconnected\n");
+  }
+
+  close(server);
+  FreePool(clusterThreads);
+}
+
+// Reads the peers and sends the shared entries every few ms. A worker
+// returns once its master is gone, a master runs until ClusterClose
+void* ClusterIOLoop(void* arg) {
+  (void)arg;
+
+  struct pollfd fds[CLUSTER_MAX_NODES];
+
+  while (!CLUSTER.stop && (!CLUSTER.worker || CLUSTER.fds[0] >= 0)) {
+    for (int i = 0; i < CLUSTER.count; i++)
+      fds[i] = (struct pollfd){.fd = CLUSTER.fds[i], .events = POLLIN};
+
+    if (poll(fds, CLUSTER.count, CLUSTER_FLUSH_MS) > 0)
+      for (int i = 0; i < CLUSTER.count; i++)
+        if (fds[i].fd >= 0 && (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && !ClusterReceive(i))
+          ClusterDrop(i);
+
+    ClusterFlush();
+  }
+
+  return NULL;
+}
+
+// sends one message to peer i, never called with CLUSTER.mutex held
+int ClusterSend(int i, uint32_t type, void* payload, uint32_t len) {
+  ClusterHeader header = {.type = type, .len = len};
+
+  pthread_mutex_lock(&CLUSTER.sending);
+
+  int fd = CLUSTER.fds[i];
+  int ok = fd >= 0 && send(fd, &header, sizeof(header), MSG_NOSIGNAL) == sizeof(header);
+
+  for (char* p = payload; ok && len;) {
+    ssize_t sent = send(fd, p, len, MSG_NOSIGNAL);
+    if (sent <= 0)
+      ok = 0;
+    else
+      p += sent, len -= sent;
+  }
+
+  pthread_mutex_unlock(&CLUSTER.sending);
+  return ok;
+}
+
+int ClusterRecv(int fd, void* buffer, size_t len) {
+  for (char* p = buffer; len;) {
+    ssize_t got = recv(fd, p, len, 0);
+    if (got <= 0)
+      return 0;
+
+    p += got, len -= got;
+  }
+
+  return 1;
+}
+
+#else
+
+int ClusterConnect(char* nodes) {
+  (void)nodes;
+  return 0;
+}
+
+void ClusterClose() {}
+
+void ClusterServe(int port, int threads, int hash, char* address) {
+  (void)port, (void)threads, (void)hash, (void)address;
+  printf("Cluster mode is not supported on this platform\n");
+}
+
+void* ClusterIOLoop(void* arg) {
+  return arg;
+}
+
+int ClusterSend(int i, uint32_t type, void* payload, uint32_t len) {
+  (void)i, (void)type, (void)payload, (void)len;
+  return 0;
+}
+
+int ClusterRecv(int fd, void* buffer, size_t len) {
+  (void)fd, (void)buffer, (void)len;
+  return 0;
+}
+
+#endif
+
+// handles one message of peer i, returns 0 when the peer is gone
+int ClusterReceive(int i) {
+  static ClusterMessage msg;
+  ClusterHeader header;
+
+  int fd = CLUSTER.fds[i];
+  if (!ClusterRecv(fd, &header, sizeof(header)) || header.len > sizeof(msg) || !ClusterRecv(fd, &msg, header.len))
+    return 0;
+
+  if (header.type == CLUSTER_TT) {
+    int n = header.len / sizeof(ClusterEntry);
+    for (int j = 0; j < n; j++) {
+      ClusterEntry* e = &msg.entries[j];
+      TTPut(e->hash, e->depth, e->score, e->flag, e->move, 0, e->eval);
+    }
+
+    // the master relays every worker's entries to the others
+    if (!CLUSTER.worker)
+      for (int j = 0; j < CLUSTER.count; j++)
+        if (j != i)
+          ClusterSend(j, CLUSTER_TT, &msg, header.len);
+  } else if (header.type == CLUSTER_RESULT && !CLUSTER.worker) {
+    // a late answer to an earlier search is dropped
+    pthread_mutex_lock(&CLUSTER.mutex);
+    if (CLUSTER.searching[i] && msg.result.id == CLUSTER.searchId) {
+      CLUSTER.results[CLUSTER.numResults++] = msg.result;
+      CLUSTER.searching[i] = 0;
+      CLUSTER.pending--;
+      pthread_cond_signal(&CLUSTER.answered);
+    }
+    pthread_mutex_unlock(&CLUSTER.mutex);
+  } else if (header.type == CLUSTER_SEARCH && CLUSTER.worker) {
+    // A search still running is stopped and answers before the next one
+    // starts, the master ignores that answer. The wait is short then, and
+    // the stop is only ever cleared here, before the wake
+    clusterParams.stopped = 1;
+    ThreadWaitUntilSleep(clusterThreads);
+
+    clusterSearchId = msg.job.id;
+
+    SearchParams* params = &clusterParams;
+    params->start = GetTimeMS();
+    params->depth = msg.job.depth;
+    params->clusterIdx = msg.job.idx;
+    params->quiet = 1;
+    params->stopped = 0;
+
+    memcpy(&clusterThreads->board, &msg.job.board, sizeof(Board));
+    clusterThreads->params = params;
+    ThreadWake(clusterThreads, ClusterSearch);
+  } else if (header.type == CLUSTER_STOP && CLUSTER.worker) {
+    clusterParams.stopped = 1;
+  }
+
+  return 1;
+}
+
+void ClusterDrop(int i) {
+  pthread_mutex_lock(&CLUSTER.sending);
+#ifndef _WIN32
+  close(CLUSTER.fds[i]);
+#endif
+  CLUSTER.fds[i] = -1;
+  pthread_mutex_unlock(&CLUSTER.sending);
+
+  pthread_mutex_lock(&CLUSTER.mutex);
+  if (CLUSTER.searching[i]) {
+    CLUSTER.searching[i] = 0;
+    CLUSTER.pending--;
+    pthread_cond_signal(&CLUSTER.answered);
+  }
+
+  pthread_mutex_unlock(&CLUSTER.mutex);
+}
+
+// Called by the search for deep stores. Entries wait for the io thread,
+// which keeps the socket writes away from the searchers. A searcher never
+// waits for the lock, the entry is dropped instead as with a full batch
+void ClusterShare(uint64_t hash, int depth, int score, int flag, Move move, int ply, int eval) {
+  if (score > MATE_BOUND)
+    score += ply;
+  else if (score < -MATE_BOUND)
+    score -= ply;
+
+  if (pthread_mutex_trylock(&CLUSTER.mutex))
+    return;
+
+  if (CLUSTER.batchLen < CLUSTER_BATCH)
+    CLUSTER.batch[CLUSTER.batchLen++] =
+        (ClusterEntry){.hash = hash, .move = move, .score = score, .eval = eval, .depth = depth, .flag = flag};
+  pthread_mutex_unlock(&CLUSTER.mutex);
+}
+
+// takes the batch out under the lock and sends it after, as output does
+void ClusterFlush() {
+  static ClusterEntry entries[CLUSTER_BATCH];
+
+  pthread_mutex_lock(&CLUSTER.mutex);
+  int n = CLUSTER.batchLen;
+  memcpy(entries, CLUSTER.batch, n * sizeof(ClusterEntry));
+  CLUSTER.batchLen = 0;
+  pthread_mutex_unlock(&CLUSTER.mutex);
+
+  if (!n)
+    return;
+
+  for (int i = 0; i < CLUSTER.count; i++)
+    ClusterSend(i, CLUSTER_TT, entries, n * sizeof(ClusterEntry));
+}
+
+// the workers search the same root until ClusterStop, each leaving out its own depths
+void ClusterGo(Board* board, SearchParams* params) {
+  static ClusterJob job;
+  memcpy(&job.board, board, sizeof(Board));
+  job.depth = params->depth;
+
+  // marked before the sends, an answer can come back before the last is out
+  pthread_mutex_lock(&CLUSTER.mutex);
+  job.id = ++CLUSTER.searchId;
+  CLUSTER.numResults = CLUSTER.pending = 0;
+  for (int i = 0; i < CLUSTER.count; i++)
+    if ((CLUSTER.searching[i] = CLUSTER.fds[i] >= 0))
+      CLUSTER.pending++;
+  pthread_mutex_unlock(&CLUSTER.mutex);
+
+  for (int i = 0; i < CLUSTER.count; i++) {
+    job.idx = i + 1;
+    if (ClusterSend(i, CLUSTER_SEARCH, &job, sizeof(job)))
+      continue;
+
+    pthread_mutex_lock(&CLUSTER.mutex);
+    if (CLUSTER.searching[i]) {
+      CLUSTER.searching[i] = 0;
+      CLUSTER.pending--;
+    }
+    pthread_mutex_unlock(&CLUSTER.mutex);
+  }
+}
+
+// Stops the workers and waits a little for their answers, a node that
+// is late is left out of the vote. BestMove keeps the wait out of the time
+void ClusterStop() {
+  int searching[CLUSTER_MAX_NODES];
+
+  pthread_mutex_lock(&CLUSTER.mutex);
+  memcpy(searching, CLUSTER.searching, sizeof(searching));
+  pthread_mutex_unlock(&CLUSTER.mutex);
+
+  for (int i = 0; i < CLUSTER.count; i++)
+    if (searching[i])
+      ClusterSend(i, CLUSTER_STOP, NULL, 0);
+
+  pthread_mutex_lock(&CLUSTER.mutex);
+
+  struct timespec until;
+  clock_gettime(CLOCK_REALTIME, &until);
+  until.tv_sec += CLUSTER_RESULT_MS / 1000;
+  until.tv_nsec += (CLUSTER_RESULT_MS % 1000) * 1000000;
+  if (until.tv_nsec >= 1000000000) {
+    until.tv_sec++;
+    until.tv_nsec -= 1000000000;
+  }
+
+  while (CLUSTER.pending > 0)
+    if (pthread_cond_timedwait(&CLUSTER.answered, &CLUSTER.mutex, &until))
+      break;
+
+  for (int i = 0; i < CLUSTER.count; i++)
+    CLUSTER.searching[i] = 0;
+  CLUSTER.pending = 0;
+
+  pthread_mutex_unlock(&CLUSTER.mutex);
+}
+
+// The nodes vote as the threads of one do in BestThread, with the best
+// thread of this node as the first voter. Returns 1 if another node won
+int ClusterVote(ThreadData* best) {
+  ClusterResult voters[CLUSTER_MAX_NODES + 1];
+  voters[0] = (ClusterResult){
+      .move = best->data.bestMove, .score = best->data.score, .depth = best->data.depth, .pv = best->pv};
+
+  pthread_mutex_lock(&CLUSTER.mutex);
+  int n = 1 + CLUSTER.numResults;
+  memcpy(voters + 1, CLUSTER.results, CLUSTER.numResults * sizeof(ClusterResult));
+  pthread_mutex_unlock(&CLUSTER.mutex);
+
+  int minScore = CHECKMATE;
+  for (int i = 0; i < n; i++)
+    if (voters[i].depth)
+      minScore = min(minScore, voters[i].score);
+
+  int winner = 0, bestVotes = 0;
+  for (int i = 0; i < n; i++) {
+    ClusterResult* voter = &voters[i];
+    if (!voter->depth)
+      continue;
+
+    int votes = 0;
+    for (int j = 0; j < n; j++)
+      if (voters[j].depth && voters[j].move == voter->move)
+        votes += (voters[j].score - minScore + 14) * voters[j].depth;
+
+    ClusterResult* leader = &voters[winner];
+    if (!leader->depth) {
+      winner = i, bestVotes = votes;
+    } else if (abs(leader->score) >= MATE_BOUND) {
+      if (voter->score > leader->score)
+        winner = i, bestVotes = votes;
+    } else if (voter->score >= MATE_BOUND || votes > bestVotes ||
+               (votes == bestVotes && voter->depth > leader->depth)) {
+      winner = i, bestVotes = votes;
+    }
+  }
+
+  if (!winner)
+    return 0;
+
+  best->data.bestMove = voters[winner].move;
+  best->data.score = voters[winner].score;
+  best->data.depth = voters[winner].depth;
+  best->pv = voters[winner].pv;
+
+  return 1;
+}
+
+// run by the main thread of a worker's pool, the answer goes back to the master
+void* ClusterSearch(void* arg) {
+  ThreadData* thread = (ThreadData*)arg;
+
+  BestMove(&thread->board, thread->params, thread->threads);
+  ThreadData* best = BestThread(thread->threads);
+
+  ClusterResult result = {.id = clusterSearchId,
+                          .move = best->data.bestMove,
+                          .score = best->data.score,
+                          .depth = best->data.depth,
+                          .pv = best->pv};
+
+  ClusterSend(0, CLUSTER_RESULT, &result, sizeof(result));
+
+  return NULL;
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include <pthread.h>
+
+#include "types.h"
+
+#define CLUSTER_MAX_NODES 64
+#define CLUSTER_TT_DEPTH 10    // shallower entries are not worth the bandwidth
+#define CLUSTER_BATCH 256      // entries per message, a full batch drops entries until sent
+#define CLUSTER_FLUSH_MS 5     // longest an entry waits to be sent
+#define CLUSTER_RESULT_MS 20   // longest a stopped search waits for the other nodes
+
+enum { CLUSTER_SEARCH, CLUSTER_STOP, CLUSTER_TT, CLUSTER_RESULT };
+
+typedef struct {
+  uint32_t type, len;
+} ClusterHeader;
+
+typedef struct {
+  uint64_t hash;
+  Move move;
+  int16_t score, eval; // score as stored, independent of ply
+  int8_t depth;
+  uint8_t flag;
+} ClusterEntry;
+
+typedef struct {
+  Board board;
+  int depth;
+  int idx;     // the node's number, which depths it leaves out
+  uint32_t id; // echoed in the answer
+} ClusterJob;
+
+typedef struct {
+  uint32_t id; // of the job answered
+  Move move;
+  int score, depth;
+  PV pv;
+} ClusterResult;
+
+typedef union {
+  ClusterJob job;
+  ClusterResult result;
+  ClusterEntry entries[CLUSTER_BATCH];
+} ClusterMessage;
+
+// Processes searching one position together over TCP, in a star around the
+// process the GUI talks to. Every node runs the same build, messages are raw structs
+typedef struct {
+  int count; // peers, the workers on the master and the master on a worker
+  int fds[CLUSTER_MAX_NODES];
+  int worker;
+  int stop;
+  pthread_t io;
+
+  pthread_mutex_t sending; // guards the writes to the sockets and closing them
+  pthread_mutex_t mutex;   // guards everything below, never held across a socket write
+  pthread_cond_t answered;
+  int batchLen;
+  ClusterEntry batch[CLUSTER_BATCH];
+
+  uint32_t searchId; // of the last search sent out
+  int pending;       // searches sent out and not answered yet
+  int searching[CLUSTER_MAX_NODES];
+  int numResults;
+  ClusterResult results[CLUSTER_MAX_NODES];
+} Cluster;
+
+extern Cluster CLUSTER;
+
+int ClusterConnect(char* nodes);
+void ClusterClose();
+void ClusterServe(int port, int threads, int hash, char* address);
+void* ClusterIOLoop(void* arg);
+int ClusterSend(int i, uint32_t type, void* payload, uint32_t len);
+int ClusterRecv(int fd, void* buffer, size_t len);
+int ClusterReceive(int i);
+void ClusterDrop(int i);
+
+void ClusterShare(uint64_t hash, int depth, int score, int flag, Move move, int ply, int eval);
+void ClusterFlush();
+void ClusterGo(Board* board, SearchParams* params);
+void ClusterStop();
+int ClusterVote(ThreadData* best);
+void* ClusterSearch(void* arg);
+
+#endif
\ No newline at end of file
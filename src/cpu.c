@@ -0,0 +1,63 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <stdio.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "cpu.h"
+#include "kernels.h"
+
+CPUFeatures CPU = {0};
+
+// what the machine supports, whatever the build uses. Kept off pext on AMD
+// before Zen 3 (family 19h), where it is microcoded and far slower than magics
+void InitCPU() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+
+  CPU.popcnt = !!__builtin_cpu_supports("popcnt");
+  CPU.bmi2 = !!__builtin_cpu_supports("bmi2");
+  CPU.avx2 = !!__builtin_cpu_supports("avx2");
+  CPU.avx512 =
+      __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl");
+
+  unsigned eax, ebx, ecx, edx;
+  int slowPext = 0;
+  if (__get_cpuid(0, &eax, &ebx, &ecx, &edx) && ebx == signature_AMD_ebx && ecx == signature_AMD_ecx &&
+      edx == signature_AMD_edx && __get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    int family = (eax >> 8) & 0xF;
+    if (family == 0xF)
+      family += (eax >> 20) & 0xFF;
+
+    slowPext = family < 0x19;
+  }
+
+  CPU.pext = CPU.bmi2 && !slowPext;
+#endif
+}
+
+void PrintCPU() {
+#if defined(DISPATCH)
+  const char* build = "dispatch";
+#else
+  const char* build = "fixed";
+#endif
+
+  printf("info string cpu popcnt %d bmi2 %d pext %d avx2 %d avx512 %d, %s kernels (%s build)\n", CPU.popcnt,
+         CPU.bmi2, CPU.pext, CPU.avx2, CPU.avx512, KERNELS, build);
+}
\ No newline at end of file
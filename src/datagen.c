@@ -0,0 +1,229 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bits.h"
+#include "board.h"
+#include "datagen.h"
+#include "move.h"
+#include "movegen.h"
+#include "search.h"
+#include "thread.h"
+#include "transposition.h"
+#include "util.h"
+
+// shared by the workers, the file is only written a whole game at a time
+FILE* datagenFile;
+pthread_mutex_t datagenLock = PTHREAD_MUTEX_INITIALIZER;
+atomic_uint_fast64_t datagenWritten;
+uint64_t datagenTarget;
+int datagenNodes, datagenDepth;
+
+void PackPosition(PackedPosition* packed, Board* board, float result, int score) {
+  memset(packed, 0, sizeof(PackedPosition));
+
+  packed->occupancy = board->occupancies[BOTH];
+
+  int i = 0;
+  for (BitBoard bb = packed->occupancy; bb; popLsb(bb), i++)
+    packed->pieces[i / 2] |= board->squares[lsb(bb)] << (4 * (i & 1));
+
+  packed->flags = board->side | (board->castling << 1) | ((int)(2 * result + 0.5) << 5);
+  packed->epSquare = board->epSquare;
+  packed->halfMove = board->halfMove;
+  packed->score = score;
+}
+
+// sets up the board and returns the result from white's view, as in the text files
+float UnpackPosition(PackedPosition* packed, Board* board) {
+  Board layout = {0};
+  for (int sq = 0; sq < 64; sq++)
+    layout.squares[sq] = NO_PIECE;
+
+  int i = 0;
+  for (BitBoard bb = packed->occupancy; bb; popLsb(bb), i++)
+    layout.squares[lsb(bb)] = (packed->pieces[i / 2] >> (4 * (i & 1))) & 0xF;
+
+  layout.side = packed->flags & 1;
+  layout.castling = (packed->flags >> 1) & 0xF;
+  layout.epSquare = packed->epSquare;
+  layout.halfMove = packed->halfMove;
+
+  char fen[128];
+  BoardToFen(fen, &layout);
+  ParseFen(fen, board);
+
+  return ((packed->flags >> 5) & 3) / 2.0;
+}
+
+// xorshift64*, the engine's generator is global and not safe to share
+uint64_t DatagenRandom(uint64_t* s) {
+  *s ^= *s >> 12;
+  *s ^= *s << 25;
+  *s ^= *s >> 27;
+  return *s * 2685821657736338717ULL;
+}
+
+// Plays one game from a few random opening moves, every side searching a fixed
+// number of nodes (or to a fixed depth). Quiet positions out of check are kept
+// with their white relative search score, the result is filled in at the end
+int PlayGame(ThreadData* thread, SearchParams* params, uint64_t* seed, PackedPosition* positions, float* result) {
+  Board board;
+  Move moves[MAX_MOVES];
+  int n = 0, winPlies = 0, drawPlies = 0;
+
+  ParseFen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", &board);
+
+  for (int i = 0; i < DATAGEN_RANDOM_PLIES; i++) {
+    int count = GenerateLegalMoves(moves, &board);
+    if (!count)
+      return 0;
+
+    MakeMove(moves[DatagenRandom(seed) % count], &board);
+  }
+
+  for (int ply = 0;; ply++) {
+    if (!GenerateLegalMoves(moves, &board)) {
+      *result = board.checkers ? (board.side == WHITE ? 0.0 : 1.0) : 0.5;
+      break;
+    }
+
+    if (ply >= DATAGEN_MAX_PLIES || board.halfMove >= 100 || IsRepetition(&board, 0) || IsMaterialDraw(&board)) {
+      *result = 0.5;
+      break;
+    }
+
+    params->start = GetTimeMS();
+    params->stopped = 0;
+    int score = BestMove(&board, params, thread);
+    Move move = thread->data.bestMove;
+    int whiteScore = board.side == WHITE ? score : -score;
+
+    winPlies = abs(score) >= DATAGEN_WIN_SCORE ? winPlies + 1 : 0;
+    drawPlies = abs(score) <= DATAGEN_DRAW_SCORE ? drawPlies + 1 : 0;
+
+    if (winPlies >= 4) {
+      *result = whiteScore > 0 ? 1.0 : 0.0;
+      break;
+    }
+
+    if (ply >= 80 && drawPlies >= 10) {
+      *result = 0.5;
+      break;
+    }
+
+    if (!board.checkers && !MoveCapture(move) && !MovePromo(move) && abs(score) < TB_WIN_BOUND)
+      PackPosition(&positions[n++], &board, 0.0, whiteScore);
+
+    MakeMove(move, &board);
+  }
+
+  return n;
+}
+
+void* DatagenWorker(void* arg) {
+  DatagenJob* job = (DatagenJob*)arg;
+
+  // a pool of one, searched from this thread
+  ThreadData* thread = CreatePool(1);
+  SearchParams params = {0};
+  params.quiet = 1;
+  params.sharedTT = 1;
+  params.nodes = datagenNodes;
+  params.depth = datagenDepth ? datagenDepth : MAX_SEARCH_PLY - 1;
+
+  PackedPosition* positions = malloc(sizeof(PackedPosition) * DATAGEN_MAX_PLIES);
+  uint64_t seed = job->seed;
+
+  while (atomic_load(&datagenWritten) < datagenTarget) {
+    float result;
+    int n = PlayGame(thread, &params, &seed, positions, &result);
+
+    for (int i = 0; i < n; i++)
+      positions[i].flags = (positions[i].flags & 0x1F) | ((int)(2 * result + 0.5) << 5);
+
+    pthread_mutex_lock(&datagenLock);
+    fwrite(positions, sizeof(PackedPosition), n, datagenFile);
+    pthread_mutex_unlock(&datagenLock);
+
+    atomic_fetch_add(&datagenWritten, n);
+    job->games++;
+  }
+
+  free(positions);
+  FreePool(thread);
+
+  return NULL;
+}
+
+// berserk datagen <out.bin> [threads] [positions] [nodes] [depth]
+// one game per thread, the positions are appended in the tuner's packed format
+void Datagen(char* path, int threads, uint64_t positions, int nodes, int depth) {
+  datagenFile = fopen(path, "ab");
+  if (datagenFile == NULL) {
+    printf("Unable to open %s\n", path);
+    return;
+  }
+
+  datagenTarget = positions;
+  datagenNodes = depth ? 0 : nodes;
+  datagenDepth = depth;
+  atomic_store(&datagenWritten, 0);
+
+  // the games share the hash table, their keys rarely meet. It is aged
+  // here once a second, never by the games themselves
+  TTInit(16 * threads, NULL);
+
+  pthread_t* workers = malloc(sizeof(pthread_t) * threads);
+  DatagenJob* jobs = calloc(threads, sizeof(DatagenJob));
+
+  long start = GetTimeMS();
+  for (int i = 0; i < threads; i++) {
+    jobs[i].idx = i;
+    jobs[i].seed = (start ^ (0x9E3779B97F4A7C15ULL * (i + 1))) | 1;
+    pthread_create(&workers[i], NULL, DatagenWorker, &jobs[i]);
+  }
+
+  uint64_t written;
+  while ((written = atomic_load(&datagenWritten)) < positions) {
+    SleepMS(1000);
+    TTUpdate();
+
+    long elapsed = max(1, GetTimeMS() - start);
+    printf("Generated %" PRIu64 " positions (%" PRIu64 "/s)\r", written, 1000 * written / elapsed);
+    fflush(stdout);
+  }
+
+  uint64_t games = 0;
+  for (int i = 0; i < threads; i++) {
+    pthread_join(workers[i], NULL);
+    games += jobs[i].games;
+  }
+
+  fclose(datagenFile);
+
+  printf("\nGenerated %" PRIu64 " positions from %" PRIu64 " games in %ld ms\n", atomic_load(&datagenWritten), games,
+         GetTimeMS() - start);
+
+  free(jobs);
+  free(workers);
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef DATAGEN_H
+#define DATAGEN_H
+
+#include "types.h"
+
+#define DATAGEN_RANDOM_PLIES 8
+#define DATAGEN_MAX_PLIES 400
+#define DATAGEN_WIN_SCORE 2000 // adjudicated as a win when held for 4 plies
+#define DATAGEN_DRAW_SCORE 10  // adjudicated as a draw when held for 10 plies after ply 80
+
+typedef struct {
+  int idx;
+  uint64_t seed;
+  uint64_t games;
+} DatagenJob;
+
+void PackPosition(PackedPosition* packed, Board* board, float result, int score);
+float UnpackPosition(PackedPosition* packed, Board* board);
+
+uint64_t DatagenRandom(uint64_t* s);
+void Datagen(char* path, int threads, uint64_t positions, int nodes, int depth);
+void* DatagenWorker(void* arg);
+int PlayGame(ThreadData* thread, SearchParams* params, uint64_t* seed, PackedPosition* positions, float* result);
+
+#endif
\ No newline at end of file
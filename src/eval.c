@@ -24,8 +24,11 @@
 #include "board.h"
 #include "endgame.h"
 #include "eval.h"
+#include "kernels.h"
+#include "material.h"
 #include "move.h"
 #include "movegen.h"
+#include "nnue.h"
 #include "pawns.h"
 #include "search.h"
 #include "tune.h"
@@ -40,7 +43,13 @@
 
 // a utility for texel tuning
 // berserk uses a coeff based tuner, ethereal's design
-EvalCoeffs C;
+// per thread so that the tuner can load positions in parallel
+_Thread_local EvalCoeffs C;
+
+// size of each thread's eval hash
+int EVAL_HASH_MB = 2;
+// how far the cheap terms must be outside the window to skip the rest
+int LAZY_MARGIN = 640;
 const int cs[2] = {1, -1};
 
 #define S(mg, eg) (makeScore((mg), (eg)))
@@ -53,11 +62,11 @@ const int STATIC_MATERIAL_VALUE[7] = {100, 565, 565, 705, 1000, 30000, 0};
 const int SHELTER_STORM_FILES[8][2] = {{0, 2}, {0, 2}, {1, 3}, {2, 4}, {3, 5}, {4, 6}, {5, 7}, {5, 7}};
 
 // clang-format off
-const Score MATERIAL_VALUES[7] = { S(100, 100), S(325, 325), S(325, 325), S(550, 550), S(1000, 1000), S(   0,   0), S(   0,   0) };
+Score MATERIAL_VALUES[7] = { S(100, 100), S(325, 325), S(325, 325), S(550, 550), S(1000, 1000), S(   0,   0), S(   0,   0) };
 
-const Score BISHOP_PAIR = S(22, 87);
+Score BISHOP_PAIR = S(22, 87);
 
-const Score PAWN_PSQT[2][32] = {{
+Score PAWN_PSQT[2][32] = {{
  S(   0,   0), S(   0,   0), S(   0,   0), S(   0,   0),
  S( 115, 195), S( 105, 219), S(  77, 214), S( 111, 189),
  S(  77, 129), S(  56, 147), S(  77,  94), S(  82,  74),
@@ -77,7 +86,7 @@ const Score PAWN_PSQT[2][32] = {{
  S(   0,   0), S(   0,   0), S(   0,   0), S(   0,   0),
 }};
 
-const Score KNIGHT_PSQT[2][32] = {{
+Score KNIGHT_PSQT[2][32] = {{
  S(-194,  49), S(-200,  71), S(-168,  79), S(-125,  59),
  S(-119,  72), S(-101,  78), S( -73,  64), S( -70,  66),
  S( -64,  55), S( -66,  63), S( -68,  75), S( -77,  76),
@@ -97,7 +106,7 @@ const Score KNIGHT_PSQT[2][32] = {{
  S( -90,  59), S( -94,  58), S( -78,  52), S( -75,  66),
 }};
 
-const Score BISHOP_PSQT[2][32] = {{
+Score BISHOP_PSQT[2][32] = {{
  S( -25, 107), S( -45, 129), S( -30, 110), S( -49, 128),
  S(  -6, 111), S( -19,  99), S(  20, 104), S(   7, 117),
  S(  14, 114), S(  18, 115), S( -13,  99), S(  21, 106),
@@ -117,7 +126,7 @@ const Score BISHOP_PSQT[2][32] = {{
  S(  36,  45), S(  31, 113), S(  25, 106), S(  39,  98),
 }};
 
-const Score ROOK_PSQT[2][32] = {{
+Score ROOK_PSQT[2][32] = {{
  S(-107, 225), S( -98, 230), S( -98, 233), S(-125, 235),
  S( -99, 218), S(-104, 229), S( -84, 227), S( -68, 212),
  S(-113, 225), S( -77, 220), S( -87, 221), S( -85, 215),
@@ -137,7 +146,7 @@ const Score ROOK_PSQT[2][32] = {{
  S(-105, 201), S( -86, 193), S( -91, 195), S( -83, 194),
 }};
 
-const Score QUEEN_PSQT[2][32] = {{
+Score QUEEN_PSQT[2][32] = {{
  S(-118, 396), S( -41, 302), S(  -7, 306), S( -17, 331),
  S( -50, 329), S( -43, 308), S( -28, 335), S( -36, 338),
  S( -22, 305), S( -15, 295), S( -25, 329), S(  -6, 323),
@@ -157,7 +166,7 @@ const Score QUEEN_PSQT[2][32] = {{
  S(  17, 234), S( -13, 251), S( -11, 237), S(  -5, 256),
 }};
 
-const Score KING_PSQT[2][32] = {{
+Score KING_PSQT[2][32] = {{
  S( 235,-142), S( 134, -61), S( -28, -16), S(  99, -42),
  S( -91,  53), S( -27,  66), S(  -2,  53), S(  37,  21),
  S(  20,  39), S(   2,  73), S(  28,  62), S(  -9,  65),
@@ -177,36 +186,36 @@ const Score KING_PSQT[2][32] = {{
  S(  15, -62), S(  18, -15), S(   4, -25), S( -32, -34),
 }};
 
-const Score KNIGHT_POST_PSQT[12] = {
+Score KNIGHT_POST_PSQT[12] = {
  S( -45,  10), S(   7,  20), S(  29,  23), S(  61,  36),
  S(  14,  -3), S(  40,  18), S(  30,  27), S(  42,  35),
  S(  21,  -3), S(  34,  10), S(  21,  15), S(  21,  22),
 };
 
-const Score BISHOP_POST_PSQT[12] = {
+Score BISHOP_POST_PSQT[12] = {
  S(  -3,   8), S(  23,   6), S(  60,  13), S(  62,   8),
  S(   2,   0), S(  26,  12), S(  41,   5), S(  52,   9),
  S(  -7,  24), S(  44,   7), S(  30,  12), S(  38,  20),
 };
 
-const Score KNIGHT_MOBILITIES[9] = {
+Score KNIGHT_MOBILITIES[9] = {
  S(-159, -34), S(-117,  39), S(-100,  79), S( -88,  92),
  S( -79, 105), S( -71, 116), S( -63, 119), S( -54, 121),
  S( -46, 112),};
 
-const Score BISHOP_MOBILITIES[14] = {
+Score BISHOP_MOBILITIES[14] = {
  S( -16,  48), S(   8,  74), S(  21,  94), S(  28, 115),
  S(  34, 124), S(  38, 134), S(  40, 141), S(  45, 143),
  S(  45, 146), S(  49, 146), S(  57, 143), S(  70, 137),
  S(  71, 144), S(  79, 130),};
 
-const Score ROOK_MOBILITIES[15] = {
+Score ROOK_MOBILITIES[15] = {
  S( -87, -72), S(-102, 143), S( -87, 177), S( -80, 182),
  S( -82, 204), S( -78, 212), S( -82, 222), S( -78, 223),
  S( -74, 229), S( -69, 233), S( -66, 237), S( -69, 242),
  S( -65, 244), S( -56, 248), S( -44, 242),};
 
-const Score QUEEN_MOBILITIES[28] = {
+Score QUEEN_MOBILITIES[28] = {
  S(-1850,-1375), S(-119,-386), S( -79, 115), S( -56, 241),
  S( -45, 284), S( -39, 296), S( -40, 329), S( -40, 355),
  S( -38, 373), S( -36, 378), S( -34, 385), S( -31, 386),
@@ -216,82 +225,82 @@ const Score QUEEN_MOBILITIES[28] = {
  S(  66, 152), S( 187,  26), S(  37,  28), S(  37,  -3),
 };
 
-const Score MINOR_BEHIND_PAWN = S(5, 14);
+Score MINOR_BEHIND_PAWN = S(5, 14);
 
-const Score KNIGHT_OUTPOST_REACHABLE = S(10, 19);
+Score KNIGHT_OUTPOST_REACHABLE = S(10, 19);
 
-const Score BISHOP_OUTPOST_REACHABLE = S(7, 6);
+Score BISHOP_OUTPOST_REACHABLE = S(7, 6);
 
-const Score BISHOP_TRAPPED = S(-116, -232);
+Score BISHOP_TRAPPED = S(-116, -232);
 
-const Score ROOK_TRAPPED = S(-43, -33);
+Score ROOK_TRAPPED = S(-43, -33);
 
-const Score BAD_BISHOP_PAWNS = S(-1, -4);
+Score BAD_BISHOP_PAWNS = S(-1, -4);
 
-const Score DRAGON_BISHOP = S(23, 17);
+Score DRAGON_BISHOP = S(23, 17);
 
-const Score ROOK_OPEN_FILE = S(28, 15);
+Score ROOK_OPEN_FILE = S(28, 15);
 
-const Score ROOK_SEMI_OPEN = S(16, 5);
+Score ROOK_SEMI_OPEN = S(16, 5);
 
-const Score DEFENDED_PAWN = S(11, 11);
+Score DEFENDED_PAWN = S(11, 11);
 
-const Score DOUBLED_PAWN = S(16, -35);
+Score DOUBLED_PAWN = S(16, -35);
 
-const Score ISOLATED_PAWN[4] = {
+Score ISOLATED_PAWN[4] = {
  S(  -1,  -5), S(   0, -13), S(  -7,  -5), S(   1, -13),
 };
 
-const Score OPEN_ISOLATED_PAWN = S(-5, -11);
+Score OPEN_ISOLATED_PAWN = S(-5, -11);
 
-const Score BACKWARDS_PAWN = S(-9, -18);
+Score BACKWARDS_PAWN = S(-9, -18);
 
-const Score CONNECTED_PAWN[8] = {
+Score CONNECTED_PAWN[8] = {
  S(   0,   0), S(  85,  44), S(  27,  38), S(  10,  13),
  S(   6,   3), S(   5,   2), S(   2,   0), S(   0,   0),
 };
 
-const Score CANDIDATE_PASSER[8] = {
+Score CANDIDATE_PASSER[8] = {
  S(   0,   0), S(   0,   0), S( 141, 157), S(  13,  72),
  S( -14,  60), S( -23,  39), S( -36,  15), S(   0,   0),
 };
 
-const Score CANDIDATE_EDGE_DISTANCE = S(4, -11);
+Score CANDIDATE_EDGE_DISTANCE = S(4, -11);
 
-const Score PASSED_PAWN[8] = {
+Score PASSED_PAWN[8] = {
  S(   0,   0), S( 117, 183), S(  43, 182), S(  12, 113),
  S( -12,  75), S( -11,  42), S( -10,  37), S(   0,   0),
 };
 
-const Score PASSED_PAWN_EDGE_DISTANCE = S(1, -11);
+Score PASSED_PAWN_EDGE_DISTANCE = S(1, -11);
 
-const Score PASSED_PAWN_KING_PROXIMITY = S(-6, 23);
+Score PASSED_PAWN_KING_PROXIMITY = S(-6, 23);
 
-const Score PASSED_PAWN_ADVANCE_DEFENDED[5] = {
+Score PASSED_PAWN_ADVANCE_DEFENDED[5] = {
  S(   0,   0), S(  84, 241), S(  16, 136), S(   9,  46), S(  12,  10),
 };
 
-const Score PASSED_PAWN_ENEMY_SLIDER_BEHIND = S(26, -111);
+Score PASSED_PAWN_ENEMY_SLIDER_BEHIND = S(26, -111);
 
-const Score PASSED_PAWN_SQ_RULE = S(0, 360);
+Score PASSED_PAWN_SQ_RULE = S(0, 360);
 
-const Score KNIGHT_THREATS[6] = { S(1, 18), S(-2, 46), S(29, 32), S(76, -1), S(50, -56), S(0, 0),};
+Score KNIGHT_THREATS[6] = { S(1, 18), S(-2, 46), S(29, 32), S(76, -1), S(50, -56), S(0, 0),};
 
-const Score BISHOP_THREATS[6] = { S(2, 18), S(21, 33), S(-60, 86), S(58, 10), S(63, 85), S(0, 0),};
+Score BISHOP_THREATS[6] = { S(2, 18), S(21, 33), S(-60, 86), S(58, 10), S(63, 85), S(0, 0),};
 
-const Score ROOK_THREATS[6] = { S(0, 20), S(30, 40), S(29, 52), S(3, 22), S(76, -7), S(0, 0),};
+Score ROOK_THREATS[6] = { S(0, 20), S(30, 40), S(29, 52), S(3, 22), S(76, -7), S(0, 0),};
 
-const Score KING_THREAT = S(11, 30);
+Score KING_THREAT = S(11, 30);
 
-const Score PAWN_THREAT = S(71, 32);
+Score PAWN_THREAT = S(71, 32);
 
-const Score PAWN_PUSH_THREAT = S(18, 19);
+Score PAWN_PUSH_THREAT = S(18, 19);
 
-const Score HANGING_THREAT = S(5, 9);
+Score HANGING_THREAT = S(5, 9);
 
-const Score SPACE = 105;
+Score SPACE = 105;
 
-const Score IMBALANCE[5][5] = {
+Score IMBALANCE[5][5] = {
  { S(0, 0),},
  { S(10, 25), S(0, 0),},
  { S(6, 20), S(-10, -30), S(0, 0),},
@@ -299,49 +308,49 @@ const Score IMBALANCE[5][5] = {
  { S(56, 47), S(-65, 11), S(-11, 76), S(-208, 150), S(0, 0),},
 };
 
-const Score PAWN_SHELTER[4][8] = {
+Score PAWN_SHELTER[4][8] = {
  { S(-21, -4), S(13, 93), S(-1, 49), S(-12, 7), S(7, -5), S(37, -26), S(34, -49), S(0, 0),},
  { S(-43, 1), S(-12, 75), S(-19, 44), S(-30, 21), S(-26, 7), S(24, -18), S(32, -32), S(0, 0),},
  { S(-21, -12), S(0, 86), S(-34, 35), S(-11, 8), S(-13, -3), S(-3, -8), S(30, -20), S(0, 0),},
  { S(-37, 16), S(12, 74), S(-58, 35), S(-29, 28), S(-28, 22), S(-17, 13), S(-25, 22), S(0, 0),},
 };
 
-const Score PAWN_STORM[4][8] = {
+Score PAWN_STORM[4][8] = {
  { S(-21, -12), S(-24, -3), S(-24, -8), S(-29, 4), S(-56, 31), S(62, 79), S(275, 75), S(0, 0),},
  { S(-13, 0), S(2, -6), S(2, -4), S(-12, 9), S(-27, 21), S(-28, 84), S(104, 129), S(0, 0),},
  { S(27, -5), S(28, -8), S(24, -4), S(6, 5), S(-14, 18), S(-47, 75), S(57, 96), S(0, 0),},
  { S(-3, -4), S(2, -11), S(14, -10), S(3, -11), S(-20, 6), S(-16, 47), S(-35, 119), S(0, 0),},
 };
 
-const Score BLOCKED_PAWN_STORM[8] = {
+Score BLOCKED_PAWN_STORM[8] = {
  S(3, -44), S(36, -51), S(17, -36), S(15, -31), S(4, -24), S(6, -84), S(0, 0), S(0, 0),
 };
 
-const Score CAN_CASTLE = S(43, -18);
+Score CAN_CASTLE = S(43, -18);
 
-const Score KS_ATTACKER_WEIGHTS[5] = {
+Score KS_ATTACKER_WEIGHTS[5] = {
  0, 33, 32, 19, 25
 };
 
-const Score KS_WEAK_SQS = 78;
+Score KS_WEAK_SQS = 78;
 
-const Score KS_PINNED = 74;
+Score KS_PINNED = 74;
 
-const Score KS_KNIGHT_CHECK = 279;
+Score KS_KNIGHT_CHECK = 279;
 
-const Score KS_BISHOP_CHECK = 311;
+Score KS_BISHOP_CHECK = 311;
 
-const Score KS_ROOK_CHECK = 272;
+Score KS_ROOK_CHECK = 272;
 
-const Score KS_QUEEN_CHECK = 213;
+Score KS_QUEEN_CHECK = 213;
 
-const Score KS_UNSAFE_CHECK = 57;
+Score KS_UNSAFE_CHECK = 57;
 
-const Score KS_ENEMY_QUEEN = -190;
+Score KS_ENEMY_QUEEN = -190;
 
-const Score KS_KNIGHT_DEFENSE = -87;
+Score KS_KNIGHT_DEFENSE = -87;
 
-const Score TEMPO = 20;
+Score TEMPO = 20;
 // clang-format on
 
 Score PSQT[12][2][64];
@@ -387,12 +396,15 @@ inline int GetPhase(Board* board) {
 // scale down the score quadratically based on strong sides remaining pawns
 // i.e. no pawns = scalar of 52 / 100
 inline int Scale(Board* board, int ss) {
+  int scale = MaterialScale(board, ss);
+  return scale && IsOCB(board) ? 64 : scale;
+}
+
+// the part of Scale that only depends on material (all but OCB)
+inline int MaterialScale(Board* board, int ss) {
   if (bits(board->occupancies[ss]) == 2 && (board->pieces[KNIGHT[ss]] | board->pieces[BISHOP[ss]]))
     return 0;
 
-  if (IsOCB(board))
-    return 64;
-
   int ssPawns = bits(board->pieces[PAWN[ss]]);
   return MAX_SCALE - (8 - ssPawns) * (8 - ssPawns);
 }
@@ -400,6 +412,7 @@ inline int Scale(Board* board, int ss) {
 // preload a bunch of important evalution data
 void InitEvalData(EvalData* data, Board* board) {
   data->passedPawns = 0ULL;
+  data->pawnEntry = NULL;
 
   BitBoard whitePawns = board->pieces[PAWN_WHITE];
   BitBoard blackPawns = board->pieces[PAWN_BLACK];
@@ -509,7 +522,19 @@ Score PieceEval(Board* board, EvalData* data, int side) {
   if (T)
     C.minorBehindPawn += bits(minorsBehindPawns) * cs[side];
 
-  for (int p = KNIGHT[side]; p <= KING[side]; p += 2) {
+  // Calculate a mobility bonus - bishops/rooks can see through queen/rook
+  // because batteries shouldn't "limit" mobility. Slider attacks are kept
+  // incrementally, see UpdateSliderAttacks. All pieces are counted at once
+  // TODO: Consider queen behind rook acceptable?
+  BitBoard movements[16];
+  int mobilities[16], n = 0;
+  for (int p = KNIGHT[side]; p <= QUEEN[side]; p += 2)
+    for (BitBoard pieces = board->pieces[p]; pieces; popLsb(pieces))
+      movements[n++] = p == KNIGHT[side] ? GetKnightAttacks(lsb(pieces)) : board->sliderAttacks[lsb(pieces)];
+
+  BitsMasked(movements, mob, n, mobilities);
+
+  for (int p = KNIGHT[side], i = 0; p <= KING[side]; p += 2) {
     BitBoard pieces = board->pieces[p];
     int pieceType = PIECE_TYPE[p];
 
@@ -517,39 +542,39 @@ Score PieceEval(Board* board, EvalData* data, int side) {
       BitBoard bb = pieces & -pieces;
       int sq = lsb(pieces);
 
-      // Calculate a mobility bonus - bishops/rooks can see through queen/rook
-      // because batteries shouldn't "limit" mobility
-      // TODO: Consider queen behind rook acceptable?
       BitBoard movement = EMPTY;
       switch (pieceType) {
       case KNIGHT_TYPE:
-        movement = GetKnightAttacks(sq);
-        s += KNIGHT_MOBILITIES[bits(movement & mob)];
+        movement = movements[i];
+        s += KNIGHT_MOBILITIES[mobilities[i]];
 
         if (T)
-          C.knightMobilities[bits(movement & mob)] += cs[side];
+          C.knightMobilities[mobilities[i]] += cs[side];
+        i++;
         break;
       case BISHOP_TYPE:
-        movement = GetBishopAttacks(sq, board->occupancies[BOTH] ^ board->pieces[QUEEN[side]]);
-        s += BISHOP_MOBILITIES[bits(movement & mob)];
+        movement = movements[i];
+        s += BISHOP_MOBILITIES[mobilities[i]];
 
         if (T)
-          C.bishopMobilities[bits(movement & mob)] += cs[side];
+          C.bishopMobilities[mobilities[i]] += cs[side];
+        i++;
         break;
       case ROOK_TYPE:
-        movement =
-            GetRookAttacks(sq, board->occupancies[BOTH] ^ board->pieces[ROOK[side]] ^ board->pieces[QUEEN[side]]);
-        s += ROOK_MOBILITIES[bits(movement & mob)];
+        movement = movements[i];
+        s += ROOK_MOBILITIES[mobilities[i]];
 
         if (T)
-          C.rookMobilities[bits(movement & mob)] += cs[side];
+          C.rookMobilities[mobilities[i]] += cs[side];
+        i++;
         break;
       case QUEEN_TYPE:
-        movement = GetQueenAttacks(sq, board->occupancies[BOTH]);
-        s += QUEEN_MOBILITIES[bits(movement & mob)];
+        movement = movements[i];
+        s += QUEEN_MOBILITIES[mobilities[i]];
 
         if (T)
-          C.queenMobilities[bits(movement & mob)] += cs[side];
+          C.queenMobilities[mobilities[i]] += cs[side];
+        i++;
         break;
       case KING_TYPE:
         movement = GetKingAttacks(sq) & ~enemyKingArea;
@@ -776,8 +801,8 @@ Score Threats(Board* board, EvalData* data, int side) {
 // This fit for KS is strong as it can ignore a single piece attacking, but will
 // spike on a secondary piece joining.
 // It is heavily influenced by Toga, Rebel, SF, and Ethereal
-Score KingSafety(Board* board, EvalData* data, int side) {
-  Score s = S(0, 0);
+// pawn shelter includes, pawns in front of king/enemy pawn storm (blocked/moving)
+Score KingShelter(Board* board, EvalData* data, int side) {
   Score shelter = S(0, 0);
 
   int xside = side ^ 1;
@@ -786,7 +811,6 @@ Score KingSafety(Board* board, EvalData* data, int side) {
                       ~FORWARD_RANK_MASKS[xside][rank(data->kingSq[side])];
   BitBoard opponentPawns = board->pieces[PAWN[xside]] & ~FORWARD_RANK_MASKS[xside][rank(data->kingSq[side])];
 
-  // pawn shelter includes, pawns in front of king/enemy pawn storm (blocked/moving)
   for (int file = SHELTER_STORM_FILES[file(data->kingSq[side])][0];
        file <= SHELTER_STORM_FILES[file(data->kingSq[side])][1]; file++) {
     int adjustedFile = file > 3 ? 7 - file : file;
@@ -812,6 +836,27 @@ Score KingSafety(Board* board, EvalData* data, int side) {
     }
   }
 
+  return shelter;
+}
+
+Score KingSafety(Board* board, EvalData* data, int side) {
+  Score s = S(0, 0);
+  Score shelter;
+
+  int xside = side ^ 1;
+
+  PawnHashEntry* pawnEntry = data->pawnEntry;
+  if (pawnEntry && pawnEntry->shelterKingSq[side] == data->kingSq[side]) {
+    shelter = pawnEntry->shelter[side];
+  } else {
+    shelter = KingShelter(board, data, side);
+
+    if (pawnEntry) {
+      pawnEntry->shelter[side] = shelter;
+      pawnEntry->shelterKingSq[side] = data->kingSq[side];
+    }
+  }
+
   uint8_t rights = side == WHITE ? (board->castling & 0xC) : (board->castling & 0x3);
 
   shelter += CAN_CASTLE * bits((uint64_t)rights);
@@ -915,21 +960,63 @@ Score Imbalance(Board* board, int side) {
 }
 
 // Main evalution method
+inline EvalHashEntry* TTEvalProbe(uint64_t hash, ThreadData* thread) {
+  EvalHashEntry* entry = &thread->evalHashTable[hash & thread->evalHashMask];
+  return entry->key == (uint32_t)(hash >> 32) ? entry : NULL;
+}
+
+inline void TTEvalPut(uint64_t hash, Score eval, ThreadData* thread) {
+  EvalHashEntry* entry = &thread->evalHashTable[hash & thread->evalHashMask];
+  *entry = (EvalHashEntry){.key = hash >> 32, .eval = eval};
+}
+
 Score Evaluate(Board* board, ThreadData* thread) {
-  if (IsMaterialDraw(board))
-    return 0;
+  int lazy = 0;
+  return EvaluateLazy(board, thread, -CHECKMATE, CHECKMATE, &lazy);
+}
 
-  Score eval = UNKNOWN;
-  if (bits(board->occupancies[BOTH]) == 3) {
-    eval = EvaluateKXK(board);
-  } else if (!(board->pieces[PAWN_WHITE] | board->pieces[PAWN_BLACK])) {
-    eval = EvaluateMaterialOnlyEndgame(board);
-  }
+// taper and scale a white relative score into one from the side to move
+inline Score Finalize(Board* board, MaterialEntry* material, Score s) {
+  int phase = material->phase;
+  Score res = (phase * scoreMG(s) + (128 - phase) * scoreEG(s)) / 128;
+
+  if (T)
+    C.ss = res >= 0 ? WHITE : BLACK;
+
+  // scale the score
+  int scale = material->scale[res >= 0 ? WHITE : BLACK];
+  if (scale && material->ocbCandidate && IsOCB(board))
+    scale = 64;
+
+  res = (res * scale) / MAX_SCALE;
+  return TEMPO + (board->side == WHITE ? res : -res);
+}
+
+// Evaluate, but stop after material, pawns and imbalance when those are
+// LAZY_MARGIN outside of [alpha, beta]. Such a result is never hashed and
+// raises *lazy, anything else leaves it as it was
+Score EvaluateLazy(Board* board, ThreadData* thread, int alpha, int beta, int* lazy) {
+  MaterialEntry* material = MaterialProbe(board, thread);
+  if (material->draw)
+    return 0;
 
   // A specific endgame calculation returned a score
+  Score eval = material->endgame ? material->endgame(board) : UNKNOWN;
   if (eval != UNKNOWN)
     return eval;
 
+  if (!T) {
+    EvalHashEntry* evalEntry = TTEvalProbe(board->zobrist, thread);
+    if (evalEntry != NULL)
+      return evalEntry->eval;
+
+    if (USE_NNUE) {
+      Score res = NNUEEvaluate(board, thread);
+      TTEvalPut(board->zobrist, res, thread);
+      return res;
+    }
+  }
+
   EvalData data;
   InitEvalData(&data, board);
 
@@ -947,16 +1034,29 @@ Score Evaluate(Board* board, ThreadData* thread) {
       data.passedPawns = pawnEntry->passedPawns;
     } else {
       Score pawnS = PawnEval(board, &data, WHITE) - PawnEval(board, &data, BLACK);
-      TTPawnPut(board->pawnHash, pawnS, data.passedPawns, thread);
+      pawnEntry = TTPawnPut(board->pawnHash, pawnS, data.passedPawns, thread);
       s += pawnS;
     }
+
+    data.pawnEntry = pawnEntry;
   } else {
     s += PawnEval(board, &data, WHITE) - PawnEval(board, &data, BLACK);
   }
 
-  s += Imbalance(board, WHITE) - Imbalance(board, BLACK);
+  s += T ? Imbalance(board, WHITE) - Imbalance(board, BLACK) : material->imbalance;
+
+  if (!T) {
+    Score partial = Finalize(board, material, s);
+    if (partial - LAZY_MARGIN >= beta || partial + LAZY_MARGIN <= alpha) {
+      thread->lazyEvals++;
+      *lazy = 1;
+      return partial;
+    }
+  }
 
   if (T || abs(scoreMG(s) + scoreEG(s)) / 2 < 1024) {
+    UpdateSliderAttacks(board);
+
     s += PieceEval(board, &data, WHITE) - PieceEval(board, &data, BLACK);
     s += PasserEval(board, &data, WHITE) - PasserEval(board, &data, BLACK);
     s += Threats(board, &data, WHITE) - Threats(board, &data, BLACK);
@@ -964,14 +1064,10 @@ Score Evaluate(Board* board, ThreadData* thread) {
     s += Space(board, &data, WHITE) - Space(board, &data, BLACK);
   }
 
-  // taper
-  int phase = GetPhase(board);
-  Score res = (phase * scoreMG(s) + (128 - phase) * scoreEG(s)) / 128;
+  Score res = Finalize(board, material, s);
 
-  if (T)
-    C.ss = res >= 0 ? WHITE : BLACK;
+  if (!T)
+    TTEvalPut(board->zobrist, res, thread);
 
-  // scale the score
-  res = (res * Scale(board, res >= 0 ? WHITE : BLACK)) / MAX_SCALE;
-  return TEMPO + (board->side == WHITE ? res : -res);
+  return res;
 }
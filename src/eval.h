@@ -28,7 +28,9 @@
 #define rel(sq, side) ((side) ? MIRROR[(sq)] : (sq))
 #define distance(a, b) max(abs(rank(a) - rank(b)), abs(file(a) - file(b)))
 
-extern EvalCoeffs C;
+extern _Thread_local EvalCoeffs C;
+extern int EVAL_HASH_MB;
+extern int LAZY_MARGIN;
 
 extern const int MAX_SCALE;
 extern const int MAX_PHASE;
@@ -36,88 +38,94 @@ extern const Score PHASE_MULTIPLIERS[5];
 
 extern const int STATIC_MATERIAL_VALUE[7];
 
-extern const Score MATERIAL_VALUES[7];
-extern const Score BISHOP_PAIR;
-
-extern const Score PAWN_PSQT[2][32];
-extern const Score KNIGHT_PSQT[2][32];
-extern const Score BISHOP_PSQT[2][32];
-extern const Score ROOK_PSQT[2][32];
-extern const Score QUEEN_PSQT[2][32];
-extern const Score KING_PSQT[2][32];
-
-extern const Score KNIGHT_POST_PSQT[12];
-extern const Score BISHOP_POST_PSQT[12];
-
-extern const Score KNIGHT_MOBILITIES[9];
-extern const Score BISHOP_MOBILITIES[14];
-extern const Score ROOK_MOBILITIES[15];
-extern const Score QUEEN_MOBILITIES[28];
-
-extern const Score MINOR_BEHIND_PAWN;
-extern const Score KNIGHT_OUTPOST_REACHABLE;
-extern const Score BISHOP_OUTPOST_REACHABLE;
-extern const Score BISHOP_TRAPPED;
-extern const Score ROOK_TRAPPED;
-extern const Score BAD_BISHOP_PAWNS;
-extern const Score DRAGON_BISHOP;
-extern const Score ROOK_OPEN_FILE;
-extern const Score ROOK_SEMI_OPEN;
-
-extern const Score DEFENDED_PAWN;
-extern const Score DOUBLED_PAWN;
-extern const Score ISOLATED_PAWN[4];
-extern const Score OPEN_ISOLATED_PAWN;
-extern const Score BACKWARDS_PAWN;
-extern const Score CONNECTED_PAWN[8];
-extern const Score CANDIDATE_PASSER[8];
-extern const Score CANDIDATE_EDGE_DISTANCE;
-
-extern const Score PASSED_PAWN[8];
-extern const Score PASSED_PAWN_ADVANCE_DEFENDED[5];
-extern const Score PASSED_PAWN_EDGE_DISTANCE;
-extern const Score PASSED_PAWN_KING_PROXIMITY;
-extern const Score PASSED_PAWN_ENEMY_SLIDER_BEHIND;
-extern const Score PASSED_PAWN_SQ_RULE;
-
-extern const Score KNIGHT_THREATS[6];
-extern const Score BISHOP_THREATS[6];
-extern const Score ROOK_THREATS[6];
-extern const Score KING_THREAT;
-extern const Score PAWN_THREAT;
-extern const Score PAWN_PUSH_THREAT;
-extern const Score HANGING_THREAT;
-
-extern const Score SPACE;
-
-extern const Score IMBALANCE[5][5];
-
-extern const Score TEMPO;
-
-extern const Score PAWN_SHELTER[4][8];
-extern const Score PAWN_STORM[4][8];
-extern const Score BLOCKED_PAWN_STORM[8];
-extern const Score CAN_CASTLE;
-
-extern const Score KS_ATTACKER_WEIGHTS[5];
-extern const Score KS_PINNED;
-extern const Score KS_WEAK_SQS;
-extern const Score KS_KNIGHT_CHECK;
-extern const Score KS_BISHOP_CHECK;
-extern const Score KS_ROOK_CHECK;
-extern const Score KS_QUEEN_CHECK;
-extern const Score KS_UNSAFE_CHECK;
-extern const Score KS_ENEMY_QUEEN;
-extern const Score KS_KNIGHT_DEFENSE;
+extern Score MATERIAL_VALUES[7];
+extern Score BISHOP_PAIR;
+
+extern Score PAWN_PSQT[2][32];
+extern Score KNIGHT_PSQT[2][32];
+extern Score BISHOP_PSQT[2][32];
+extern Score ROOK_PSQT[2][32];
+extern Score QUEEN_PSQT[2][32];
+extern Score KING_PSQT[2][32];
+
+extern Score KNIGHT_POST_PSQT[12];
+extern Score BISHOP_POST_PSQT[12];
+
+extern Score KNIGHT_MOBILITIES[9];
+extern Score BISHOP_MOBILITIES[14];
+extern Score ROOK_MOBILITIES[15];
+extern Score QUEEN_MOBILITIES[28];
+
+extern Score MINOR_BEHIND_PAWN;
+extern Score KNIGHT_OUTPOST_REACHABLE;
+extern Score BISHOP_OUTPOST_REACHABLE;
+extern Score BISHOP_TRAPPED;
+extern Score ROOK_TRAPPED;
+extern Score BAD_BISHOP_PAWNS;
+extern Score DRAGON_BISHOP;
+extern Score ROOK_OPEN_FILE;
+extern Score ROOK_SEMI_OPEN;
+
+extern Score DEFENDED_PAWN;
+extern Score DOUBLED_PAWN;
+extern Score ISOLATED_PAWN[4];
+extern Score OPEN_ISOLATED_PAWN;
+extern Score BACKWARDS_PAWN;
+extern Score CONNECTED_PAWN[8];
+extern Score CANDIDATE_PASSER[8];
+extern Score CANDIDATE_EDGE_DISTANCE;
+
+extern Score PASSED_PAWN[8];
+extern Score PASSED_PAWN_ADVANCE_DEFENDED[5];
+extern Score PASSED_PAWN_EDGE_DISTANCE;
+extern Score PASSED_PAWN_KING_PROXIMITY;
+extern Score PASSED_PAWN_ENEMY_SLIDER_BEHIND;
+extern Score PASSED_PAWN_SQ_RULE;
+
+extern Score KNIGHT_THREATS[6];
+extern Score BISHOP_THREATS[6];
+extern Score ROOK_THREATS[6];
+extern Score KING_THREAT;
+extern Score PAWN_THREAT;
+extern Score PAWN_PUSH_THREAT;
+extern Score HANGING_THREAT;
+
+extern Score SPACE;
+
+extern Score IMBALANCE[5][5];
+
+extern Score TEMPO;
+
+extern Score PAWN_SHELTER[4][8];
+extern Score PAWN_STORM[4][8];
+extern Score BLOCKED_PAWN_STORM[8];
+extern Score CAN_CASTLE;
+
+extern Score KS_ATTACKER_WEIGHTS[5];
+extern Score KS_PINNED;
+extern Score KS_WEAK_SQS;
+extern Score KS_KNIGHT_CHECK;
+extern Score KS_BISHOP_CHECK;
+extern Score KS_ROOK_CHECK;
+extern Score KS_QUEEN_CHECK;
+extern Score KS_UNSAFE_CHECK;
+extern Score KS_ENEMY_QUEEN;
+extern Score KS_KNIGHT_DEFENSE;
 
 extern Score PSQT[12][2][64];
 
 void InitPSQT();
 
 int Scale(Board* board, int ss);
+int MaterialScale(Board* board, int ss);
 Score GetPhase(Board* board);
 
 Score MaterialValue(Board* board, int side);
+Score Imbalance(Board* board, int side);
+EvalHashEntry* TTEvalProbe(uint64_t hash, ThreadData* thread);
+void TTEvalPut(uint64_t hash, Score eval, ThreadData* thread);
 Score Evaluate(Board* board, ThreadData* thread);
+Score Finalize(Board* board, MaterialEntry* material, Score s);
+Score EvaluateLazy(Board* board, ThreadData* thread, int alpha, int beta, int* lazy);
 
 #endif
\ No newline at end of file
@@ -15,6 +15,7 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "board.h"
 #include "history.h"
@@ -30,69 +31,143 @@ void AddKillerMove(SearchData* data, Move move) {
 
 void AddCounterMove(SearchData* data, Move move, Move parent) { data->counters[MoveStartEnd(parent)] = move; }
 
-void AddHistoryHeuristic(int* entry, int inc) { *entry += 64 * inc - *entry * abs(inc) / 1024; }
+// Between searches the tables are kept but halved, what was learnt about the
+// game so far still orders moves, but the new position quickly outweighs it
+void AgeHistories(SearchData* data) {
+  int16_t* entries = (int16_t*)data->hist;
 
-void UpdateHistories(SearchData* data, Move bestMove, int depth, int stm, Move quiets[], int nQ) {
+  for (size_t i = 0; i < sizeof(HistoryTables) / sizeof(int16_t); i++)
+    entries[i] /= 2;
+}
+
+// Killers are by ply, with the plies played since the last search the old
+// ply stack lines up with the new one. A position from elsewhere gets none
+void ShiftKillers(SearchData* data, int plies) {
+  if (plies < 0 || plies >= MAX_SEARCH_PLY) {
+    memset(data->killers, 0, sizeof(data->killers));
+    return;
+  }
+
+  memmove(data->killers, data->killers[plies], (MAX_SEARCH_PLY - plies) * sizeof(data->killers[0]));
+  memset(data->killers[MAX_SEARCH_PLY - plies], 0, plies * sizeof(data->killers[0]));
+}
+
+// gravity keeps entries within +-32768, the clamp only guards rounding
+void AddHistoryHeuristic(int16_t* entry, int inc) {
+  int value = *entry + 32 * inc - *entry * abs(inc) / 1024;
+  *entry = max(-32767, min(32767, value));
+}
+
+// quiet promotions are tactical but capture nothing, they have no entry
+inline int16_t* CaptureHistoryEntry(SearchData* data, Board* board, Move move) {
+  int captured = MoveEP(move) ? PAWN_TYPE : MoveCapture(move) ? PIECE_TYPE[board->squares[MoveEnd(move)]] : -1;
+
+  return captured >= 0 ? &data->hist->caph[MovePiece(move)][MoveEnd(move)][captured] : NULL;
+}
+
+// The best move of a cutoff is rewarded and every other move of its kind that
+// was searched before it is punished. Tactical moves searched before a quiet
+// cutoff are punished too, they did not refute the position
+void UpdateHistories(SearchData* data, Board* board, Move bestMove, int depth, Move quiets[], int nQ, Move tacticals[],
+                     int nT) {
   int inc = min(depth * depth, 576);
+  int stm = board->side;
 
   Move parent = data->ply > 0 ? data->moves[data->ply - 1] : NULL_MOVE;
   Move grandParent = data->ply > 1 ? data->moves[data->ply - 2] : NULL_MOVE;
+  Move fourthParent = data->ply > 3 ? data->moves[data->ply - 4] : NULL_MOVE;
+
+  for (int i = 0; i < nT; i++) {
+    int16_t* entry = CaptureHistoryEntry(data, board, tacticals[i]);
+    if (entry)
+      AddHistoryHeuristic(entry, tacticals[i] == bestMove ? inc : -inc);
+  }
 
   if (!Tactical(bestMove)) {
     AddKillerMove(data, bestMove);
-    AddHistoryHeuristic(&data->hh[stm][MoveStartEnd(bestMove)], inc);
+    AddHistoryHeuristic(&data->hist->hh[stm][MoveStartEnd(bestMove)], inc);
 
     if (parent) {
       AddCounterMove(data, bestMove, parent);
       AddHistoryHeuristic(
-          &data->ch[PIECE_TYPE[MovePiece(parent)]][MoveEnd(parent)][PIECE_TYPE[MovePiece(bestMove)]][MoveEnd(bestMove)],
+          &data->hist->ch[PIECE_TYPE[MovePiece(parent)]][MoveEnd(parent)][PIECE_TYPE[MovePiece(bestMove)]][MoveEnd(bestMove)],
           inc);
     }
 
     if (grandParent)
-      AddHistoryHeuristic(&data->fh[PIECE_TYPE[MovePiece(grandParent)]][MoveEnd(grandParent)]
+      AddHistoryHeuristic(&data->hist->fh[PIECE_TYPE[MovePiece(grandParent)]][MoveEnd(grandParent)]
                                    [PIECE_TYPE[MovePiece(bestMove)]][MoveEnd(bestMove)],
                           inc);
+
+    if (fourthParent)
+      AddHistoryHeuristic(&data->hist->fh4[PIECE_TYPE[MovePiece(fourthParent)]][MoveEnd(fourthParent)]
+                                    [PIECE_TYPE[MovePiece(bestMove)]][MoveEnd(bestMove)],
+                          inc);
   }
 
   for (int i = 0; i < nQ; i++) {
     Move m = quiets[i];
     if (m != bestMove) {
-      AddHistoryHeuristic(&data->hh[stm][MoveStartEnd(m)], -inc);
+      AddHistoryHeuristic(&data->hist->hh[stm][MoveStartEnd(m)], -inc);
       if (parent)
         AddHistoryHeuristic(
-            &data->ch[PIECE_TYPE[MovePiece(parent)]][MoveEnd(parent)][PIECE_TYPE[MovePiece(m)]][MoveEnd(m)], -inc);
+            &data->hist->ch[PIECE_TYPE[MovePiece(parent)]][MoveEnd(parent)][PIECE_TYPE[MovePiece(m)]][MoveEnd(m)], -inc);
       if (grandParent)
         AddHistoryHeuristic(
-            &data->fh[PIECE_TYPE[MovePiece(grandParent)]][MoveEnd(grandParent)][PIECE_TYPE[MovePiece(m)]][MoveEnd(m)],
+            &data->hist->fh[PIECE_TYPE[MovePiece(grandParent)]][MoveEnd(grandParent)][PIECE_TYPE[MovePiece(m)]][MoveEnd(m)],
             -inc);
+      if (fourthParent)
+        AddHistoryHeuristic(&data->hist->fh4[PIECE_TYPE[MovePiece(fourthParent)]][MoveEnd(fourthParent)]
+                                     [PIECE_TYPE[MovePiece(m)]][MoveEnd(m)],
+                            -inc);
     }
   }
 }
 
+// quiets only, tactical moves are scored by GetCaptureHistory. The 4 ply
+// table only orders moves, reductions and extensions are tuned without it
 int GetHistory(SearchData* data, Move move, int stm) {
   if (Tactical(move))
-    return 0; // TODO: Capture history
+    return 0;
 
-  int history = data->hh[stm][MoveStartEnd(move)];
+  int history = data->hist->hh[stm][MoveStartEnd(move)];
 
   Move parent = data->ply > 0 ? data->moves[data->ply - 1] : NULL_MOVE;
   if (parent)
-    history += data->ch[PIECE_TYPE[MovePiece(parent)]][MoveEnd(parent)][PIECE_TYPE[MovePiece(move)]][MoveEnd(move)];
+    history += data->hist->ch[PIECE_TYPE[MovePiece(parent)]][MoveEnd(parent)][PIECE_TYPE[MovePiece(move)]][MoveEnd(move)];
 
   Move grandParent = data->ply > 1 ? data->moves[data->ply - 2] : NULL_MOVE;
   if (grandParent)
     history +=
-        data->fh[PIECE_TYPE[MovePiece(grandParent)]][MoveEnd(grandParent)][PIECE_TYPE[MovePiece(move)]][MoveEnd(move)];
+        data->hist->fh[PIECE_TYPE[MovePiece(grandParent)]][MoveEnd(grandParent)][PIECE_TYPE[MovePiece(move)]][MoveEnd(move)];
 
   return history;
 }
 
 int GetCounterHistory(SearchData* data, Move move) {
   if (Tactical(move))
-    return 0; // TODO: Capture history
+    return 0;
 
   Move parent = data->ply > 0 ? data->moves[data->ply - 1] : NULL_MOVE;
-  return parent ? data->ch[PIECE_TYPE[MovePiece(parent)]][MoveEnd(parent)][PIECE_TYPE[MovePiece(move)]][MoveEnd(move)]
+  return parent ? data->hist->ch[PIECE_TYPE[MovePiece(parent)]][MoveEnd(parent)][PIECE_TYPE[MovePiece(move)]][MoveEnd(move)]
                 : 0;
+}
+
+int GetCaptureHistory(SearchData* data, Board* board, Move move) {
+  int16_t* entry = CaptureHistoryEntry(data, board, move);
+  return entry ? *entry : 0;
+}
+
+// The search score minus the static eval is blended into the pawn structure's
+// entry, deeper searches are trusted with a larger share
+void UpdateCorrection(SearchData* data, Board* board, int depth, int diff) {
+  int16_t* entry = &data->corrections[board->side][board->pawnHash & (CORRECTION_SIZE - 1)];
+  int weight = min(depth + 1, 16);
+
+  int value = (*entry * (256 - weight) + diff * CORRECTION_GRAIN * weight) / 256;
+  *entry = max(-CORRECTION_MAX, min(CORRECTION_MAX, value));
+}
+
+int GetCorrection(SearchData* data, Board* board) {
+  return data->corrections[board->side][board->pawnHash & (CORRECTION_SIZE - 1)] / CORRECTION_GRAIN;
 }
\ No newline at end of file
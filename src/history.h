@@ -21,9 +21,16 @@
 
 void AddKillerMove(SearchData* data, Move move);
 void AddCounterMove(SearchData* data, Move move, Move parent);
-void AddHistoryHeuristic(int* entry, int inc);
-void UpdateHistories(SearchData* data, Move bestMove, int depth, int stm, Move quiets[], int nQ);
+void AddHistoryHeuristic(int16_t* entry, int inc);
+int16_t* CaptureHistoryEntry(SearchData* data, Board* board, Move move);
+void UpdateHistories(SearchData* data, Board* board, Move bestMove, int depth, Move quiets[], int nQ, Move tacticals[],
+                     int nT);
 int GetHistory(SearchData* data, Move move, int stm);
 int GetCounterHistory(SearchData* data, Move move);
+int GetCaptureHistory(SearchData* data, Board* board, Move move);
+void UpdateCorrection(SearchData* data, Board* board, int depth, int diff);
+int GetCorrection(SearchData* data, Board* board);
+void AgeHistories(SearchData* data);
+void ShiftKillers(SearchData* data, int plies);
 
 #endif
\ No newline at end of file
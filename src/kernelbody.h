@@ -0,0 +1,174 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// No include guard, kernels.c compiles this once per instruction set with
+// KERNEL naming the copy. The bodies choose their paths on the usual target macros
+
+// sum of in[i] * w[i], inputs are clipped to [0, 127] so the pairwise
+// 16 bit products of maddubs can't saturate
+int KERNEL(DotProduct)(const uint8_t* in, const int8_t* w, int n) {
+  int i = 0, sum = 0;
+
+#if defined(__AVX512BW__)
+  __m512i acc512 = _mm512_setzero_si512();
+  for (; i + 64 <= n; i += 64) {
+    __m512i prod = _mm512_maddubs_epi16(_mm512_loadu_si512(in + i), _mm512_loadu_si512(w + i));
+    acc512 = _mm512_add_epi32(acc512, _mm512_madd_epi16(prod, _mm512_set1_epi16(1)));
+  }
+  sum += _mm512_reduce_add_epi32(acc512);
+#endif
+
+#if defined(__AVX2__)
+  __m256i acc256 = _mm256_setzero_si256();
+  for (; i + 32 <= n; i += 32) {
+    __m256i prod = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*)(in + i)),
+                                        _mm256_loadu_si256((const __m256i*)(w + i)));
+    acc256 = _mm256_add_epi32(acc256, _mm256_madd_epi16(prod, _mm256_set1_epi16(1)));
+  }
+  __m128i acc = _mm_add_epi32(_mm256_castsi256_si128(acc256), _mm256_extracti128_si256(acc256, 1));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4E));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xB1));
+  sum += _mm_cvtsi128_si32(acc);
+#elif defined(__SSSE3__)
+  __m128i acc = _mm_setzero_si128();
+  for (; i + 16 <= n; i += 16) {
+    __m128i prod =
+        _mm_maddubs_epi16(_mm_loadu_si128((const __m128i*)(in + i)), _mm_loadu_si128((const __m128i*)(w + i)));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(prod, _mm_set1_epi16(1)));
+  }
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4E));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xB1));
+  sum += _mm_cvtsi128_si32(acc);
+#endif
+
+  for (; i < n; i++)
+    sum += in[i] * w[i];
+
+  return sum;
+}
+
+// counts[i] = bits(bbs[i] & mask) for all n boards at once. AVX-512 has a
+// native 64 bit popcount, AVX2 uses the nibble lookup (Mula) with psadbw
+void KERNEL(BitsMasked)(const BitBoard* bbs, BitBoard mask, int n, int* counts) {
+  int i = 0;
+
+#if defined(__AVX512VPOPCNTDQ__) && defined(__AVX512VL__)
+  const __m512i m = _mm512_set1_epi64(mask);
+  for (; i < n; i += 8) {
+    __mmask8 active = n - i >= 8 ? 0xFF : (1 << (n - i)) - 1;
+    __m512i c = _mm512_popcnt_epi64(_mm512_and_si512(_mm512_maskz_loadu_epi64(active, bbs + i), m));
+    _mm256_mask_storeu_epi32(counts + i, active, _mm512_cvtepi64_epi32(c));
+  }
+#elif defined(__AVX2__)
+  const __m256i m = _mm256_set1_epi64x(mask);
+  const __m256i low = _mm256_set1_epi8(0x0F);
+  const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, //
+                                          0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  for (; i + 4 <= n; i += 4) {
+    __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(bbs + i)), m);
+    __m256i c = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low)),
+                                _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low)));
+    c = _mm256_sad_epu8(c, _mm256_setzero_si256());
+
+    // the low dword of each qword holds its count
+    __m256i packed = _mm256_permutevar8x32_epi32(c, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6));
+    _mm_storeu_si128((__m128i*)(counts + i), _mm256_castsi256_si128(packed));
+  }
+#endif
+
+  BitsMaskedScalar(bbs + i, mask, n - i, counts + i);
+}
+
+// quiet move scores from the butterfly and the three continuation rows, the
+// rows are padded so that the vector paths can gather past the last index
+void KERNEL(ScoreQuiets)(ScoredMove* quiets, int n, const int16_t* hh, const int16_t* ch, const int16_t* fh,
+                         const int16_t* f4) {
+  // piece type * 64 + end is (move >> 7 & 0x1C0) | (move >> 6 & 0x3F)
+  int i = 0;
+
+#if defined(__AVX512F__)
+  const __m512i evens = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+  const __m512i interleaveLo = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+  const __m512i interleaveHi = _mm512_setr_epi32(8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+
+  for (; i + 16 <= n; i += 16) {
+    __m512i lo = _mm512_loadu_si512((void*)&quiets[i]);
+    __m512i hi = _mm512_loadu_si512((void*)&quiets[i + 8]);
+    __m512i m = _mm512_permutex2var_epi32(lo, evens, hi);
+
+    __m512i startEnd = _mm512_and_si512(m, _mm512_set1_epi32(0xFFF));
+    __m512i pieceEnd = _mm512_or_si512(_mm512_and_si512(_mm512_srli_epi32(m, 7), _mm512_set1_epi32(0x1C0)),
+                                       _mm512_and_si512(_mm512_srli_epi32(m, 6), _mm512_set1_epi32(0x3F)));
+
+    __m512i h = _mm512_srai_epi32(_mm512_slli_epi32(_mm512_i32gather_epi32(startEnd, hh, 2), 16), 16);
+    __m512i c = _mm512_srai_epi32(_mm512_slli_epi32(_mm512_i32gather_epi32(pieceEnd, ch, 2), 16), 16);
+    __m512i f = _mm512_srai_epi32(_mm512_slli_epi32(_mm512_i32gather_epi32(pieceEnd, fh, 2), 16), 16);
+    __m512i f4s = _mm512_srai_epi32(_mm512_slli_epi32(_mm512_i32gather_epi32(pieceEnd, f4, 2), 16), 16);
+    __m512i s = _mm512_add_epi32(_mm512_add_epi32(h, f4s), _mm512_add_epi32(c, f));
+
+    _mm512_storeu_si512((void*)&quiets[i], _mm512_permutex2var_epi32(m, interleaveLo, s));
+    _mm512_storeu_si512((void*)&quiets[i + 8], _mm512_permutex2var_epi32(m, interleaveHi, s));
+  }
+#endif
+
+#if defined(__AVX2__)
+  for (; i + 8 <= n; i += 8) {
+    __m256 lo = _mm256_loadu_ps((float*)&quiets[i]);
+    __m256 hi = _mm256_loadu_ps((float*)&quiets[i + 4]);
+    __m256i m = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0))),
+                                         _MM_SHUFFLE(3, 1, 2, 0));
+
+    __m256i startEnd = _mm256_and_si256(m, _mm256_set1_epi32(0xFFF));
+    __m256i pieceEnd = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(m, 7), _mm256_set1_epi32(0x1C0)),
+                                       _mm256_and_si256(_mm256_srli_epi32(m, 6), _mm256_set1_epi32(0x3F)));
+
+    __m256i h = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_i32gather_epi32((const int*)hh, startEnd, 2), 16), 16);
+    __m256i c = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_i32gather_epi32((const int*)ch, pieceEnd, 2), 16), 16);
+    __m256i f = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_i32gather_epi32((const int*)fh, pieceEnd, 2), 16), 16);
+    __m256i f4s = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_i32gather_epi32((const int*)f4, pieceEnd, 2), 16), 16);
+    __m256i s = _mm256_add_epi32(_mm256_add_epi32(h, f4s), _mm256_add_epi32(c, f));
+
+    __m256i outLo = _mm256_unpacklo_epi32(m, s);
+    __m256i outHi = _mm256_unpackhi_epi32(m, s);
+    _mm256_storeu_si256((__m256i*)&quiets[i], _mm256_permute2x128_si256(outLo, outHi, 0x20));
+    _mm256_storeu_si256((__m256i*)&quiets[i + 4], _mm256_permute2x128_si256(outLo, outHi, 0x31));
+  }
+#endif
+
+  for (; i < n; i++) {
+    Move m = quiets[i].move;
+    int pieceEnd = PIECE_TYPE[MovePiece(m)] * 64 + MoveEnd(m);
+
+    quiets[i].score = hh[MoveStartEnd(m)] + ch[pieceEnd] + fh[pieceEnd] + f4[pieceEnd];
+  }
+}
+
+// accumulator updates, plain loops left to the vectorizer of each instruction set
+void KERNEL(AddSub)(int16_t* out, const int16_t* in, const int16_t* add, const int16_t* sub, int n) {
+  for (int i = 0; i < n; i++)
+    out[i] = in[i] + add[i] - sub[i];
+}
+
+void KERNEL(AddSubSub)(int16_t* out, const int16_t* in, const int16_t* add, const int16_t* sub,
+                       const int16_t* cap, int n) {
+  for (int i = 0; i < n; i++)
+    out[i] = in[i] + add[i] - sub[i] - cap[i];
+}
+
+void KERNEL(AddWeights)(int16_t* values, const int16_t* weights, int n) {
+  for (int i = 0; i < n; i++)
+    values[i] += weights[i];
+}
\ No newline at end of file
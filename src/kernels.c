@@ -0,0 +1,95 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#if defined(DISPATCH) || defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+#include "bits.h"
+#include "board.h"
+#include "cpu.h"
+#include "kernels.h"
+#include "move.h"
+#include "types.h"
+
+#if defined(DISPATCH)
+
+// x86-64 baseline, then the levels worth a copy. GCC sets the target
+// macros the bodies test for each region, no -m flags are needed
+#define KERNEL(name) name##Generic
+#include "kernelbody.h"
+#undef KERNEL
+
+#pragma GCC push_options
+#pragma GCC target("popcnt,avx2")
+#define KERNEL(name) name##Avx2
+#include "kernelbody.h"
+#undef KERNEL
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("popcnt,avx2,avx512f,avx512bw,avx512vl")
+#define KERNEL(name) name##Avx512
+#include "kernelbody.h"
+#undef KERNEL
+#pragma GCC pop_options
+
+#define USE_KERNELS(suffix)                                                                                            \
+  DotProduct = DotProduct##suffix, BitsMasked = BitsMasked##suffix, ScoreQuiets = ScoreQuiets##suffix,                 \
+  AddSub = AddSub##suffix, AddSubSub = AddSubSub##suffix, AddWeights = AddWeights##suffix
+
+const char* KERNELS = "generic";
+
+int (*DotProduct)(const uint8_t* in, const int8_t* w, int n) = DotProductGeneric;
+void (*BitsMasked)(const BitBoard* bbs, BitBoard mask, int n, int* counts) = BitsMaskedGeneric;
+void (*ScoreQuiets)(ScoredMove* quiets, int n, const int16_t* hh, const int16_t* ch, const int16_t* fh,
+                    const int16_t* f4) = ScoreQuietsGeneric;
+void (*AddSub)(int16_t* out, const int16_t* in, const int16_t* add, const int16_t* sub, int n) = AddSubGeneric;
+void (*AddSubSub)(int16_t* out, const int16_t* in, const int16_t* add, const int16_t* sub, const int16_t* cap,
+                  int n) = AddSubSubGeneric;
+void (*AddWeights)(int16_t* values, const int16_t* weights, int n) = AddWeightsGeneric;
+
+// after InitCPU, before anything evaluates
+void InitKernels() {
+  if (CPU.avx512) {
+    USE_KERNELS(Avx512);
+    KERNELS = "avx512";
+  } else if (CPU.avx2) {
+    USE_KERNELS(Avx2);
+    KERNELS = "avx2";
+  }
+}
+
+#else
+
+// a single copy for the instruction set of the build
+#define KERNEL(name) name
+#include "kernelbody.h"
+#undef KERNEL
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+const char* KERNELS = "avx512";
+#elif defined(__AVX2__)
+const char* KERNELS = "avx2";
+#elif defined(__SSSE3__)
+const char* KERNELS = "ssse3";
+#else
+const char* KERNELS = "generic";
+#endif
+
+void InitKernels() {}
+
+#endif
\ No newline at end of file
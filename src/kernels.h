@@ -0,0 +1,47 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include "types.h"
+
+// name of the instruction set the kernels were chosen for
+extern const char* KERNELS;
+
+#if defined(DISPATCH)
+// a copy of each kernel per instruction set, pointed at the best one by InitKernels
+extern int (*DotProduct)(const uint8_t* in, const int8_t* w, int n);
+extern void (*BitsMasked)(const BitBoard* bbs, BitBoard mask, int n, int* counts);
+extern void (*ScoreQuiets)(ScoredMove* quiets, int n, const int16_t* hh, const int16_t* ch, const int16_t* fh,
+                           const int16_t* f4);
+extern void (*AddSub)(int16_t* out, const int16_t* in, const int16_t* add, const int16_t* sub, int n);
+extern void (*AddSubSub)(int16_t* out, const int16_t* in, const int16_t* add, const int16_t* sub,
+                         const int16_t* cap, int n);
+extern void (*AddWeights)(int16_t* values, const int16_t* weights, int n);
+#else
+int DotProduct(const uint8_t* in, const int8_t* w, int n);
+void BitsMasked(const BitBoard* bbs, BitBoard mask, int n, int* counts);
+void ScoreQuiets(ScoredMove* quiets, int n, const int16_t* hh, const int16_t* ch, const int16_t* fh,
+                 const int16_t* f4);
+void AddSub(int16_t* out, const int16_t* in, const int16_t* add, const int16_t* sub, int n);
+void AddSubSub(int16_t* out, const int16_t* in, const int16_t* add, const int16_t* sub, const int16_t* cap, int n);
+void AddWeights(int16_t* values, const int16_t* weights, int n);
+#endif
+
+void InitKernels();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,64 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "material.h"
+#include "bits.h"
+#include "board.h"
+#include "endgame.h"
+#include "eval.h"
+#include "types.h"
+
+#ifdef TUNE
+#define T 1
+#else
+#define T 0
+#endif
+
+// Everything the eval derives from material alone, looked up by the material
+// key (board->piecesCounts). Entries never go stale so the table is never cleared
+inline void MaterialFill(MaterialEntry* entry, Board* board) {
+  entry->key = board->piecesCounts;
+  entry->filled = 1;
+  entry->draw = IsMaterialDraw(board);
+  entry->phase = GetPhase(board);
+  entry->scale[WHITE] = MaterialScale(board, WHITE);
+  entry->scale[BLACK] = MaterialScale(board, BLACK);
+
+  BitBoard nonBishopMaterial = board->pieces[QUEEN_WHITE] | board->pieces[QUEEN_BLACK] | board->pieces[ROOK_WHITE] |
+                               board->pieces[ROOK_BLACK] | board->pieces[KNIGHT_WHITE] | board->pieces[KNIGHT_BLACK];
+  entry->ocbCandidate =
+      !nonBishopMaterial && bits(board->pieces[BISHOP_WHITE]) == 1 && bits(board->pieces[BISHOP_BLACK]) == 1;
+
+  // the tuner collects imbalance coefficients itself
+  entry->imbalance = T ? 0 : Imbalance(board, WHITE) - Imbalance(board, BLACK);
+
+  if (bits(board->occupancies[BOTH]) == 3)
+    entry->endgame = EvaluateKXK;
+  else if (!(board->pieces[PAWN_WHITE] | board->pieces[PAWN_BLACK]))
+    entry->endgame = EvaluateMaterialOnlyEndgame;
+  else
+    entry->endgame = NULL;
+}
+
+inline MaterialEntry* MaterialProbe(Board* board, ThreadData* thread) {
+  uint64_t idx = (board->piecesCounts * 0x9E3779B97F4A7C15ULL) >> (64 - MATERIAL_TABLE_BITS);
+  MaterialEntry* entry = &thread->materialTable[idx];
+
+  if (T || !entry->filled || entry->key != board->piecesCounts)
+    MaterialFill(entry, board);
+
+  return entry;
+}
\ No newline at end of file
@@ -15,7 +15,9 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <stdio.h>
+#include <stdlib.h>
 
+#include "board.h"
 #include "move.h"
 #include "movegen.h"
 #include "movepick.h"
@@ -33,15 +35,14 @@ const char* SQ_TO_COORD[] = {
 };
 
 Move ParseMove(char* moveStr, Board* board) {
-  MoveList moveList = {0};
-  SearchData data = {0};
-  InitAllMoves(&moveList, NULL_MOVE, &data);
+  Move moves[MAX_MOVES];
+  int n = GenerateLegalMoves(moves, board);
 
   int start = (moveStr[0] - 'a') + (8 - (moveStr[1] - '0')) * 8;
   int end = (moveStr[2] - 'a') + (8 - (moveStr[3] - '0')) * 8;
 
-  Move match;
-  while ((match = NextMove(&moveList, board, 0))) {
+  for (int i = 0; i < n; i++) {
+    Move match = moves[i];
     if (start != MoveStart(match) || end != MoveEnd(match))
       continue;
 
@@ -56,8 +57,9 @@ Move ParseMove(char* moveStr, Board* board) {
   return 0;
 }
 
+// per thread, so that analyse workers can format moves concurrently
 char* MoveToStr(Move move) {
-  static char buffer[6];
+  static _Thread_local char buffer[6];
 
   if (MovePromo(move)) {
     sprintf(buffer, "%s%s%c", SQ_TO_COORD[MoveStart(move)], SQ_TO_COORD[MoveEnd(move)],
@@ -73,4 +75,28 @@ inline int IsRecapture(SearchData* data, Move move) {
   Move parent = data->moves[data->ply - 1];
 
   return !(MoveCapture(parent) ^ MoveCapture(move)) && MoveEnd(parent) == MoveEnd(move);
-}
\ No newline at end of file
+}
+// Rebuild the full move from a packed TT move using the current board.
+// The result is not guaranteed to be legal (the entry may belong to another
+// position entirely) and must still go through MoveIsLegal
+Move UnpackMove(uint16_t packed, Board* board) {
+  if (!packed)
+    return NULL_MOVE;
+
+  int start = packed & 0x3f;
+  int end = (packed & 0xfc0) >> 6;
+  int promoType = packed >> 12;
+
+  int piece = board->squares[start];
+  if (piece == NO_PIECE)
+    return NULL_MOVE;
+
+  int pawn = PIECE_TYPE[piece] == PAWN_TYPE;
+  int promo = promoType ? promoType * 2 + board->side : 0;
+  int ep = pawn && board->epSquare && end == board->epSquare;
+  int cap = board->squares[end] != NO_PIECE || ep;
+  int dub = pawn && abs(start - end) == 16;
+  int castle = PIECE_TYPE[piece] == KING_TYPE && abs(start - end) == 2;
+
+  return BuildMove(start, end, piece, promo, cap, dub, ep, castle);
+}
@@ -42,8 +42,12 @@ extern const char* SQ_TO_COORD[];
 
 #define Tactical(move) (((int)(move)&0x1f0000) >> 16)
 
+// 16 bit form stored in the TT, start/end and the promotion piece type
+#define PackMove(move) ((uint16_t)(MoveStartEnd(move) | ((MovePromo(move) >> 1) << 12)))
+
 Move ParseMove(char* moveStr, Board* board);
 char* MoveToStr(Move move);
 int IsRecapture(SearchData* data, Move move);
+Move UnpackMove(uint16_t packed, Board* board);
 
 #endif
\ No newline at end of file
@@ -57,7 +57,12 @@ const BitBoard HOME_RANKS[] = {RANK_2, RANK_7};
 const BitBoard THIRD_RANKS[] = {RANK_3, RANK_6};
 const BitBoard FILLED = -1ULL;
 
-inline void AppendMove(Move* arr, uint8_t* n, Move move) { arr[(*n)++] = move; }
+// Tacticals fill the list from the front, quiets are placed after them
+inline void AppendTactical(MoveList* moveList, Move move) { moveList->moves[moveList->nTactical++].move = move; }
+
+inline void AppendQuiet(MoveList* moveList, Move move) {
+  moveList->moves[moveList->nTactical + moveList->nQuiets++].move = move;
+}
 
 // Move generation is pretty similar across all piece types with captures and quiets.
 // Both receieve a BitBoard of acceptable squares, and additional logic is applied within
@@ -78,14 +83,10 @@ void GeneratePawnPromotions(MoveList* moveList, BitBoard pawns, BitBoard possibi
     int end = lsb(quietPromoters);
     int start = end - PAWN_DIRECTIONS[board->side];
 
-    AppendMove(moveList->tactical, &moveList->nTactical,
-               BuildMove(start, end, PAWN[board->side], QUEEN[board->side], 0, 0, 0, 0));
-    AppendMove(moveList->tactical, &moveList->nTactical,
-               BuildMove(start, end, PAWN[board->side], ROOK[board->side], 0, 0, 0, 0));
-    AppendMove(moveList->tactical, &moveList->nTactical,
-               BuildMove(start, end, PAWN[board->side], BISHOP[board->side], 0, 0, 0, 0));
-    AppendMove(moveList->tactical, &moveList->nTactical,
-               BuildMove(start, end, PAWN[board->side], KNIGHT[board->side], 0, 0, 0, 0));
+    AppendTactical(moveList, BuildMove(start, end, PAWN[board->side], QUEEN[board->side], 0, 0, 0, 0));
+    AppendTactical(moveList, BuildMove(start, end, PAWN[board->side], ROOK[board->side], 0, 0, 0, 0));
+    AppendTactical(moveList, BuildMove(start, end, PAWN[board->side], BISHOP[board->side], 0, 0, 0, 0));
+    AppendTactical(moveList, BuildMove(start, end, PAWN[board->side], KNIGHT[board->side], 0, 0, 0, 0));
 
     popLsb(quietPromoters);
   }
@@ -94,14 +95,10 @@ void GeneratePawnPromotions(MoveList* moveList, BitBoard pawns, BitBoard possibi
     int end = lsb(capturingPromotersE);
     int start = end - (PAWN_DIRECTIONS[board->side] + E);
 
-    AppendMove(moveList->tactical, &moveList->nTactical,
-               BuildMove(start, end, PAWN[board->side], QUEEN[board->side], 1, 0, 0, 0));
-    AppendMove(moveList->tactical, &moveList->nTactical,
-               BuildMove(start, end, PAWN[board->side], ROOK[board->side], 1, 0, 0, 0));
-    AppendMove(moveList->tactical, &moveList->nTactical,
-               BuildMove(start, end, PAWN[board->side], BISHOP[board->side], 1, 0, 0, 0));
-    AppendMove(moveList->tactical, &moveList->nTactical,
-               BuildMove(start, end, PAWN[board->side], KNIGHT[board->side], 1, 0, 0, 0));
+    AppendTactical(moveList, BuildMove(start, end, PAWN[board->side], QUEEN[board->side], 1, 0, 0, 0));
+    AppendTactical(moveList, BuildMove(start, end, PAWN[board->side], ROOK[board->side], 1, 0, 0, 0));
+    AppendTactical(moveList, BuildMove(start, end, PAWN[board->side], BISHOP[board->side], 1, 0, 0, 0));
+    AppendTactical(moveList, BuildMove(start, end, PAWN[board->side], KNIGHT[board->side], 1, 0, 0, 0));
 
     popLsb(capturingPromotersE);
   }
@@ -110,14 +107,10 @@ void GeneratePawnPromotions(MoveList* moveList, BitBoard pawns, BitBoard possibi
     int end = lsb(capturingPromotersW);
     int start = end - (PAWN_DIRECTIONS[board->side] + W);
 
-    AppendMove(moveList->tactical, &moveList->nTactical,
-               BuildMove(start, end, PAWN[board->side], QUEEN[board->side], 1, 0, 0, 0));
-    AppendMove(moveList->tactical, &moveList->nTactical,
-               BuildMove(start, end, PAWN[board->side], ROOK[board->side], 1, 0, 0, 0));
-    AppendMove(moveList->tactical, &moveList->nTactical,
-               BuildMove(start, end, PAWN[board->side], BISHOP[board->side], 1, 0, 0, 0));
-    AppendMove(moveList->tactical, &moveList->nTactical,
-               BuildMove(start, end, PAWN[board->side], KNIGHT[board->side], 1, 0, 0, 0));
+    AppendTactical(moveList, BuildMove(start, end, PAWN[board->side], QUEEN[board->side], 1, 0, 0, 0));
+    AppendTactical(moveList, BuildMove(start, end, PAWN[board->side], ROOK[board->side], 1, 0, 0, 0));
+    AppendTactical(moveList, BuildMove(start, end, PAWN[board->side], BISHOP[board->side], 1, 0, 0, 0));
+    AppendTactical(moveList, BuildMove(start, end, PAWN[board->side], KNIGHT[board->side], 1, 0, 0, 0));
 
     popLsb(capturingPromotersW);
   }
@@ -133,16 +126,16 @@ void GeneratePawnCaptures(MoveList* moveList, BitBoard pawns, BitBoard possibili
   while (capturingE) {
     int end = lsb(capturingE);
 
-    AppendMove(moveList->tactical, &moveList->nTactical,
-               BuildMove(end - (PAWN_DIRECTIONS[board->side] + E), end, PAWN[board->side], 0, 1, 0, 0, 0));
+    AppendTactical(moveList,
+                   BuildMove(end - (PAWN_DIRECTIONS[board->side] + E), end, PAWN[board->side], 0, 1, 0, 0, 0));
 
     popLsb(capturingE);
   }
 
   while (capturingW) {
     int end = lsb(capturingW);
-    AppendMove(moveList->tactical, &moveList->nTactical,
-               BuildMove(end - (PAWN_DIRECTIONS[board->side] + W), end, PAWN[board->side], 0, 1, 0, 0, 0));
+    AppendTactical(moveList,
+                   BuildMove(end - (PAWN_DIRECTIONS[board->side] + W), end, PAWN[board->side], 0, 1, 0, 0, 0));
     popLsb(capturingW);
   }
 
@@ -151,8 +144,7 @@ void GeneratePawnCaptures(MoveList* moveList, BitBoard pawns, BitBoard possibili
 
     while (epPawns) {
       int start = lsb(epPawns);
-      AppendMove(moveList->tactical, &moveList->nTactical,
-                 BuildMove(start, board->epSquare, PAWN[board->side], 0, 1, 0, 1, 0));
+      AppendTactical(moveList, BuildMove(start, board->epSquare, PAWN[board->side], 0, 1, 0, 1, 0));
       popLsb(epPawns);
     }
   }
@@ -170,16 +162,14 @@ void GeneratePawnQuiets(MoveList* moveList, BitBoard pawns, BitBoard possibiliti
 
   while (singlePush) {
     int end = lsb(singlePush);
-    AppendMove(moveList->quiet, &moveList->nQuiets,
-               BuildMove(end - PAWN_DIRECTIONS[board->side], end, PAWN[board->side], 0, 0, 0, 0, 0));
+    AppendQuiet(moveList, BuildMove(end - PAWN_DIRECTIONS[board->side], end, PAWN[board->side], 0, 0, 0, 0, 0));
     popLsb(singlePush);
   }
 
   while (doublePush) {
     int end = lsb(doublePush);
-    AppendMove(moveList->quiet, &moveList->nQuiets,
-               BuildMove(end - PAWN_DIRECTIONS[board->side] - PAWN_DIRECTIONS[board->side], end, PAWN[board->side], 0,
-                         0, 1, 0, 0));
+    AppendQuiet(moveList, BuildMove(end - PAWN_DIRECTIONS[board->side] - PAWN_DIRECTIONS[board->side], end,
+                                    PAWN[board->side], 0, 0, 1, 0, 0));
     popLsb(doublePush);
   }
 }
@@ -198,7 +188,7 @@ void GenerateKnightCaptures(MoveList* moveList, BitBoard knights, BitBoard possi
     while (attacks) {
       int end = lsb(attacks);
 
-      AppendMove(moveList->tactical, &moveList->nTactical, BuildMove(start, end, KNIGHT[board->side], 0, 1, 0, 0, 0));
+      AppendTactical(moveList, BuildMove(start, end, KNIGHT[board->side], 0, 1, 0, 0, 0));
 
       popLsb(attacks);
     }
@@ -215,7 +205,7 @@ void GenerateKnightQuiets(MoveList* moveList, BitBoard knights, BitBoard possibi
     while (attacks) {
       int end = lsb(attacks);
 
-      AppendMove(moveList->quiet, &moveList->nQuiets, BuildMove(start, end, KNIGHT[board->side], 0, 0, 0, 0, 0));
+      AppendQuiet(moveList, BuildMove(start, end, KNIGHT[board->side], 0, 0, 0, 0, 0));
 
       popLsb(attacks);
     }
@@ -238,7 +228,7 @@ void generateBishopCaptures(MoveList* moveList, BitBoard bishops, BitBoard possi
     while (attacks) {
       int end = lsb(attacks);
 
-      AppendMove(moveList->tactical, &moveList->nTactical, BuildMove(start, end, BISHOP[board->side], 0, 1, 0, 0, 0));
+      AppendTactical(moveList, BuildMove(start, end, BISHOP[board->side], 0, 1, 0, 0, 0));
 
       popLsb(attacks);
     }
@@ -255,7 +245,7 @@ void GenerateBishopQuiets(MoveList* moveList, BitBoard bishops, BitBoard possibi
     while (attacks) {
       int end = lsb(attacks);
 
-      AppendMove(moveList->quiet, &moveList->nQuiets, BuildMove(start, end, BISHOP[board->side], 0, 0, 0, 0, 0));
+      AppendQuiet(moveList, BuildMove(start, end, BISHOP[board->side], 0, 0, 0, 0, 0));
 
       popLsb(attacks);
     }
@@ -278,7 +268,7 @@ void generateRookCaptures(MoveList* moveList, BitBoard rooks, BitBoard possibili
     while (attacks) {
       int end = lsb(attacks);
 
-      AppendMove(moveList->tactical, &moveList->nTactical, BuildMove(start, end, ROOK[board->side], 0, 1, 0, 0, 0));
+      AppendTactical(moveList, BuildMove(start, end, ROOK[board->side], 0, 1, 0, 0, 0));
 
       popLsb(attacks);
     }
@@ -295,7 +285,7 @@ void GenerateRookQuiets(MoveList* moveList, BitBoard rooks, BitBoard possibiliti
     while (attacks) {
       int end = lsb(attacks);
 
-      AppendMove(moveList->quiet, &moveList->nQuiets, BuildMove(start, end, ROOK[board->side], 0, 0, 0, 0, 0));
+      AppendQuiet(moveList, BuildMove(start, end, ROOK[board->side], 0, 0, 0, 0, 0));
 
       popLsb(attacks);
     }
@@ -318,7 +308,7 @@ void GenerateQueenCaptures(MoveList* moveList, BitBoard queens, BitBoard possibi
     while (attacks) {
       int end = lsb(attacks);
 
-      AppendMove(moveList->tactical, &moveList->nTactical, BuildMove(start, end, QUEEN[board->side], 0, 1, 0, 0, 0));
+      AppendTactical(moveList, BuildMove(start, end, QUEEN[board->side], 0, 1, 0, 0, 0));
 
       popLsb(attacks);
     }
@@ -335,7 +325,7 @@ void GenerateQueenQuiets(MoveList* moveList, BitBoard queens, BitBoard possibili
     while (attacks) {
       int end = lsb(attacks);
 
-      AppendMove(moveList->quiet, &moveList->nQuiets, BuildMove(start, end, QUEEN[board->side], 0, 0, 0, 0, 0));
+      AppendQuiet(moveList, BuildMove(start, end, QUEEN[board->side], 0, 0, 0, 0, 0));
 
       popLsb(attacks);
     }
@@ -359,7 +349,7 @@ void GenerateKingCaptures(MoveList* moveList, Board* board) {
     while (attacks) {
       int end = lsb(attacks);
 
-      AppendMove(moveList->tactical, &moveList->nTactical, BuildMove(start, end, KING[board->side], 0, 1, 0, 0, 0));
+      AppendTactical(moveList, BuildMove(start, end, KING[board->side], 0, 1, 0, 0, 0));
 
       popLsb(attacks);
     }
@@ -377,14 +367,14 @@ void GenerateCastles(MoveList* moveList, Board* board) {
   // square attack logic is applied later
   if (board->side == WHITE) {
     if ((board->castling & 0x8) && !(board->occupancies[BOTH] & GetInBetweenSquares(E1, H1)))
-      AppendMove(moveList->quiet, &moveList->nQuiets, BuildMove(E1, G1, KING[board->side], 0, 0, 0, 0, 1));
+      AppendQuiet(moveList, BuildMove(E1, G1, KING[board->side], 0, 0, 0, 0, 1));
     if ((board->castling & 0x4) && !(board->occupancies[BOTH] & GetInBetweenSquares(E1, A1)))
-      AppendMove(moveList->quiet, &moveList->nQuiets, BuildMove(E1, C1, KING[board->side], 0, 0, 0, 0, 1));
+      AppendQuiet(moveList, BuildMove(E1, C1, KING[board->side], 0, 0, 0, 0, 1));
   } else {
     if ((board->castling & 0x2) && !(board->occupancies[BOTH] & GetInBetweenSquares(E8, H8)))
-      AppendMove(moveList->quiet, &moveList->nQuiets, BuildMove(E8, G8, KING[board->side], 0, 0, 0, 0, 1));
+      AppendQuiet(moveList, BuildMove(E8, G8, KING[board->side], 0, 0, 0, 0, 1));
     if ((board->castling & 0x1) && !(board->occupancies[BOTH] & GetInBetweenSquares(E8, A8)))
-      AppendMove(moveList->quiet, &moveList->nQuiets, BuildMove(E8, C8, KING[board->side], 0, 0, 0, 0, 1));
+      AppendQuiet(moveList, BuildMove(E8, C8, KING[board->side], 0, 0, 0, 0, 1));
   }
 }
 
@@ -398,7 +388,7 @@ void GenerateKingQuiets(MoveList* moveList, Board* board) {
     while (attacks) {
       int end = lsb(attacks);
 
-      AppendMove(moveList->quiet, &moveList->nQuiets, BuildMove(start, end, KING[board->side], 0, 0, 0, 0, 0));
+      AppendQuiet(moveList, BuildMove(start, end, KING[board->side], 0, 0, 0, 0, 0));
 
       popLsb(attacks);
     }
@@ -482,10 +472,10 @@ void GenerateTacticalMoves(MoveList* moveList, Board* board) {
 
   // this is the final legality check for moves - certain move types are specifically checked here
   // king moves, castles, and EP (some crazy pins)
-  Move* curr = moveList->tactical;
-  while (curr != moveList->tactical + moveList->nTactical) {
-    if ((MoveStart(*curr) == kingSq || MoveEP(*curr)) && !IsMoveLegal(*curr, board))
-      *curr = moveList->tactical[--moveList->nTactical]; // overwrite this illegal move with the last move and try again
+  ScoredMove* curr = moveList->moves;
+  while (curr != moveList->moves + moveList->nTactical) {
+    if ((MoveStart(curr->move) == kingSq || MoveEP(curr->move)) && !IsMoveLegal(curr->move, board))
+      *curr = moveList->moves[--moveList->nTactical]; // overwrite this illegal move with the last move and try again
     else
       ++curr;
   }
@@ -556,11 +546,28 @@ void GenerateQuietMoves(MoveList* moveList, Board* board) {
 
   // this is the final legality check for moves - certain move types are specifically checked here
   // king moves, castles, and EP (some crazy pins)
-  Move* curr = moveList->quiet;
-  while (curr != moveList->quiet + moveList->nQuiets) {
-    if (MoveStart(*curr) == kingSq && !IsMoveLegal(*curr, board))
-      *curr = moveList->quiet[--moveList->nQuiets]; // overwrite this illegal move with the last move and try again
+  ScoredMove* quiets = moveList->moves + moveList->nTactical;
+  ScoredMove* curr = quiets;
+  while (curr != quiets + moveList->nQuiets) {
+    if (MoveStart(curr->move) == kingSq && !IsMoveLegal(curr->move, board))
+      *curr = quiets[--moveList->nQuiets]; // overwrite this illegal move with the last move and try again
     else
       ++curr;
   }
+}
+
+// Every legal move in the position as one flat array (tacticals first), without
+// any of the scoring done by movepick. Returns the number of moves
+int GenerateLegalMoves(Move* moves, Board* board) {
+  MoveList moveList;
+  moveList.nTactical = moveList.nQuiets = 0;
+
+  GenerateTacticalMoves(&moveList, board);
+  GenerateQuietMoves(&moveList, board);
+
+  int n = moveList.nTactical + moveList.nQuiets;
+  for (int i = 0; i < n; i++)
+    moves[i] = moveList.moves[i].move;
+
+  return n;
 }
\ No newline at end of file
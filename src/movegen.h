@@ -33,8 +33,10 @@ extern const int KILLER1_SCORE;
 extern const int KILLER2_SCORE;
 extern const int COUNTER_SCORE;
 
-void AppendMove(Move* arr, uint8_t* n, Move move);
+void AppendTactical(MoveList* moveList, Move move);
+void AppendQuiet(MoveList* moveList, Move move);
 void GenerateQuietMoves(MoveList* moveList, Board* board);
 void GenerateTacticalMoves(MoveList* moveList, Board* board);
+int GenerateLegalMoves(Move* moves, Board* board);
 
 #endif
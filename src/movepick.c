@@ -19,9 +19,11 @@
 #include "board.h"
 #include "eval.h"
 #include "history.h"
+#include "kernels.h"
 #include "move.h"
 #include "movegen.h"
 #include "movepick.h"
+#include "profile.h"
 #include "see.h"
 #include "transposition.h"
 #include "types.h"
@@ -32,6 +34,7 @@ void InitAllMoves(MoveList* moves, Move hashMove, SearchData* data) {
   moves->nTactical = 0;
   moves->nQuiets = 0;
   moves->nBadTactical = 0;
+  moves->quietIdx = 0;
   moves->seeCutoff = 0;
 
   moves->hashMove = hashMove;
@@ -50,6 +53,7 @@ void InitTacticalMoves(MoveList* moves, SearchData* data, int cutoff) {
   moves->nTactical = 0;
   moves->nQuiets = 0;
   moves->nBadTactical = 0;
+  moves->quietIdx = 0;
   moves->seeCutoff = cutoff;
 
   moves->hashMove = NULL_MOVE;
@@ -60,83 +64,113 @@ void InitTacticalMoves(MoveList* moves, SearchData* data, int cutoff) {
   moves->data = data;
 }
 
-int GetTopIdx(int* arr, int n) {
+// quiets are picked by selection for the first few and, if no cutoff
+// came by then, the rest are sorted once and played in order
+#define QUIET_SELECTIONS 4
+
+int GetTopIdx(ScoredMove* arr, int n) {
   int m = 0;
   for (int i = m + 1; i < n; i++)
-    if (arr[i] > arr[m])
+    if (arr[i].score > arr[m].score)
       m = i;
 
   return m;
 }
 
-int GetTopReverseIdx(int* arr, int n) {
-  int m = MAX_MOVES - 1;
-  for (int i = m - 1; i > MAX_MOVES - n - 1; i--)
-    if (arr[i] > arr[m])
-      m = i;
+inline void SelectTop(ScoredMove* arr, int start, int n) {
+  int m = start + GetTopIdx(arr + start, n - start);
 
-  return m;
+  ScoredMove temp = arr[start];
+  arr[start] = arr[m];
+  arr[m] = temp;
+}
+
+void InsertionSort(ScoredMove* arr, int n) {
+  for (int i = 1; i < n; i++) {
+    ScoredMove curr = arr[i];
+
+    int j = i - 1;
+    for (; j >= 0 && arr[j].score < curr.score; j--)
+      arr[j + 1] = arr[j];
+
+    arr[j + 1] = curr;
+  }
 }
 
 inline void ShiftToBadCaptures(MoveList* moves, int idx) {
   // Put the bad capture starting at the end
-  moves->tactical[MAX_MOVES - 1 - moves->nBadTactical] = moves->tactical[idx];
-  moves->sTactical[MAX_MOVES - 1 - moves->nBadTactical] = moves->sTactical[idx];
+  moves->moves[MAX_MOVES - 1 - moves->nBadTactical] = moves->moves[idx];
   moves->nBadTactical++;
 
   // put the last good capture here instead
-  moves->nTactical--;
-  moves->tactical[idx] = moves->tactical[moves->nTactical];
-  moves->sTactical[idx] = moves->tactical[moves->nTactical];
+  moves->moves[idx] = moves->moves[--moves->nTactical];
 }
 
 inline Move PopGoodCapture(MoveList* moves, int idx) {
-  Move temp = moves->tactical[idx];
-
-  moves->nTactical--;
-  moves->tactical[idx] = moves->tactical[moves->nTactical];
-  moves->sTactical[idx] = moves->sTactical[moves->nTactical];
-
-  return temp;
-}
-
-inline Move PopQuiet(MoveList* moves, int idx) {
-  Move temp = moves->quiet[idx];
-
-  moves->nQuiets--;
-  moves->quiet[idx] = moves->quiet[moves->nQuiets];
-  moves->sQuiet[idx] = moves->sQuiet[moves->nQuiets];
+  Move temp = moves->moves[idx].move;
+  moves->moves[idx] = moves->moves[--moves->nTactical];
 
   return temp;
 }
 
 inline Move PopBadCapture(MoveList* moves) {
-  Move temp = moves->tactical[MAX_MOVES - 1];
+  Move temp = moves->moves[MAX_MOVES - 1].move;
 
   moves->nBadTactical--;
-  moves->tactical[MAX_MOVES - 1] = moves->tactical[MAX_MOVES - 1 - moves->nBadTactical];
-  moves->sTactical[MAX_MOVES - 1] = moves->tactical[MAX_MOVES - 1 - moves->nBadTactical];
+  moves->moves[MAX_MOVES - 1] = moves->moves[MAX_MOVES - 1 - moves->nBadTactical];
 
   return temp;
 }
 
+// MVV-LVA, with the capture history deciding between captures of the same
+// victim and, when it is strong, between neighbouring victims
 void ScoreTacticalMoves(MoveList* moves, Board* board) {
+  SearchData* data = moves->data;
+
   for (int i = 0; i < moves->nTactical; i++) {
-    Move m = moves->tactical[i];
+    Move m = moves->moves[i].move;
     int attacker = MovePiece(m);
-    moves->sTactical[i] = MoveEP(m)                   ? MVV_LVA[attacker][PAWN_WHITE]
-                          : !MovePromo(m)             ? MVV_LVA[attacker][board->squares[MoveEnd(m)]]
-                          : MovePromo(m) > ROOK_BLACK ? MVV_LVA[attacker][QUEEN_WHITE]
-                                                      : -1;
+
+    // a queen promotion scores as taking a queen, an under promotion is last
+    int victim = MoveEP(m) ? PAWN_WHITE : board->squares[MoveEnd(m)];
+    if (MovePromo(m))
+      victim = MovePromo(m) > ROOK_BLACK ? QUEEN_WHITE : -1;
+
+    int mvvLva = victim < 0 ? -1 : MVV_LVA[attacker][victim];
+    moves->moves[i].score = mvvLva < 0 ? -1 : 16 * mvvLva + (data->hist ? GetCaptureHistory(data, board, m) / 32 : 0);
   }
 }
 
-void ScoreQuietMoves(MoveList* moves, Board* board, SearchData* data) {
-  for (int i = 0; i < moves->nQuiets; i++) {
-    Move m = moves->quiet[i];
+// stands in for the counter/follow up rows when there is no such parent move
+const int16_t NO_HISTORY[6 * 64 + 2] = {0};
 
-    moves->sQuiet[i] = GetHistory(data, m, board->side);
+// GetHistory plus the 4 ply follow up for every quiet, but the four table rows
+// are resolved once and the per move lookups are done as wide gathers.
+// Entries are 16 bit, so 32 bits are gathered and the low half sign extended
+void ScoreQuietMoves(MoveList* moves, Board* board, SearchData* data) {
+  ScoredMove* quiets = moves->moves;
+  int n = moves->nQuiets;
+
+  // data without history tables (perft, move parsing) needs no ordering
+  if (!data->hist) {
+    for (int i = 0; i < n; i++)
+      quiets[i].score = 0;
+    return;
   }
+
+  Move parent = data->ply > 0 ? data->moves[data->ply - 1] : NULL_MOVE;
+  Move grandParent = data->ply > 1 ? data->moves[data->ply - 2] : NULL_MOVE;
+  Move fourthParent = data->ply > 3 ? data->moves[data->ply - 4] : NULL_MOVE;
+
+  const int16_t* hh = data->hist->hh[board->side];
+  const int16_t* ch =
+      parent ? &data->hist->ch[PIECE_TYPE[MovePiece(parent)]][MoveEnd(parent)][0][0] : NO_HISTORY;
+  const int16_t* fh =
+      grandParent ? &data->hist->fh[PIECE_TYPE[MovePiece(grandParent)]][MoveEnd(grandParent)][0][0] : NO_HISTORY;
+  const int16_t* f4 =
+      fourthParent ? &data->hist->fh4[PIECE_TYPE[MovePiece(fourthParent)]][MoveEnd(fourthParent)][0][0] : NO_HISTORY;
+
+  ScoreQuiets(quiets, n, hh, ch, fh, f4);
 }
 
 Move NextMove(MoveList* moves, Board* board, int skipQuiets) {
@@ -147,14 +181,14 @@ Move NextMove(MoveList* moves, Board* board, int skipQuiets) {
       return moves->hashMove;
     // fallthrough
   case GEN_TACTICAL_MOVES:
-    GenerateTacticalMoves(moves, board);
+    PROFILED_VOID(moves->data, PROFILE_TACTICAL_MOVES, GenerateTacticalMoves(moves, board));
     ScoreTacticalMoves(moves, board);
     moves->phase = PLAY_GOOD_TACTICAL;
     // fallthrough
   case PLAY_GOOD_TACTICAL:
     if (moves->nTactical > 0) {
-      int idx = GetTopIdx(moves->sTactical, moves->nTactical);
-      Move m = moves->tactical[idx];
+      int idx = GetTopIdx(moves->moves, moves->nTactical);
+      Move m = moves->moves[idx].move;
 
       if (m == moves->hashMove) {
         PopGoodCapture(moves, idx);
@@ -165,16 +199,12 @@ Move NextMove(MoveList* moves, Board* board, int skipQuiets) {
         int attacker = PIECE_TYPE[MovePiece(m)];
         int victim = MoveEP(m) ? PAWN_TYPE : MoveCapture(m) ? PIECE_TYPE[board->squares[MoveEnd(m)]] : -1;
 
-        int see;
-        if (attacker > victim && (see = SEE(board, m)) < moves->seeCutoff) {
-          moves->sTactical[idx] = see;
+        if (attacker > victim && !PROFILED(moves->data, PROFILE_SEE, SEE(board, m, moves->seeCutoff))) {
           ShiftToBadCaptures(moves, idx);
           return NextMove(moves, board, skipQuiets);
         }
       } else {
-        int see;
-        if ((see = SEE(board, m)) < moves->seeCutoff) {
-          moves->sTactical[idx] = see;
+        if (!PROFILED(moves->data, PROFILE_SEE, SEE(board, m, moves->seeCutoff))) {
           ShiftToBadCaptures(moves, idx);
           return NextMove(moves, board, skipQuiets);
         }
@@ -208,16 +238,20 @@ Move NextMove(MoveList* moves, Board* board, int skipQuiets) {
     // fallthrough
   case GEN_QUIET_MOVES:
     if (!skipQuiets) {
-      GenerateQuietMoves(moves, board);
+      PROFILED_VOID(moves->data, PROFILE_QUIET_MOVES, GenerateQuietMoves(moves, board));
       ScoreQuietMoves(moves, board, moves->data);
     }
 
     moves->phase = PLAY_QUIETS;
     // fallthrough
   case PLAY_QUIETS:
-    if (moves->nQuiets > 0 && !skipQuiets) {
-      int idx = GetTopIdx(moves->sQuiet, moves->nQuiets);
-      Move m = PopQuiet(moves, idx);
+    if (moves->quietIdx < moves->nQuiets && !skipQuiets) {
+      if (moves->quietIdx < QUIET_SELECTIONS)
+        SelectTop(moves->moves, moves->quietIdx, moves->nQuiets);
+      else if (moves->quietIdx == QUIET_SELECTIONS)
+        InsertionSort(moves->moves + moves->quietIdx, moves->nQuiets - moves->quietIdx);
+
+      Move m = moves->moves[moves->quietIdx++].move;
 
       if (m == moves->hashMove || m == moves->killer1 || m == moves->killer2 || m == moves->counter)
         return NextMove(moves, board, skipQuiets);
@@ -265,10 +299,10 @@ char* PhaseName(MoveList* list) {
 }
 
 void PrintMoves(Board* board, ThreadData* thread) {
-  int hit = 0;
-  TTEntry* tt = TTProbe(&hit, board->zobrist);
+  TTData ttData = {0}, *tt = &ttData;
+  int hit = TTProbe(board->zobrist, tt);
 
-  printf("#HM: %5s\n", hit ? MoveToStr(tt->move) : "N/A");
+  printf("#HM: %5s\n", hit ? MoveToStr(UnpackMove(tt->move, board)) : "N/A");
 
   Move k1 = thread->data.killers[0][0];
   Move k2 = thread->data.killers[0][1];
@@ -278,7 +312,7 @@ void PrintMoves(Board* board, ThreadData* thread) {
 
   thread->data.ply = 0;
   MoveList list = {0};
-  InitAllMoves(&list, hit ? tt->move : NULL_MOVE, &thread->data);
+  InitAllMoves(&list, hit ? UnpackMove(tt->move, board) : NULL_MOVE, &thread->data);
 
   int i = 1;
   Move move;
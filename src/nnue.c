@@ -0,0 +1,325 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "bits.h"
+#include "board.h"
+#include "kernels.h"
+#include "move.h"
+#include "movegen.h"
+#include "nnue.h"
+#include "types.h"
+
+// set as soon as a network has been loaded, the classical eval is used otherwise
+int USE_NNUE = 0;
+
+// the bulk of the network, used in place from the file mapping (or the embedded copy)
+const int16_t* FT_WEIGHTS = NULL;
+CACHE_ALIGN int16_t FT_BIASES[NNUE_HIDDEN];
+
+// memory backing FT_WEIGHTS when it was loaded from a file, see LoadNetwork
+void* netMemory = NULL;
+size_t netMemorySize = 0;
+int netMapped = 0;
+
+CACHE_ALIGN int8_t L1_WEIGHTS[N_L1 * 2 * NNUE_HIDDEN];
+CACHE_ALIGN int32_t L1_BIASES[N_L1];
+
+CACHE_ALIGN int8_t L2_WEIGHTS[N_L2 * N_L1];
+CACHE_ALIGN int32_t L2_BIASES[N_L2];
+
+CACHE_ALIGN int8_t OUT_WEIGHTS[N_L2];
+int32_t OUT_BIAS;
+
+#ifdef EVALFILE
+// make EVALFILE=<path> links a default network into the binary
+__asm__(".section .rodata\n"
+        ".balign 64\n"
+        ".global embeddedNetwork\n"
+        "embeddedNetwork:\n"
+        ".incbin \"" EVALFILE "\"\n"
+        ".global embeddedNetworkEnd\n"
+        "embeddedNetworkEnd:\n"
+        ".byte 0\n"
+        ".previous\n");
+
+extern const unsigned char embeddedNetwork[];
+extern const unsigned char embeddedNetworkEnd[];
+#endif
+
+// the embedded network, if the binary was built with one
+int LoadDefaultNetwork() {
+#ifdef EVALFILE
+  if (!LoadNetworkFromMemory(embeddedNetwork, embeddedNetworkEnd - embeddedNetwork))
+    return 0;
+
+  ReleaseNetworkMemory(netMemory, netMemorySize, netMapped);
+  netMemory = NULL, netMemorySize = 0, netMapped = 0;
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+void InitNNUE() {
+#ifdef EVALFILE
+  if (!LoadDefaultNetwork())
+    printf("info string FAILED to load the embedded network\n");
+#endif
+}
+
+void ReleaseNetworkMemory(void* mem, size_t size, int mapped) {
+  if (!mem)
+    return;
+
+#if defined(__linux__)
+  if (mapped) {
+    munmap(mem, size);
+    return;
+  }
+#endif
+  (void)size, (void)mapped;
+
+  free(mem);
+}
+
+// The file is mapped read only and shared, so every engine process on a host
+// uses the same page cache copy and nothing is read until it is touched.
+// Without mmap the file is read into memory that is kept for the weights
+int LoadNetwork(char* path) {
+  void* mem = NULL;
+  size_t size = 0;
+  int mapped = 0;
+
+#if defined(__linux__)
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return 0;
+
+  struct stat st;
+  if (!fstat(fd, &st) && st.st_size > 0) {
+    size = st.st_size;
+    mem = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    mapped = mem != MAP_FAILED;
+    if (!mapped)
+      mem = NULL;
+  }
+  close(fd);
+#endif
+
+  if (!mem) {
+    FILE* fin = fopen(path, "rb");
+    if (fin == NULL)
+      return 0;
+
+    fseek(fin, 0, SEEK_END);
+    long length = ftell(fin);
+    fseek(fin, 0, SEEK_SET);
+
+    size = length > 0 ? length : 0;
+    mem = malloc(size ? size : 1);
+    if (fread(mem, 1, size, fin) != size)
+      size = 0;
+
+    fclose(fin);
+  }
+
+  if (!LoadNetworkFromMemory(mem, size)) {
+    ReleaseNetworkMemory(mem, size, mapped);
+    return 0;
+  }
+
+  // the previous network is no longer referenced
+  ReleaseNetworkMemory(netMemory, netMemorySize, netMapped);
+  netMemory = mem, netMemorySize = size, netMapped = mapped;
+
+  return 1;
+}
+
+inline void ReadBytes(void* dst, const unsigned char* data, size_t* offset, size_t n) {
+  memcpy(dst, data + *offset, n);
+  *offset += n;
+}
+
+// version, architecture hash and description, then each layer prefixed by its
+// own hash, weights are stored little endian with outputs as rows
+int LoadNetworkFromMemory(const unsigned char* data, size_t size) {
+  uint32_t version, hash, descSize;
+  if (size < 12)
+    return 0;
+
+  size_t offset = 0;
+  ReadBytes(&version, data, &offset, 4);
+  ReadBytes(&hash, data, &offset, 4);
+  ReadBytes(&descSize, data, &offset, 4);
+
+  size_t ftWeightsSize = (size_t)N_FEATURES * NNUE_HIDDEN * sizeof(int16_t);
+  size_t expected = 12 + (size_t)descSize + 4 + sizeof(FT_BIASES) + ftWeightsSize + 4 + sizeof(L1_BIASES) +
+                    sizeof(L1_WEIGHTS) + sizeof(L2_BIASES) + sizeof(L2_WEIGHTS) + sizeof(OUT_BIAS) +
+                    sizeof(OUT_WEIGHTS);
+
+  if (version != NNUE_VERSION || size != expected)
+    return 0;
+
+  offset += descSize + 4;
+  ReadBytes(FT_BIASES, data, &offset, sizeof(FT_BIASES));
+  // x86 is fine with the unaligned int16s the file layout gives
+  FT_WEIGHTS = (const int16_t*)(data + offset);
+  offset += ftWeightsSize;
+
+  offset += 4;
+  ReadBytes(L1_BIASES, data, &offset, sizeof(L1_BIASES));
+  ReadBytes(L1_WEIGHTS, data, &offset, sizeof(L1_WEIGHTS));
+  ReadBytes(L2_BIASES, data, &offset, sizeof(L2_BIASES));
+  ReadBytes(L2_WEIGHTS, data, &offset, sizeof(L2_WEIGHTS));
+  ReadBytes(&OUT_BIAS, data, &offset, sizeof(OUT_BIAS));
+  ReadBytes(OUT_WEIGHTS, data, &offset, sizeof(OUT_WEIGHTS));
+
+  USE_NNUE = 1;
+  return 1;
+}
+
+// networks number squares from a1 and see the board of black rotated
+inline int FeatureIdx(int perspective, int kingSq, int piece, int sq) {
+  int orient = perspective == WHITE ? 56 : 7;
+  int pieceIdx = 2 * PIECE_TYPE[piece] + ((piece & 1) != perspective);
+
+  return (sq ^ orient) + 1 + 64 * pieceIdx + 641 * (kingSq ^ orient);
+}
+
+inline void RefreshAccumulator(Accumulator* acc, Board* board, int perspective) {
+  int16_t* values = acc->values[perspective];
+  int kingSq = lsb(board->pieces[KING[perspective]]);
+
+  memcpy(values, FT_BIASES, sizeof(FT_BIASES));
+
+  for (int piece = PAWN_WHITE; piece <= QUEEN_BLACK; piece++) {
+    for (BitBoard bb = board->pieces[piece]; bb; popLsb(bb)) {
+      const int16_t* weights = &FT_WEIGHTS[FeatureIdx(perspective, kingSq, piece, lsb(bb)) * NNUE_HIDDEN];
+      AddWeights(values, weights, NNUE_HIDDEN);
+    }
+  }
+}
+
+// dst = src with the features a (non king) move changes
+inline void ApplyMove(Accumulator* dst, Accumulator* src, Move move, int captured, int kings[2]) {
+  int piece = MovePiece(move);
+  int start = MoveStart(move);
+  int end = MoveEnd(move);
+  int moved = MovePromo(move) ? MovePromo(move) : piece;
+  int side = piece & 1;
+
+  int capSq = end;
+  if (MoveEP(move)) {
+    captured = PAWN[side ^ 1];
+    capSq = end - PAWN_DIRECTIONS[side];
+  }
+
+  for (int c = WHITE; c <= BLACK; c++) {
+    const int16_t* sub = &FT_WEIGHTS[FeatureIdx(c, kings[c], piece, start) * NNUE_HIDDEN];
+    const int16_t* add = &FT_WEIGHTS[FeatureIdx(c, kings[c], moved, end) * NNUE_HIDDEN];
+    int16_t* out = dst->values[c];
+    int16_t* in = src->values[c];
+
+    if (captured != NO_PIECE) {
+      const int16_t* cap = &FT_WEIGHTS[FeatureIdx(c, kings[c], captured, capSq) * NNUE_HIDDEN];
+      AddSubSub(out, in, add, sub, cap, NNUE_HIDDEN);
+    } else {
+      AddSub(out, in, add, sub, NNUE_HIDDEN);
+    }
+  }
+}
+
+// Bring the accumulator of the current ply up to date from the closest
+// ancestor that has one, a king move in between means a full refresh
+void UpdateAccumulator(Board* board, ThreadData* thread) {
+  Accumulator* accumulators = thread->accumulators;
+  int now = board->moveNo, from = now, found = 0;
+
+  while (from > 0 && now - from < NNUE_MAX_REPLAY) {
+    BoardState* state = &board->history[(from - 1) & BOARD_HISTORY_MASK];
+    if (state->move != NULL_MOVE && PIECE_TYPE[MovePiece(state->move)] == KING_TYPE)
+      break;
+
+    from--;
+    if (accumulators[from & BOARD_HISTORY_MASK].key == state->zobrist) {
+      found = 1;
+      break;
+    }
+  }
+
+  Accumulator* acc = &accumulators[now & BOARD_HISTORY_MASK];
+  if (!found) {
+    RefreshAccumulator(acc, board, WHITE);
+    RefreshAccumulator(acc, board, BLACK);
+    acc->key = board->zobrist;
+    return;
+  }
+
+  int kings[2] = {lsb(board->pieces[KING_WHITE]), lsb(board->pieces[KING_BLACK])};
+  for (; from < now; from++) {
+    BoardState* state = &board->history[from & BOARD_HISTORY_MASK];
+    Accumulator* src = &accumulators[from & BOARD_HISTORY_MASK];
+    Accumulator* dst = &accumulators[(from + 1) & BOARD_HISTORY_MASK];
+
+    if (state->move == NULL_MOVE)
+      memcpy(dst->values, src->values, sizeof(src->values));
+    else
+      ApplyMove(dst, src, state->move, state->capture, kings);
+
+    dst->key = from + 1 == now ? board->zobrist : board->history[(from + 1) & BOARD_HISTORY_MASK].zobrist;
+  }
+}
+
+inline uint8_t ClippedReLU(int x) { return x < 0 ? 0 : x > 127 ? 127 : x; }
+
+inline void AffineClippedReLU(const uint8_t* in, int inputs, const int8_t* weights, const int32_t* biases,
+                              int outputs, uint8_t* out) {
+  for (int i = 0; i < outputs; i++)
+    out[i] = ClippedReLU((biases[i] + DotProduct(in, weights + i * inputs, inputs)) >> 6);
+}
+
+// network output from the perspective of the side to move
+int NNUEEvaluate(Board* board, ThreadData* thread) {
+  Accumulator* acc = &thread->accumulators[board->moveNo & BOARD_HISTORY_MASK];
+  if (acc->key != board->zobrist)
+    UpdateAccumulator(board, thread);
+
+  CACHE_ALIGN uint8_t input[2 * NNUE_HIDDEN];
+  CACHE_ALIGN uint8_t hidden1[N_L1];
+  CACHE_ALIGN uint8_t hidden2[N_L2];
+
+  for (int i = 0; i < NNUE_HIDDEN; i++) {
+    input[i] = ClippedReLU(acc->values[board->side][i]);
+    input[NNUE_HIDDEN + i] = ClippedReLU(acc->values[board->xside][i]);
+  }
+
+  AffineClippedReLU(input, 2 * NNUE_HIDDEN, L1_WEIGHTS, L1_BIASES, N_L1, hidden1);
+  AffineClippedReLU(hidden1, N_L1, L2_WEIGHTS, L2_BIASES, N_L2, hidden2);
+  int output = OUT_BIAS + DotProduct(hidden2, OUT_WEIGHTS, N_L2);
+
+  // the networks are trained with an endgame pawn of 208 and an output scale of 16
+  return output / 16 * 100 / 208;
+}
\ No newline at end of file
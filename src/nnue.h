@@ -0,0 +1,48 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef NNUE_H
+#define NNUE_H
+
+#include <stddef.h>
+
+#include "types.h"
+
+// HalfKP 256x2-32-32-1, the file layout of Stockfish 12 networks
+#define N_FEATURES (64 * 641)
+#define N_L1 32
+#define N_L2 32
+
+#define NNUE_VERSION 0x7AF32F16U
+
+extern int USE_NNUE;
+
+void InitNNUE();
+int LoadDefaultNetwork();
+void ReleaseNetworkMemory(void* mem, size_t size, int mapped);
+int LoadNetwork(char* path);
+int LoadNetworkFromMemory(const unsigned char* data, size_t size);
+void ReadBytes(void* dst, const unsigned char* data, size_t* offset, size_t n);
+int FeatureIdx(int perspective, int kingSq, int piece, int sq);
+void RefreshAccumulator(Accumulator* acc, Board* board, int perspective);
+void ApplyMove(Accumulator* dst, Accumulator* src, Move move, int captured, int kings[2]);
+void UpdateAccumulator(Board* board, ThreadData* thread);
+uint8_t ClippedReLU(int x);
+void AffineClippedReLU(const uint8_t* in, int inputs, const int8_t* weights, const int32_t* biases, int outputs,
+                       uint8_t* out);
+int NNUEEvaluate(Board* board, ThreadData* thread);
+
+#endif
\ No newline at end of file
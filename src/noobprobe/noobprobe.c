@@ -17,6 +17,8 @@
 // NOOBPROBE IS WRITTEN BY Terje Kirstihagen (Weiss)
 // I take 0 credit for this code.
 
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -28,6 +30,7 @@
 
 #else
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <netinet/in.h>
 #include <netdb.h>
 #define SOCKET int
@@ -39,6 +42,7 @@
 #define WSADATA int
 #define WSAStartup(a, b) (*b = 0)
 #define WSACleanup()
+#define closesocket close
 #endif
 
 #include "noobprobe.h"
@@ -46,71 +50,336 @@
 #include "../move.h"
 #include "../types.h"
 
+#define NOOB_HOST "www.chessdb.cn"
+#define NOOB_CACHE_SIZE 65536
+
 int NOOB_BOOK = 0;
 int NOOB_DEPTH_LIMIT = 8;
+int NOOB_TIMEOUT_MS = 2000;
+char NOOB_CACHE_FILE[256] = "";
 int failedQueries = 0;
 
-void error(const char *msg) { perror(msg); exit(0); }
+// Positions already asked about, NO_BOOK_MOVE when the database had none.
+// Book thread and uci thread both use these, under the mutex
+#define NO_BOOK_MOVE 0xFFFFFFFF
 
-// Probes noobpwnftw's Chess Cloud Database
-Move ProbeNoob(Board* board) {
+typedef struct {
+    uint64_t key;
+    Move move;
+} NoobCacheEntry;
 
-    // Stop querying after 3 failures or at the specified depth
-    if (  !NOOB_BOOK
-        || failedQueries >= 3
-        || (NOOB_DEPTH_LIMIT && board->moveNo > NOOB_DEPTH_LIMIT))
-        return NULL_MOVE;
+NoobCacheEntry noobCache[NOOB_CACHE_SIZE];
+pthread_mutex_t noobMutex = PTHREAD_MUTEX_INITIALIZER;
 
-    // Setup sockets on windows, does nothing on linux
-    WSADATA wsaData;
-    if (WSAStartup(MAKEWORD(2,2), &wsaData) != 0)
-        error("WSAStartup failed.");
+int noobWsaReady = 0;
 
-    // Make the message
-    char *message_fmt = "GET http://www.chessdb.cn/cdb.php?action=querybest&board=%s\r\n\r\n";
-    char message[256], response[32];
+typedef struct {
+    int request;
+    uint64_t key;
     char fen[128];
+} NoobQuery;
+
+// The request the current search waits for. A late answer only goes into the cache
+int noobRequest = 0, noobAnswered = 0;
+Move noobAnswer = NULL_MOVE;
+atomic_int* noobStop = NULL;
+int noobBusy = 0;
+NoobQuery* noobPending = NULL;
+
+// Connection kept alive between queries, the host is only looked up once
+SOCKET noobSocket = INVALID_SOCKET;
+SOCKADDR_IN noobServer;
+int noobResolved = 0;
+
+Move NoobCacheGet(uint64_t key) {
+    NoobCacheEntry* e = &noobCache[key & (NOOB_CACHE_SIZE - 1)];
+    return e->key == key ? e->move : NULL_MOVE;
+}
+
+void NoobCachePut(uint64_t key, Move move) {
+    noobCache[key & (NOOB_CACHE_SIZE - 1)] = (NoobCacheEntry) { .key = key, .move = move };
+}
+
+// Book moves found before are kept on disk, one "fen;move" line each
+void NoobLoadCache(char* path) {
+    snprintf(NOOB_CACHE_FILE, sizeof(NOOB_CACHE_FILE), "%s", !strcmp(path, "<empty>") ? "" : path);
+
+    FILE* fp = NOOB_CACHE_FILE[0] ? fopen(NOOB_CACHE_FILE, "r") : NULL;
+    if (!fp)
+        return;
+
+    char line[256];
+    int n = 0;
+    Board board;
+
+    pthread_mutex_lock(&noobMutex);
+    while (fgets(line, sizeof(line), fp)) {
+        char* sep = strchr(line, ';');
+        if (!sep)
+            continue;
+
+        *sep = '\0';
+        sep[1 + strcspn(sep + 1, "\r\n")] = '\0';
+
+        ParseFen(line, &board);
+        Move move = ParseMove(sep + 1, &board);
+        if (move)
+            NoobCachePut(board.zobrist, move), n++;
+    }
+    pthread_mutex_unlock(&noobMutex);
+
+    fclose(fp);
+    printf("info string loaded %d NoobBook moves from %s\n", n, NOOB_CACHE_FILE);
+}
+
+void NoobSaveMove(char* fen, Move move) {
+    FILE* fp = NOOB_CACHE_FILE[0] ? fopen(NOOB_CACHE_FILE, "a") : NULL;
+    if (!fp)
+        return;
+
+    fprintf(fp, "%s;%s\n", fen, MoveToStr(move));
+    fclose(fp);
+}
+
+void NoobDisconnect() {
+    if (noobSocket != INVALID_SOCKET)
+        closesocket(noobSocket);
+    noobSocket = INVALID_SOCKET;
+}
+
+int NoobConnect() {
+    if (noobSocket != INVALID_SOCKET)
+        return 1;
+
+    if (!noobResolved) {
+        HOSTENT *hostent = gethostbyname(NOOB_HOST);
+        if (hostent == NULL)
+            return 0;
+
+        memset(&noobServer, 0, sizeof(noobServer));
+        noobServer.sin_family = AF_INET;
+        noobServer.sin_port = htons(80);
+        memcpy(&noobServer.sin_addr, hostent->h_addr, sizeof(noobServer.sin_addr));
+        noobResolved = 1;
+    }
+
+    if ((noobSocket = socket(AF_INET, SOCK_STREAM, 0)) == INVALID_SOCKET)
+        return 0;
+
+    // a slow database fails the query rather than holding on to the thread
+#ifdef _WIN32
+    DWORD timeout = NOOB_TIMEOUT_MS;
+#else
+    struct timeval timeout = { NOOB_TIMEOUT_MS / 1000, (NOOB_TIMEOUT_MS % 1000) * 1000 };
+#endif
+    setsockopt(noobSocket, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
+    setsockopt(noobSocket, SOL_SOCKET, SO_SNDTIMEO, (const char *)&timeout, sizeof(timeout));
+
+    if (connect(noobSocket, (struct sockaddr *)&noobServer, sizeof(noobServer)) < 0) {
+        NoobDisconnect();
+        noobResolved = 0; // the address may have changed
+        return 0;
+    }
+
+    return 1;
+}
+
+// One HTTP/1.1 request on the kept alive connection, the body ends up in
+// response. Returns 0 on any network error, the connection is then dropped
+int NoobRequest(char* fen, char* response, int size) {
+    char message[512];
+    char* m = message + sprintf(message, "GET /cdb.php?action=querybest&board=");
+    for (char* c = fen; *c; c++)
+        m += *c == ' ' ? sprintf(m, "%%20") : sprintf(m, "%c", *c);
+    sprintf(m, " HTTP/1.1\r\nHost: " NOOB_HOST "\r\nConnection: keep-alive\r\n\r\n");
+
+    if (!NoobConnect())
+        return 0;
+
+    if (send(noobSocket, message, strlen(message), 0) < 0)
+        return NoobDisconnect(), 0;
+
+    // read up to the end of the body, as given by the headers
+    int len = 0, bodyStart = -1, contentLength = -1, chunked = 0, closing = 0;
+    while (len < size - 1) {
+        int n = recv(noobSocket, response + len, size - 1 - len, 0);
+        if (n <= 0)
+            break;
 
-    BoardToFen(fen, board);
-    sprintf(message, message_fmt, fen);
+        len += n;
+        response[len] = '\0';
 
-    // Create socket
-    SOCKET sockfd;
-    if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) == INVALID_SOCKET)
-        error("ERROR opening socket");
+        if (bodyStart < 0) {
+            char* end = strstr(response, "\r\n\r\n");
+            if (!end)
+                continue;
 
-    // Lookup IP address
-    HOSTENT *hostent;
-    if ((hostent = gethostbyname("www.chessdb.cn")) == NULL)
-        error("ERROR no such host");
+            bodyStart = end + 4 - response;
+            *end = '\0';
 
-    // Fill in server struct
-    SOCKADDR_IN server = { 0 };
-    server.sin_family = AF_INET;
-    server.sin_port = htons(80);
-    server.sin_addr.s_addr = *(uint64_t *)hostent->h_addr;
+            char* cl = strstr(response, "Content-Length:");
+            contentLength = cl ? atoi(cl + 15) : -1;
+            chunked = strstr(response, "chunked") != NULL;
+            closing = strstr(response, "Connection: close") != NULL;
+            *end = '\r';
+        }
 
-    // Connect
-    if (connect(sockfd, (struct sockaddr *)&server, sizeof(server)) < 0)
-        error("ERROR connecting");
+        if (contentLength >= 0 && len - bodyStart >= contentLength)
+            break;
+        if (chunked && strstr(response + bodyStart, "\r\n0\r\n\r\n"))
+            break;
+    }
 
-    // Send message
-    if (send(sockfd, message, strlen(message), 0) < 0)
-        error("ERROR sending");
+    if (bodyStart < 0)
+        return NoobDisconnect(), 0;
 
-    // Receive response
-    memset(response, 0, sizeof(response));
-    if (recv(sockfd, response, sizeof(response), 0) == SOCKET_ERROR)
-        error("ERROR receiving");
+    if (closing || (contentLength < 0 && !chunked))
+        NoobDisconnect();
+
+    memmove(response, response + bodyStart, len - bodyStart + 1);
+
+    // a chunked body starts with its length
+    if (chunked) {
+        char* body = strstr(response, "\r\n");
+        if (body)
+            memmove(response, body + 2, strlen(body + 2) + 1);
+    }
+
+    return 1;
+}
+
+Move NoobQueryMove(NoobQuery* query) {
+    char response[1024];
+
+    // a kept alive connection may have been closed by the server meanwhile
+    int ok = NoobRequest(query->fen, response, sizeof(response));
+    if (!ok)
+        ok = NoobRequest(query->fen, response, sizeof(response));
+
+    pthread_mutex_lock(&noobMutex);
+
+    Move move = NULL_MOVE;
+    if (!ok) {
+        failedQueries++;
+    } else if (strstr(response, "move:") == response) {
+        // On success the response will be "move:[MOVE]"
+        Board board;
+        ParseFen(query->fen, &board);
+
+        response[5 + strcspn(response + 5, "\r\n")] = '\0';
+        move = ParseMove(&response[5], &board);
+    }
+
+    if (move) {
+        failedQueries = 0;
+        NoobCachePut(query->key, move);
+        NoobSaveMove(query->fen, move);
+    } else if (ok) {
+        failedQueries++;
+        NoobCachePut(query->key, NO_BOOK_MOVE);
+    }
+
+    pthread_mutex_unlock(&noobMutex);
+    return move;
+}
+
+// Serves queries until there are none pending, only the latest one waits
+void* NoobThread(void* arg) {
+    NoobQuery* query = (NoobQuery*)arg;
+
+    while (query) {
+        Move move = NoobQueryMove(query);
+
+        // hand the move to the search that asked for it, which stops to play it
+        pthread_mutex_lock(&noobMutex);
+        if (query->request == noobRequest) {
+            noobAnswered = 1;
+            noobAnswer = move;
+            if (move && noobStop)
+                atomic_store(noobStop, 1);
+        }
+
+        free(query);
+        query = noobPending;
+        noobPending = NULL;
+        noobBusy = query != NULL;
+        pthread_mutex_unlock(&noobMutex);
+    }
+
+    return NULL;
+}
+
+// Probes noobpwnftw's Chess Cloud Database. A position seen before is
+// answered from the cache, otherwise a query is started in the background
+// and the search runs meanwhile, it is stopped once the answer arrives
+Move ProbeNoob(Board* board, atomic_int* stop) {
+
+    // Stop querying at the specified depth or after 3 failures, which the
+    // query thread counts under the lock
+    if (!NOOB_BOOK || (NOOB_DEPTH_LIMIT && board->moveNo > NOOB_DEPTH_LIMIT))
+        return NULL_MOVE;
+
+    pthread_mutex_lock(&noobMutex);
+
+    if (failedQueries >= 3) {
+        pthread_mutex_unlock(&noobMutex);
+        return NULL_MOVE;
+    }
+
+    Move cached = NoobCacheGet(board->zobrist);
+    noobRequest++;
+    noobAnswered = 0;
+    noobAnswer = NULL_MOVE;
+    noobStop = stop;
+
+    if (cached) {
+        pthread_mutex_unlock(&noobMutex);
+        return cached == NO_BOOK_MOVE ? NULL_MOVE : cached;
+    }
+
+    NoobQuery* query = malloc(sizeof(NoobQuery));
+    query->request = noobRequest;
+    query->key = board->zobrist;
+    BoardToFen(query->fen, board);
+
+    // one query at a time, the busy thread picks this one up when done
+    if (noobBusy) {
+        free(noobPending);
+        noobPending = query;
+        pthread_mutex_unlock(&noobMutex);
+        return NULL_MOVE;
+    }
+
+    noobBusy = 1;
+    pthread_mutex_unlock(&noobMutex);
+
+    // Setup sockets on windows, does nothing on linux
+    WSADATA wsaData;
+    if (!noobWsaReady && WSAStartup(MAKEWORD(2,2), &wsaData) == 0)
+        noobWsaReady = 1;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, NoobThread, query)) {
+        free(query);
+        pthread_mutex_lock(&noobMutex);
+        noobBusy = 0;
+        pthread_mutex_unlock(&noobMutex);
+        return NULL_MOVE;
+    }
+    pthread_detach(thread);
+
+    return NULL_MOVE;
+}
 
-    // Cleanup
-    close(sockfd);
-    WSACleanup();
+// The book move for the last probe if it arrived during the search. Any
+// later answer is cached only
+Move NoobResult() {
+    pthread_mutex_lock(&noobMutex);
 
-    // On success the response will be "move:[MOVE]"
-    if (strstr(response, "move") != response)
-        return failedQueries++, NULL_MOVE;
+    Move move = noobAnswered ? noobAnswer : NULL_MOVE;
+    noobRequest++;
+    noobStop = NULL;
 
-    Move bestMove = ParseMove(&response[5], board);
-    return failedQueries = 0, bestMove;
+    pthread_mutex_unlock(&noobMutex);
+    return move;
 }
@@ -17,11 +17,17 @@
 // NOOBPROBE IS WRITTEN BY Terje Kirstihagen (Weiss)
 // I take 0 credit for this code.
 
+#include <stdatomic.h>
+
 #include "../board.h"
 #include "../types.h"
 
 extern int NOOB_BOOK;
 extern int NOOB_DEPTH_LIMIT;
+extern int NOOB_TIMEOUT_MS;
+extern char NOOB_CACHE_FILE[256];
 extern int failedQueries;
 
-Move ProbeNoob(Board* board);
\ No newline at end of file
+void NoobLoadCache(char* path);
+Move ProbeNoob(Board* board, atomic_int* stop);
+Move NoobResult();
\ No newline at end of file
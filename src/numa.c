@@ -0,0 +1,109 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#if defined(__linux__) && !defined(__ANDROID__)
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "numa.h"
+
+#define MAX_NODES 64
+#define MAX_CPUS 1024
+
+// interleave policy value from <numaif.h>, defined here to avoid libnuma
+#define NUMA_MPOL_INTERLEAVE 3
+
+int NUMA = 0;
+
+int numNodes = 0;
+int nodeCpuCount[MAX_NODES];
+int nodeCpus[MAX_NODES][MAX_CPUS];
+
+// Node topology is read from sysfs once, each line of a cpulist
+// looks something like "0-15,32-47"
+void InitNuma() {
+#if defined(__linux__) && !defined(__ANDROID__)
+  char path[128];
+
+  for (int node = 0; node < MAX_NODES; node++) {
+    sprintf(path, "/sys/devices/system/node/node%d/cpulist", node);
+
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL)
+      continue;
+
+    int from, to, n = 0;
+    while (fscanf(fp, "%d", &from) == 1) {
+      to = from;
+      if (fgetc(fp) == '-' && fscanf(fp, "%d", &to) == 1)
+        fgetc(fp); // skip separator
+
+      for (int cpu = from; cpu <= to && n < MAX_CPUS; cpu++)
+        nodeCpus[numNodes][n++] = cpu;
+    }
+
+    fclose(fp);
+
+    if (n)
+      nodeCpuCount[numNodes++] = n;
+  }
+#endif
+}
+
+// Threads are spread round robin across nodes so that any thread
+// count splits evenly, and then across the cores within that node
+void BindThread(int idx) {
+#if defined(__linux__) && !defined(__ANDROID__)
+  if (!NUMA || numNodes < 1)
+    return;
+
+  int node = idx % numNodes;
+  int cpu = nodeCpus[node][(idx / numNodes) % nodeCpuCount[node]];
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+
+  pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+#else
+  (void)idx;
+#endif
+}
+
+// Request that pages of a shared allocation be spread across all nodes
+// This must be called prior to the memory being touched
+void InterleaveMemory(void* ptr, size_t size) {
+#if defined(__linux__) && !defined(__ANDROID__) && defined(SYS_mbind)
+  if (!NUMA || numNodes < 2)
+    return;
+
+  unsigned long mask = 0;
+  for (int node = 0; node < numNodes && node < 64; node++)
+    mask |= 1UL << node;
+
+  syscall(SYS_mbind, ptr, size, NUMA_MPOL_INTERLEAVE, &mask, numNodes + 1, 0);
+#else
+  (void)ptr;
+  (void)size;
+#endif
+}
@@ -0,0 +1,186 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "output.h"
+#include "util.h"
+
+// ms between two writes of the coalesced updates, 0 writes every one
+int INFO_INTERVAL = 50;
+
+OutputQueue OUTPUT = {.mutex = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER};
+
+void OutputStart() {
+  OUTPUT.stop = 0;
+  OUTPUT.running = 1;
+  pthread_create(&OUTPUT.thread, NULL, OutputLoop, NULL);
+}
+
+// everything queued is written before the thread exits
+void OutputStop() {
+  if (!OUTPUT.running)
+    return;
+
+  pthread_mutex_lock(&OUTPUT.mutex);
+  OUTPUT.stop = 1;
+  pthread_cond_signal(&OUTPUT.wake);
+  pthread_mutex_unlock(&OUTPUT.mutex);
+
+  pthread_join(OUTPUT.thread, NULL);
+  OUTPUT.running = 0;
+}
+
+void* OutputLoop(void* arg) {
+  (void)arg;
+
+  char* buffer = NULL;
+  size_t capacity = 0;
+
+  pthread_mutex_lock(&OUTPUT.mutex);
+
+  for (;;) {
+    while (!OUTPUT.len && !OUTPUT.stop) {
+      if (!OUTPUT.numPending) {
+        pthread_cond_wait(&OUTPUT.wake, &OUTPUT.mutex);
+        continue;
+      }
+
+      long wait = OUTPUT.lastUpdate + INFO_INTERVAL - GetTimeMS();
+      if (wait <= 0) {
+        OutputPending();
+        break;
+      }
+
+      struct timespec until;
+      clock_gettime(CLOCK_REALTIME, &until);
+      until.tv_sec += wait / 1000;
+      until.tv_nsec += (wait % 1000) * 1000000;
+      if (until.tv_nsec >= 1000000000) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+      }
+
+      pthread_cond_timedwait(&OUTPUT.wake, &OUTPUT.mutex, &until);
+    }
+
+    if (OUTPUT.stop)
+      OutputPending();
+
+    if (!OUTPUT.len)
+      break;
+
+    // swap buffers, producers keep appending while this one is written
+    char* full = OUTPUT.queue;
+    size_t len = OUTPUT.len, size = OUTPUT.capacity;
+    OUTPUT.queue = buffer, OUTPUT.capacity = capacity, OUTPUT.len = 0;
+    buffer = full, capacity = size;
+
+    pthread_mutex_unlock(&OUTPUT.mutex);
+    fwrite(buffer, 1, len, stdout);
+    fflush(stdout);
+    pthread_mutex_lock(&OUTPUT.mutex);
+  }
+
+  pthread_mutex_unlock(&OUTPUT.mutex);
+  free(buffer);
+
+  return NULL;
+}
+
+// the caller holds the lock
+void OutputAppend(const char* str, size_t len) {
+  if (OUTPUT.len + len > OUTPUT.capacity) {
+    OUTPUT.capacity = max(2 * OUTPUT.capacity, OUTPUT.len + len);
+    OUTPUT.queue = realloc(OUTPUT.queue, OUTPUT.capacity);
+  }
+
+  memcpy(OUTPUT.queue + OUTPUT.len, str, len);
+  OUTPUT.len += len;
+}
+
+// queues the latest line of every slot, in slot order. The caller holds the lock
+void OutputPending() {
+  for (int i = 0; OUTPUT.numPending && i < OUTPUT_SLOTS; i++) {
+    if (!OUTPUT.pending[i])
+      continue;
+
+    OutputAppend(OUTPUT.slots[i], strlen(OUTPUT.slots[i]));
+    OUTPUT.pending[i] = 0;
+    OUTPUT.numPending--;
+  }
+
+  OUTPUT.lastUpdate = GetTimeMS();
+}
+
+// a line that is never dropped, the updates before it are written first
+void UCIPrintf(const char* fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+
+  if (!OUTPUT.running) {
+    vprintf(fmt, args);
+    va_end(args);
+    return;
+  }
+
+  char line[OUTPUT_LINE];
+  int len = vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+
+  pthread_mutex_lock(&OUTPUT.mutex);
+  OutputPending();
+  OutputAppend(line, min(len, (int)sizeof(line) - 1));
+  pthread_cond_signal(&OUTPUT.wake);
+  pthread_mutex_unlock(&OUTPUT.mutex);
+}
+
+// a line that replaces the last one of its slot when that was not yet written
+void UCIUpdate(int slot, const char* fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+
+  if (!OUTPUT.running) {
+    vprintf(fmt, args);
+    va_end(args);
+    return;
+  }
+
+  pthread_mutex_lock(&OUTPUT.mutex);
+  vsnprintf(OUTPUT.slots[slot], OUTPUT_LINE, fmt, args);
+  va_end(args);
+
+  if (!OUTPUT.pending[slot]) {
+    OUTPUT.pending[slot] = 1;
+    OUTPUT.numPending++;
+  }
+
+  // a root move from before a new pv is out of date
+  if (slot != OUTPUT_CURRMOVE && OUTPUT.pending[OUTPUT_CURRMOVE]) {
+    OUTPUT.pending[OUTPUT_CURRMOVE] = 0;
+    OUTPUT.numPending--;
+  }
+
+  if (!INFO_INTERVAL)
+    OutputPending();
+
+  pthread_cond_signal(&OUTPUT.wake);
+  pthread_mutex_unlock(&OUTPUT.mutex);
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "types.h"
+
+#define OUTPUT_LINE 4096
+
+// coalesced updates, the info of multipv rank k is kept in slot OUTPUT_INFO + k
+enum {
+  OUTPUT_INFO = 0,
+  OUTPUT_CURRMOVE = MAX_MULTI_PV + 1,
+  OUTPUT_SLOTS,
+};
+
+// Lines for the GUI, written to stdout by their own thread so that a slow
+// pipe never blocks the search. Updates only keep their latest line until written
+typedef struct {
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t wake;
+  int running, stop;
+
+  char* queue;
+  size_t len, capacity;
+
+  long lastUpdate;
+  int numPending;
+  int pending[OUTPUT_SLOTS];
+  char slots[OUTPUT_SLOTS][OUTPUT_LINE];
+} OutputQueue;
+
+extern int INFO_INTERVAL;
+
+void OutputStart();
+void OutputStop();
+void* OutputLoop(void* arg);
+void OutputAppend(const char* str, size_t len);
+void OutputPending();
+void UCIPrintf(const char* fmt, ...);
+void UCIUpdate(int slot, const char* fmt, ...);
+
+#endif
\ No newline at end of file
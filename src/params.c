@@ -0,0 +1,203 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "eval.h"
+#include "params.h"
+#include "types.h"
+
+// every tunable eval weight, so that a tune can be tried without rebuilding
+EvalParam EVAL_PARAMS[] = {
+    {"MATERIAL_VALUES", MATERIAL_VALUES, 1, 7},
+    {"BISHOP_PAIR", &BISHOP_PAIR, 1, 1},
+    {"PAWN_PSQT", &PAWN_PSQT[0][0], 2, 32},
+    {"KNIGHT_PSQT", &KNIGHT_PSQT[0][0], 2, 32},
+    {"BISHOP_PSQT", &BISHOP_PSQT[0][0], 2, 32},
+    {"ROOK_PSQT", &ROOK_PSQT[0][0], 2, 32},
+    {"QUEEN_PSQT", &QUEEN_PSQT[0][0], 2, 32},
+    {"KING_PSQT", &KING_PSQT[0][0], 2, 32},
+    {"KNIGHT_POST_PSQT", KNIGHT_POST_PSQT, 1, 12},
+    {"BISHOP_POST_PSQT", BISHOP_POST_PSQT, 1, 12},
+    {"KNIGHT_MOBILITIES", KNIGHT_MOBILITIES, 1, 9},
+    {"BISHOP_MOBILITIES", BISHOP_MOBILITIES, 1, 14},
+    {"ROOK_MOBILITIES", ROOK_MOBILITIES, 1, 15},
+    {"QUEEN_MOBILITIES", QUEEN_MOBILITIES, 1, 28},
+    {"MINOR_BEHIND_PAWN", &MINOR_BEHIND_PAWN, 1, 1},
+    {"KNIGHT_OUTPOST_REACHABLE", &KNIGHT_OUTPOST_REACHABLE, 1, 1},
+    {"BISHOP_OUTPOST_REACHABLE", &BISHOP_OUTPOST_REACHABLE, 1, 1},
+    {"BISHOP_TRAPPED", &BISHOP_TRAPPED, 1, 1},
+    {"ROOK_TRAPPED", &ROOK_TRAPPED, 1, 1},
+    {"BAD_BISHOP_PAWNS", &BAD_BISHOP_PAWNS, 1, 1},
+    {"DRAGON_BISHOP", &DRAGON_BISHOP, 1, 1},
+    {"ROOK_OPEN_FILE", &ROOK_OPEN_FILE, 1, 1},
+    {"ROOK_SEMI_OPEN", &ROOK_SEMI_OPEN, 1, 1},
+    {"DEFENDED_PAWN", &DEFENDED_PAWN, 1, 1},
+    {"DOUBLED_PAWN", &DOUBLED_PAWN, 1, 1},
+    {"ISOLATED_PAWN", ISOLATED_PAWN, 1, 4},
+    {"OPEN_ISOLATED_PAWN", &OPEN_ISOLATED_PAWN, 1, 1},
+    {"BACKWARDS_PAWN", &BACKWARDS_PAWN, 1, 1},
+    {"CONNECTED_PAWN", CONNECTED_PAWN, 1, 8},
+    {"CANDIDATE_PASSER", CANDIDATE_PASSER, 1, 8},
+    {"CANDIDATE_EDGE_DISTANCE", &CANDIDATE_EDGE_DISTANCE, 1, 1},
+    {"PASSED_PAWN", PASSED_PAWN, 1, 8},
+    {"PASSED_PAWN_EDGE_DISTANCE", &PASSED_PAWN_EDGE_DISTANCE, 1, 1},
+    {"PASSED_PAWN_KING_PROXIMITY", &PASSED_PAWN_KING_PROXIMITY, 1, 1},
+    {"PASSED_PAWN_ADVANCE_DEFENDED", PASSED_PAWN_ADVANCE_DEFENDED, 1, 5},
+    {"PASSED_PAWN_ENEMY_SLIDER_BEHIND", &PASSED_PAWN_ENEMY_SLIDER_BEHIND, 1, 1},
+    {"PASSED_PAWN_SQ_RULE", &PASSED_PAWN_SQ_RULE, 1, 1},
+    {"KNIGHT_THREATS", KNIGHT_THREATS, 1, 6},
+    {"BISHOP_THREATS", BISHOP_THREATS, 1, 6},
+    {"ROOK_THREATS", ROOK_THREATS, 1, 6},
+    {"KING_THREAT", &KING_THREAT, 1, 1},
+    {"PAWN_THREAT", &PAWN_THREAT, 1, 1},
+    {"PAWN_PUSH_THREAT", &PAWN_PUSH_THREAT, 1, 1},
+    {"HANGING_THREAT", &HANGING_THREAT, 1, 1},
+    {"SPACE", &SPACE, 1, 1},
+    {"IMBALANCE", &IMBALANCE[0][0], 5, 5},
+    {"PAWN_SHELTER", &PAWN_SHELTER[0][0], 4, 8},
+    {"PAWN_STORM", &PAWN_STORM[0][0], 4, 8},
+    {"BLOCKED_PAWN_STORM", BLOCKED_PAWN_STORM, 1, 8},
+    {"CAN_CASTLE", &CAN_CASTLE, 1, 1},
+    {"KS_ATTACKER_WEIGHTS", KS_ATTACKER_WEIGHTS, 1, 5},
+    {"KS_WEAK_SQS", &KS_WEAK_SQS, 1, 1},
+    {"KS_PINNED", &KS_PINNED, 1, 1},
+    {"KS_KNIGHT_CHECK", &KS_KNIGHT_CHECK, 1, 1},
+    {"KS_BISHOP_CHECK", &KS_BISHOP_CHECK, 1, 1},
+    {"KS_ROOK_CHECK", &KS_ROOK_CHECK, 1, 1},
+    {"KS_QUEEN_CHECK", &KS_QUEEN_CHECK, 1, 1},
+    {"KS_UNSAFE_CHECK", &KS_UNSAFE_CHECK, 1, 1},
+    {"KS_ENEMY_QUEEN", &KS_ENEMY_QUEEN, 1, 1},
+    {"KS_KNIGHT_DEFENSE", &KS_KNIGHT_DEFENSE, 1, 1},
+    {"TEMPO", &TEMPO, 1, 1},
+};
+
+const int N_EVAL_PARAMS = sizeof(EVAL_PARAMS) / sizeof(EvalParam);
+
+inline EvalParam* FindEvalParam(const char* name, int length) {
+  for (int i = 0; i < N_EVAL_PARAMS; i++)
+    if ((int)strlen(EVAL_PARAMS[i].name) == length && !strncmp(EVAL_PARAMS[i].name, name, length))
+      return &EVAL_PARAMS[i];
+
+  return NULL;
+}
+
+// Parses the initializer after "= " up to the ';'. Values are S(mg, eg) or
+// plain integers, rows of 2D params are brace enclosed and anything missing
+// is zero, as it would be in C. Returns the position after ';', or NULL
+char* ParseEvalParam(char* p, EvalParam* param, int apply) {
+  int size = param->rows * param->cols;
+  int depth = 0, row = 0, col = 0;
+
+  if (apply)
+    memset(param->values, 0, size * sizeof(Score));
+
+  for (; *p && *p != ';'; p++) {
+    if (*p == '{') {
+      depth++;
+    } else if (*p == '}') {
+      if (depth-- == 2 && param->rows > 1)
+        row++, col = 0;
+    } else if (*p == 'S' && p[1] == '(') {
+      int mg, eg;
+      if (sscanf(p + 2, " %d , %d", &mg, &eg) != 2)
+        return NULL;
+
+      if (row >= param->rows || col >= param->cols)
+        return NULL;
+
+      if (apply)
+        param->values[row * param->cols + col] = makeScore(mg, eg);
+      col++;
+
+      p = strchr(p, ')');
+      if (!p)
+        return NULL;
+    } else if (isdigit(*p) || (*p == '-' && isdigit(p[1]))) {
+      char* end;
+      long value = strtol(p, &end, 10);
+
+      if (row >= param->rows || col >= param->cols)
+        return NULL;
+
+      if (apply)
+        param->values[row * param->cols + col] = value;
+      col++;
+
+      p = end - 1;
+    }
+  }
+
+  if (*p != ';' || (size > 1 && depth != 0))
+    return NULL;
+
+  return p + 1;
+}
+
+// One pass over the definitions, later ones win so an appended weights.out
+// gives its last epoch. Returns how many definitions were read, -1 on error
+int ReadEvalParams(char* text, int apply) {
+  int count = 0;
+
+  for (char* p = text; (p = strstr(p, "Score "));) {
+    p += 6;
+
+    char* name = p;
+    while (isupper(*p) || isdigit(*p) || *p == '_')
+      p++;
+
+    EvalParam* param = FindEvalParam(name, p - name);
+    if (!param)
+      continue;
+
+    p = strchr(p, '=');
+    if (!p || !(p = ParseEvalParam(p + 1, param, apply)))
+      return -1;
+
+    count++;
+  }
+
+  return count;
+}
+
+// Loads weights in the format of eval.c, which is what the tuner writes to
+// weights.out. Nothing is applied unless the whole file parses
+int LoadEvalParams(char* path) {
+  FILE* fin = fopen(path, "rb");
+  if (fin == NULL)
+    return -1;
+
+  fseek(fin, 0, SEEK_END);
+  long size = ftell(fin);
+  fseek(fin, 0, SEEK_SET);
+
+  char* text = calloc(size + 1, 1);
+  if (fread(text, 1, size, fin) != (size_t)size)
+    size = -1;
+  fclose(fin);
+
+  int count = size >= 0 ? ReadEvalParams(text, 0) : -1;
+  if (count > 0) {
+    ReadEvalParams(text, 1);
+    InitPSQT();
+  }
+
+  free(text);
+  return count;
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PARAMS_H
+#define PARAMS_H
+
+#include "types.h"
+
+typedef struct {
+  const char* name;
+  Score* values;
+  int rows, cols;
+} EvalParam;
+
+extern EvalParam EVAL_PARAMS[];
+extern const int N_EVAL_PARAMS;
+
+EvalParam* FindEvalParam(const char* name, int length);
+char* ParseEvalParam(char* p, EvalParam* param, int apply);
+int ReadEvalParams(char* text, int apply);
+int LoadEvalParams(char* path);
+
+#endif
\ No newline at end of file
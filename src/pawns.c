@@ -29,17 +29,35 @@
 #define T 0
 #endif
 
-extern EvalCoeffs C;
+extern _Thread_local EvalCoeffs C;
 extern int cs[2];
 
+// size of each thread's pawn hash
+int PAWN_HASH_MB = 2;
+
 inline PawnHashEntry* TTPawnProbe(uint64_t hash, ThreadData* thread) {
-  PawnHashEntry* entry = &thread->pawnHashTable[(hash & PAWN_TABLE_MASK)];
-  return entry->hash == hash ? entry : NULL;
+  PawnHashEntry* bucket = thread->pawnHashTable[hash & thread->pawnHashMask].entries;
+
+  thread->pawnProbes++;
+  for (int i = 0; i < PAWN_BUCKET_SIZE; i++) {
+    if (bucket[i].hash == hash) {
+      thread->pawnHits++;
+      return &bucket[i];
+    }
+  }
+
+  return NULL;
 }
 
-inline void TTPawnPut(uint64_t hash, Score s, BitBoard passedPawns, ThreadData* thread) {
-  PawnHashEntry* entry = &thread->pawnHashTable[(hash & PAWN_TABLE_MASK)];
-  *entry = (PawnHashEntry){.hash = hash, .s = s, .passedPawns = passedPawns};
+// the older entry of the bucket is replaced
+inline PawnHashEntry* TTPawnPut(uint64_t hash, Score s, BitBoard passedPawns, ThreadData* thread) {
+  PawnHashEntry* bucket = thread->pawnHashTable[hash & thread->pawnHashMask].entries;
+
+  bucket[1] = bucket[0];
+  bucket[0] = (PawnHashEntry){
+      .hash = hash, .s = s, .passedPawns = passedPawns, .shelterKingSq = {NO_SHELTER, NO_SHELTER}};
+
+  return &bucket[0];
 }
 
 // Standard pawn and passer evaluation
@@ -19,8 +19,10 @@
 
 #include "types.h"
 
+extern int PAWN_HASH_MB;
+
 PawnHashEntry* TTPawnProbe(uint64_t hash, ThreadData* thread);
-void TTPawnPut(uint64_t hash, Score s, BitBoard passedPawns, ThreadData* thread);
+PawnHashEntry* TTPawnPut(uint64_t hash, Score s, BitBoard passedPawns, ThreadData* thread);
 
 Score PawnEval(Board* board, EvalData* data, int side);
 Score PasserEval(Board* board, EvalData* data, int side);
@@ -15,60 +15,121 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <inttypes.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "board.h"
 #include "move.h"
 #include "movegen.h"
-#include "movepick.h"
+#include "perft.h"
+#include "thread.h"
+#include "transposition.h"
 #include "types.h"
 #include "util.h"
 
+PerftEntry* perftTable = NULL;
+uint64_t perftMask = 0;
 
-SearchData PERFT_DUMMY_DATA = {0};
+// root moves are handed out to the pool one at a time
+Move perftMoves[MAX_MOVES];
+uint64_t perftCounts[MAX_MOVES];
+int perftMoveCount = 0;
+int perftDepth = 0;
+atomic_int perftNext;
 
-int Perft(int depth, Board* board) {
-  if (depth == 0)
+// The generator is fully legal, so the last ply is counted without being played
+uint64_t Perft(int depth, Board* board) {
+  if (depth <= 0)
     return 1;
 
-  Move move;
-  MoveList moves;
-  InitAllMoves(&moves, NULL_MOVE, &PERFT_DUMMY_DATA);
+  PerftEntry* entry = NULL;
+  if (perftTable && depth > 1) {
+    entry = &perftTable[board->zobrist & perftMask];
 
-  int nodes = 0;
+    PerftEntry e = *entry;
+    if ((e.key ^ e.data) == board->zobrist && (e.data & 0xFF) == (uint64_t)depth)
+      return e.data >> 8;
+  }
+
+  Move moves[MAX_MOVES];
+  int n = GenerateLegalMoves(moves, board);
+
+  if (depth == 1)
+    return n;
 
-  while ((move = NextMove(&moves, board, 0))) {
-    MakeMove(move, board);
+  uint64_t nodes = 0;
+
+  for (int i = 0; i < n; i++) {
+    MakeMove(moves[i], board);
     nodes += Perft(depth - 1, board);
-    UndoMove(move, board);
+    UndoMove(moves[i], board);
+  }
+
+  if (entry) {
+    uint64_t data = (nodes << 8) | depth;
+    *entry = (PerftEntry){.key = board->zobrist ^ data, .data = data};
   }
 
   return nodes;
 }
 
-void PerftTest(int depth, Board* board) {
-  int total = 0;
+void* PerftRoot(void* arg) {
+  ThreadData* thread = (ThreadData*)arg;
+  Board* board = &thread->board;
+
+  int i;
+  while ((i = atomic_fetch_add(&perftNext, 1)) < perftMoveCount) {
+    MakeMove(perftMoves[i], board);
+    perftCounts[i] = Perft(perftDepth - 1, board);
+    UndoMove(perftMoves[i], board);
+  }
+
+  return NULL;
+}
 
+// Root moves are split across the whole pool, hashMb > 0 adds
+// a shared perft hash of that size for the duration of the test
+void PerftTest(int depth, int hashMb, Board* board, ThreadData* threads) {
   printf("\nRunning performance test to depth %d\n\n", depth);
 
-  long startTime = GetTimeMS();
+  if (hashMb > 0) {
+    uint64_t size = 1ULL;
+    while (2 * size * sizeof(PerftEntry) <= hashMb * MEGABYTE)
+      size *= 2;
 
-  Move move;
-  MoveList moves;
-  InitAllMoves(&moves, NULL_MOVE, &PERFT_DUMMY_DATA);
+    perftTable = calloc(size, sizeof(PerftEntry));
+    perftMask = perftTable ? size - 1 : 0;
+  }
+
+  long startTime = GetTimeMS();
 
-  while ((move = NextMove(&moves, board, 0))) {
-    MakeMove(move, board);
-    int nodes = Perft(depth - 1, board);
-    UndoMove(move, board);
+  perftMoveCount = GenerateLegalMoves(perftMoves, board);
+  perftDepth = depth;
+  perftNext = 0;
 
-    printf("%s: %d\n", MoveToStr(move), nodes);
-    total += nodes;
+  for (int i = 0; i < threads->count; i++) {
+    ThreadWaitUntilSleep(&threads[i]);
+    threads[i].board = *board;
+    ThreadWake(&threads[i], PerftRoot);
   }
 
+  for (int i = 0; i < threads->count; i++)
+    ThreadWaitUntilSleep(&threads[i]);
+
   long endTime = GetTimeMS();
 
-  printf("\nNodes: %d\n", total);
+  uint64_t total = 0;
+  for (int i = 0; i < perftMoveCount; i++) {
+    printf("%s: %" PRIu64 "\n", MoveToStr(perftMoves[i]), perftCounts[i]);
+    total += perftCounts[i];
+  }
+
+  printf("\nNodes: %" PRIu64 "\n", total);
   printf("Time: %ldms\n", (endTime - startTime));
-  printf("NPS: %ld\n\n", total / max(1, (endTime - startTime)) * 1000);
+  printf("NPS: %" PRIu64 "\n\n", total * 1000 / max(1, (endTime - startTime)));
+
+  free(perftTable);
+  perftTable = NULL;
+  perftMask = 0;
 }
\ No newline at end of file
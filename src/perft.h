@@ -19,7 +19,13 @@
 
 #include "types.h"
 
-int Perft(int depth, Board* board);
-void PerftTest(int depth, Board* board);
+// Perft hash entry, key is the zobrist xor'd with data so torn writes fail to verify
+typedef struct {
+  uint64_t key;
+  uint64_t data; // nodes << 8 | depth
+} PerftEntry;
+
+uint64_t Perft(int depth, Board* board);
+void PerftTest(int depth, int hashMb, Board* board, ThreadData* threads);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,54 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <stdio.h>
+
+#include "profile.h"
+#include "util.h"
+
+const char* PROFILE_NAMES[PROFILE_PHASES] = {"Search",  "Tactical moves", "Quiet moves", "MakeMove",
+                                             "UndoMove", "SEE",            "Evaluate",    "TT probe"};
+
+// Cycle totals of every thread in the pool since it was created. Timer
+// overhead (~20 cycles a call) is included in each phase
+void PrintProfile(ThreadData* threads) {
+#ifdef PROFILE
+  ProfileData p = {0};
+
+  for (int i = 0; i < threads->count; i++) {
+    for (int j = 0; j < PROFILE_PHASES; j++) {
+      p.cycles[j] += threads[i].data.profile.cycles[j];
+      p.calls[j] += threads[i].data.profile.calls[j];
+    }
+  }
+
+  uint64_t other = p.cycles[PROFILE_SEARCH];
+  for (int j = PROFILE_SEARCH + 1; j < PROFILE_PHASES; j++)
+    other -= min(other, p.cycles[j]);
+
+  printf("Cycle breakdown over %d thread(s)\n", threads->count);
+  printf("%-16s %16s %8s %14s %10s\n", "Phase", "Cycles", "Share", "Calls", "Cyc/call");
+  for (int j = 0; j < PROFILE_PHASES; j++)
+    printf("%-16s %16" PRIu64 " %7.2f%% %14" PRIu64 " %10.1f\n", PROFILE_NAMES[j], p.cycles[j],
+           100.0 * p.cycles[j] / max(1, p.cycles[PROFILE_SEARCH]), p.calls[j],
+           (double)p.cycles[j] / max(1, p.calls[j]));
+  printf("%-16s %16" PRIu64 " %7.2f%%\n\n", "Other", other, 100.0 * other / max(1, p.cycles[PROFILE_SEARCH]));
+#else
+  (void)threads;
+  printf("info string profiling needs a PROFILE build (make profile)\n");
+#endif
+}
\ No newline at end of file
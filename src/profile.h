@@ -0,0 +1,53 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "types.h"
+
+// Scoped rdtsc timers of a PROFILE build (make profile), accumulated into the
+// SearchData of the thread that ran them. PROFILED wraps an expression and
+// yields its value, PROFILED_VOID wraps a statement. Both are the bare call otherwise
+#ifdef PROFILE
+#include <x86intrin.h>
+
+#define PROFILE_END(data, phase, start)                                                                                \
+  ((data)->profile.cycles[phase] += __rdtsc() - (start), (data)->profile.calls[phase]++)
+
+#define PROFILED(data, phase, expr)                                                                                    \
+  ({                                                                                                                   \
+    uint64_t profileStart = __rdtsc();                                                                                 \
+    __typeof__(expr) profileResult = (expr);                                                                           \
+    PROFILE_END(data, phase, profileStart);                                                                            \
+    profileResult;                                                                                                     \
+  })
+
+#define PROFILED_VOID(data, phase, stmt)                                                                               \
+  do {                                                                                                                 \
+    uint64_t profileStart = __rdtsc();                                                                                 \
+    stmt;                                                                                                              \
+    PROFILE_END(data, phase, profileStart);                                                                            \
+  } while (0)
+#else
+#define PROFILED(data, phase, expr) (expr)
+#define PROFILED_VOID(data, phase, stmt) stmt
+#endif
+
+void PrintProfile(ThreadData* threads);
+
+#endif
\ No newline at end of file
@@ -18,23 +18,30 @@
 #include <inttypes.h>
 #include <math.h>
 #include <pthread.h>
-#include <setjmp.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "bits.h"
 #include "board.h"
+#include "book.h"
+#include "cluster.h"
 #include "eval.h"
 #include "history.h"
 #include "move.h"
 #include "movegen.h"
 #include "movepick.h"
 #include "noobprobe/noobprobe.h"
+#include "output.h"
+#include "profile.h"
 #include "pyrrhic/tbprobe.h"
 #include "search.h"
 #include "see.h"
+#include "stats.h"
 #include "tb.h"
 #include "thread.h"
+#include "timeman.h"
 #include "transposition.h"
 #include "types.h"
 #include "util.h"
@@ -45,6 +52,13 @@ int LMP[2][MAX_SEARCH_PLY];
 int STATIC_PRUNE[2][MAX_SEARCH_PLY];
 int RFP[MAX_SEARCH_PLY];
 
+// number of threads currently in each iteration of the deepening loop,
+// helpers use this to avoid all piling onto the same depth
+atomic_int depthSearchers[MAX_SEARCH_PLY + 1];
+
+// number of best lines to report, see MultiPV
+int MULTI_PV = 1;
+
 void InitPruningAndReductionTables() {
   for (int depth = 1; depth < MAX_SEARCH_PLY; depth++)
     for (int moves = 1; moves < 64; moves++)
@@ -66,71 +80,284 @@ void InitPruningAndReductionTables() {
   }
 }
 
-void* UCISearch(void* arg) {
-  SearchArgs* args = (SearchArgs*)arg;
+#define Stopped(thread) ((thread)->params->stopped || (thread)->data.stopped)
+
+// Time is owned by the timer thread and the time manager, so searchers only read the stop flag.
+// A node budget only stops the thread that used it up
+inline int CheckStop(ThreadData* thread) {
+  SearchParams* params = thread->params;
+  SearchData* data = &thread->data;
+
+  if (params->nodes && data->nodes >= params->nodes)
+    data->stopped = 1;
+
+  return Stopped(thread);
+}
+
+// The timer lives as long as the process and parks between searches, so
+// a timed go starts no thread. It only touches the armed search under the lock
+pthread_mutex_t timerMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t timerWake = PTHREAD_COND_INITIALIZER;
+SearchParams* timerParams;
+int timerStarted;
+
+// Enforces the hard limit of a search, the soft limit is weighed by the
+// main thread between depths, see TMStop. A ponderhit moves the limit,
+// so a ponder search is looked at every ms
+void* TimerThread(void* arg) {
+  (void)arg;
+
+  pthread_mutex_lock(&timerMutex);
+  while (1) {
+    if (!timerParams) {
+      pthread_cond_wait(&timerWake, &timerMutex);
+      continue;
+    }
+
+    SearchParams* params = timerParams;
+    long left = params->ponder ? 1 : params->start + params->max - GetTimeMS();
+    if (left < 0) {
+      params->stopped = 1;
+      timerParams = NULL;
+      continue;
+    }
+
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += left / 1000;
+    until.tv_nsec += (left % 1000) * 1000000;
+    if (until.tv_nsec >= 1000000000) {
+      until.tv_sec++;
+      until.tv_nsec -= 1000000000;
+    }
+
+    pthread_cond_timedwait(&timerWake, &timerMutex, &until);
+  }
+
+  return NULL;
+}
+
+void TimerStart(SearchParams* params) {
+  pthread_mutex_lock(&timerMutex);
+
+  if (!timerStarted) {
+    pthread_t timer;
+    pthread_create(&timer, NULL, TimerThread, NULL);
+    pthread_detach(timer);
+    timerStarted = 1;
+  }
 
-  Board* board = args->board;
-  SearchParams* params = args->params;
-  ThreadData* threads = args->threads;
+  timerParams = params;
+  pthread_cond_signal(&timerWake);
+  pthread_mutex_unlock(&timerMutex);
+}
+
+// once this returns the timer has let go of the search
+void TimerStop() {
+  pthread_mutex_lock(&timerMutex);
+  timerParams = NULL;
+  pthread_cond_signal(&timerWake);
+  pthread_mutex_unlock(&timerMutex);
+}
+
+// job for the main pool thread, the root position has already been
+// copied into its board by the uci thread
+void* UCISearch(void* arg) {
+  ThreadData* thread = (ThreadData*)arg;
 
-  BestMove(board, params, threads);
+  BestMove(&thread->board, thread->params, thread->threads);
 
-  free(args);
   return NULL;
 }
 
 int BestMove(Board* board, SearchParams* params, ThreadData* threads) {
+  // books and tablebases know nothing of searchmoves, and a ponder search
+  // has to run until the opponent moves
+  int probe = !params->quiet && !params->numSearchMoves && !params->ponder;
+
   Move bestMove;
-  if ((bestMove = TBRootProbe(board))) {
-    printf("bestmove %s\n", MoveToStr(bestMove));
+  if (probe && (bestMove = BookProbe(board))) {
+    UCIPrintf("bestmove %s\n", MoveToStr(bestMove));
+    return 0;
+  }
+
+  if (probe && (bestMove = TBRootProbe(board))) {
+    UCIPrintf("bestmove %s\n", MoveToStr(bestMove));
     return 0;
   }
 
-  if ((bestMove = ProbeNoob(board))) {
-    printf("bestmove %s\n", MoveToStr(bestMove));
+  // a book move seen before is played at once, otherwise the query runs
+  // alongside the search and stops it when a move comes back. The caller
+  // has cleared the stop, a stop raised since (by an early answer, uci or
+  // the master of a cluster) is kept
+  if (probe && (bestMove = ProbeNoob(board, &params->stopped))) {
+    UCIPrintf("bestmove %s\n", MoveToStr(bestMove));
     return 0;
   }
 
-  pthread_t pthreads[threads->count];
   InitPool(board, params, threads);
 
-  params->stopped = 0;
-  TTUpdate();
+  int cluster = !params->quiet && CLUSTER.count && !CLUSTER.worker;
+  if (cluster) {
+    ClusterGo(board, params);
+
+    // the wait for the other nodes at the end comes out of this move's time
+    if (params->timeset) {
+      params->max = max(1, params->max - CLUSTER_RESULT_MS);
+      params->alloc = min(params->alloc, params->max);
+    }
+  }
+
+  if (!params->sharedTT)
+    TTUpdate();
+
+  for (int i = 0; i <= MAX_SEARCH_PLY; i++)
+    atomic_store_explicit(&depthSearchers[i], 0, memory_order_relaxed);
+
+  if (params->timeset)
+    TimerStart(params);
 
   // start at 1, we will resuse main-thread
   for (int i = 1; i < threads->count; i++)
-    pthread_create(&pthreads[i], NULL, &Search, &threads[i]);
+    ThreadWake(&threads[i], Search);
   Search(&threads[0]);
 
+  // a ponder search that ran out of depths holds its move until the opponent has moved
+  while (params->ponder && !params->stopped)
+    SleepMS(1);
+
   // if main thread stopped, then stop all and wait till complete
   params->stopped = 1;
   for (int i = 1; i < threads->count; i++)
-    pthread_join(pthreads[i], NULL);
+    ThreadWaitUntilSleep(&threads[i]);
 
-  // we accept the best move from the mainthread
-  bestMove = threads[0].data.bestMove;
-  int bestScore = threads[0].data.score;
+  if (params->timeset)
+    TimerStop();
 
-  printf("bestmove %s\n", MoveToStr(bestMove));
-  return bestScore;
+  if (cluster)
+    ClusterStop();
+
+  ThreadData* best = BestThread(threads);
+
+  if (params->quiet)
+    return best->data.score;
+
+  if ((bestMove = NoobResult())) {
+    UCIPrintf("bestmove %s\n", MoveToStr(bestMove));
+    return 0;
+  }
+
+  // the main thread has already reported its own pv
+  if ((cluster && ClusterVote(best)) || best != &threads[0])
+    PrintInfo(&best->pv, best->data.score, best->data.depth, 0, best);
+
+  // MoveToStr shares one buffer, the reply is copied out first
+  if (best->pv.count > 1 && best->pv.moves[0] == best->data.bestMove) {
+    char ponder[6];
+    strcpy(ponder, MoveToStr(best->pv.moves[1]));
+    UCIPrintf("bestmove %s ponder %s\n", MoveToStr(best->data.bestMove), ponder);
+  } else {
+    UCIPrintf("bestmove %s\n", MoveToStr(best->data.bestMove));
+  }
+
+  return best->data.score;
+}
+
+// Every thread votes for its best move, weighted by how far it got and
+// how good it thinks the move is. A proven mate always wins the vote
+ThreadData* BestThread(ThreadData* threads) {
+  ThreadData* best = &threads[0];
+  if (threads->count == 1)
+    return best;
+
+  int minScore = CHECKMATE;
+  for (int i = 0; i < threads->count; i++)
+    if (threads[i].data.depth)
+      minScore = min(minScore, threads[i].data.score);
+
+  int bestVotes = 0;
+  for (int i = 0; i < threads->count; i++) {
+    ThreadData* thread = &threads[i];
+    if (!thread->data.depth)
+      continue;
+
+    int votes = 0;
+    for (int j = 0; j < threads->count; j++)
+      if (threads[j].data.depth && threads[j].data.bestMove == thread->data.bestMove)
+        votes += (threads[j].data.score - minScore + 14) * threads[j].data.depth;
+
+    if (!best->data.depth) {
+      best = thread, bestVotes = votes;
+    } else if (abs(best->data.score) >= MATE_BOUND) {
+      if (thread->data.score > best->data.score)
+        best = thread, bestVotes = votes;
+    } else if (thread->data.score >= MATE_BOUND || votes > bestVotes ||
+               (votes == bestVotes && thread->data.depth > best->data.depth)) {
+      best = thread, bestVotes = votes;
+    }
+  }
+
+  return best;
 }
 
 void* Search(void* arg) {
   ThreadData* thread = (ThreadData*)arg;
   SearchParams* params = thread->params;
   SearchData* data = &thread->data;
-  PV* pv = &thread->pv;
+  PV searchPv, *pv = &searchPv;
   int mainThread = !thread->idx;
 
   int alpha = -CHECKMATE;
   int beta = CHECKMATE;
   int score = 0;
 
-  // set a hot exit point for this thread
-  if (!setjmp(thread->exit)) {
+  // allocated here, from the thread that will use it. Tables of earlier
+  // searches are aged rather than cleared, see AgeHistories
+  if (!data->hist) {
+    data->hist = AlignedMalloc(sizeof(HistoryTables));
+    memset(data->hist, 0, sizeof(HistoryTables));
+  } else {
+    AgeHistories(data);
+  }
+
+  ShiftKillers(data, thread->board.moveNo - data->killersMoveNo);
+  data->killersMoveNo = thread->board.moveNo;
+
+#ifdef PROFILE
+  uint64_t profileStart = __rdtsc();
+#endif
+
+  // no more lines than there are root moves
+  InitRootMoves(thread);
+  data->multiPV = max(1, min(MULTI_PV, thread->numRootMoves));
+  for (int i = 0; i < data->multiPV; i++)
+    data->pvScores[i] = 0;
+
+  // Iterative deepening
+  for (int depth = 1; depth <= params->depth; depth++) {
+    // helpers skip a depth that half the pool is already searching, the
+    // last depth is never skipped so that helpers are not left idle
+    if (!mainThread && depth > 1 && depth < params->depth &&
+        atomic_load_explicit(&depthSearchers[depth], memory_order_relaxed) >= max(1, thread->count / 2))
+      continue;
+
+    // every other node of a cluster leaves out its own third of the depths
+    if (params->clusterIdx && depth > 1 && depth < params->depth && (depth + params->clusterIdx) % 3 == 0)
+      continue;
+
+    atomic_fetch_add_explicit(&depthSearchers[depth], 1, memory_order_relaxed);
+
+    // sampled once an iteration, every report of it shares the figure
+    if (mainThread && !params->quiet)
+      data->hashfull = TTFull();
+
+    SortRootMoves(thread);
+
+    // each multipv line is searched with the moves of the lines above it
+    // skipped at the root, around its own score of the last depth
+    for (data->pvIdx = 0; data->pvIdx < data->multiPV; data->pvIdx++) {
+      score = data->pvScores[data->pvIdx];
 
-    // Iterative deepening
-    for (int depth = 1; depth <= params->depth; depth++) {
       // delta is our window for search. early depths get full searches
       // as we don't know what score to expect. Otherwise we start with a window of 16 (8x2), but
       // vary this slightly based on the previous depths window expansion count
@@ -140,12 +367,16 @@ void* Search(void* arg) {
       alpha = max(score - delta, -CHECKMATE);
       beta = min(score + delta, CHECKMATE);
 
-      while (!params->stopped) {
+      while (!Stopped(thread)) {
         // search!
         score = Negamax(alpha, beta, searchDepth, thread, pv);
 
-        if (mainThread && ((GetTimeMS() - 2500 >= params->start) || (score > alpha && score < beta)))
-          PrintInfo(pv, score, depth, thread);
+        if (Stopped(thread))
+          break;
+
+        if (mainThread && !params->quiet && data->multiPV == 1 &&
+            ((GetTimeMS() - 2500 >= params->start) || (score > alpha && score < beta)))
+          PrintInfo(pv, score, depth, 0, thread);
 
         if (score <= alpha) {
           // adjust beta downward when failing low
@@ -165,18 +396,60 @@ void* Search(void* arg) {
         delta += delta / 2;
       }
 
-      if (mainThread && depth >= 5 && params->timeset && abs(data->score - score) > WINDOW) {
-        if (data->score > score)
-          params->alloc *= fmin(1.16, 1.04 * ((data->score - score) / WINDOW));
-        else
-          params->alloc *= fmin(1.04, 1.02 * ((score - data->score) / WINDOW));
+      if (Stopped(thread))
+        break;
+
+      data->pvs[data->pvIdx] = *pv;
+      data->pvScores[data->pvIdx] = score;
+      PromoteRootMove(thread, pv->moves[0]);
+    }
+
+    atomic_fetch_sub_explicit(&depthSearchers[depth], 1, memory_order_relaxed);
+
+    // an interrupted iteration only has a pv if a fully searched root move
+    // raised alpha, in which case it is at least as good as the last best move.
+    // Only the first line has that guarantee
+    if (Stopped(thread)) {
+      if (!data->pvIdx && pv->count && data->depth) {
+        data->bestMove = pv->moves[0];
+        thread->pv = *pv;
       }
 
-      data->bestMove = pv->moves[0];
-      data->score = score;
+      break;
+    }
+
+    if (data->multiPV > 1) {
+      SortLines(data);
+      if (mainThread && !params->quiet)
+        PrintLines(depth, thread);
+    }
+
+    *pv = data->pvs[0];
+    score = data->pvScores[0];
+
+    data->bestMove = pv->moves[0];
+    data->score = score;
+    data->depth = depth;
+    thread->pv = *pv;
+
+    STAT_ADD(thread, depthNodes[depth], data->nodes);
+    STAT(thread, depthCount[depth]);
+
+    // the clock is not ours while pondering, the stop waits for ponderhit
+    if (mainThread && TMStop(thread)) {
+      if (!params->ponder)
+        break;
+
+      params->stopOnPonderhit = 1;
     }
   }
 
+  STAT_ADD(thread, nodes, data->nodes);
+
+#ifdef PROFILE
+  PROFILE_END(data, PROFILE_SEARCH, profileStart);
+#endif
+
   return NULL;
 }
 
@@ -208,16 +481,14 @@ int Negamax(int alpha, int beta, int depth, ThreadData* thread, PV* pv) {
   if (depth <= 0)
     return Quiesce(alpha, beta, thread, pv);
 
+  // Either mainthread has ended us, we've hit our node budget OR we've run out of time.
+  // Nodes unwind with a meaningless score, every caller checks for this before using it
+  if (CheckStop(thread))
+    return 0;
+
   data->nodes++;
   data->seldepth = max(data->ply, data->seldepth);
 
-  // Either mainthread has ended us OR we've run out of time
-  // this second check is more expensive and done only every 1024 nodes
-  // 1Mnps ~1ms
-  if (params->stopped ||
-      (!(data->nodes & 1023) && params->timeset && GetTimeMS() - params->start > min(params->alloc, params->max)))
-    longjmp(thread->exit, 1);
-
   if (!isRoot) {
     // draw
     if (IsRepetition(board, data->ply) || IsMaterialDraw(board) || (board->halfMove > 99))
@@ -225,7 +496,7 @@ int Negamax(int alpha, int beta, int depth, ThreadData* thread, PV* pv) {
 
     // Prevent overflows
     if (data->ply > MAX_SEARCH_PLY - 1)
-      return Evaluate(board, thread);
+      return PROFILED(data, PROFILE_EVAL, Evaluate(board, thread));
 
     // Mate distance pruning
     alpha = max(alpha, -CHECKMATE + data->ply);
@@ -236,10 +507,14 @@ int Negamax(int alpha, int beta, int depth, ThreadData* thread, PV* pv) {
 
   // check the transposition table for previous info
   // we ignore the tt on singular extension searches
-  int ttHit = 0;
-  TTEntry* tt = skipMove ? NULL : TTProbe(&ttHit, board->zobrist);
+  TTData ttData = {0}, *tt = &ttData;
+  int ttHit = skipMove ? 0 : PROFILED(data, PROFILE_TT_PROBE, TTProbe(board->zobrist, tt));
+  if (!skipMove)
+    STAT(thread, ttProbes);
+
   if (ttHit) {
-    hashMove = tt->move;
+    STAT(thread, ttHits);
+    hashMove = UnpackMove(tt->move, board);
     ttScore = TTScore(tt, data->ply);
   }
 
@@ -247,8 +522,10 @@ int Negamax(int alpha, int beta, int depth, ThreadData* thread, PV* pv) {
   // this score and prune
   if (!isPV && ttHit && tt->depth >= depth && ttScore != UNKNOWN) {
     if ((tt->flags & TT_EXACT) || ((tt->flags & TT_LOWER) && ttScore >= beta) ||
-        ((tt->flags & TT_UPPER) && ttScore <= alpha))
+        ((tt->flags & TT_UPPER) && ttScore <= alpha)) {
+      STAT(thread, ttCutoffs);
       return ttScore;
+    }
   }
 
   // tablebase - we do not do this at root
@@ -299,14 +576,19 @@ int Negamax(int alpha, int beta, int depth, ThreadData* thread, PV* pv) {
   // pull previous static eval from tt - this is depth independent
   int eval;
   if (!skipMove) {
-    eval = data->evals[data->ply] = board->checkers ? UNKNOWN : (ttHit ? tt->eval : Evaluate(board, thread));
+    eval = data->evals[data->ply] =
+        board->checkers
+            ? UNKNOWN
+            : (ttHit && tt->eval != UNKNOWN ? tt->eval : PROFILED(data, PROFILE_EVAL, Evaluate(board, thread)));
   } else {
     // after se, just used already determined eval
     eval = data->evals[data->ply];
   }
 
-  if (!ttHit)
-    TTPut(board->zobrist, INT8_MIN, UNKNOWN, TT_UNKNOWN, NULL_MOVE, data->ply, eval);
+  // pruning works from the eval corrected by how far off it has been for this
+  // pawn structure, the tt and the eval stack keep the raw one
+  if (eval != UNKNOWN)
+    eval += GetCorrection(data, board);
 
   // getting better if eval has gone up
   int improving = !board->checkers && data->ply >= 2 &&
@@ -326,8 +608,10 @@ int Negamax(int alpha, int beta, int depth, ThreadData* thread, PV* pv) {
 
     // Reverse Futility Pruning
     // i.e. the static eval is so far above beta we prune
-    if (depth <= 6 && !skipMove && eval - RFP[depth] >= beta && eval < MATE_BOUND)
+    if (depth <= 6 && !skipMove && eval - RFP[depth] >= beta && eval < MATE_BOUND) {
+      STAT(thread, rfpPrunes);
       return eval;
+    }
 
     // Null move pruning
     // i.e. Our position is so good we can give our opponnent a free move and
@@ -335,6 +619,7 @@ int Negamax(int alpha, int beta, int depth, ThreadData* thread, PV* pv) {
     if (depth >= 3 && data->moves[data->ply - 1] != NULL_MOVE && !skipMove && eval >= beta && HasNonPawn(board)) {
       int R = 4 + depth / 6 + min((eval - beta) / 256, 3);
       R = min(depth, R); // don't go too low
+      STAT(thread, nullTries);
 
       data->moves[data->ply++] = NULL_MOVE;
       MakeNullMove(board);
@@ -344,8 +629,13 @@ int Negamax(int alpha, int beta, int depth, ThreadData* thread, PV* pv) {
       UndoNullMove(board);
       data->ply--;
 
-      if (score >= beta)
+      if (Stopped(thread))
+        return 0;
+
+      if (score >= beta) {
+        STAT(thread, nullCutoffs);
         return beta;
+      }
 
       nullThreat = childPv.count ? childPv.moves[0] : NULL_MOVE;
     }
@@ -355,13 +645,15 @@ int Negamax(int alpha, int beta, int depth, ThreadData* thread, PV* pv) {
     // less than beta + margin, then we run a shallow search to look
     int probBeta = beta + 100;
     if (depth > 4 && abs(beta) < MATE_BOUND && !(ttHit && tt->depth >= depth - 3 && ttScore < probBeta)) {
+      STAT(thread, probcutTries);
+
       InitTacticalMoves(&moves, data, 0);
       while ((move = NextMove(&moves, board, 1))) {
         if (skipMove == move)
           continue;
 
         data->moves[data->ply++] = move;
-        MakeMove(move, board);
+        PROFILED_VOID(data, PROFILE_MAKE_MOVE, MakeMove(move, board));
 
         // qsearch to quickly check
         score = -Quiesce(-probBeta, -probBeta + 1, thread, pv);
@@ -370,20 +662,29 @@ int Negamax(int alpha, int beta, int depth, ThreadData* thread, PV* pv) {
         if (score >= probBeta)
           score = -Negamax(-probBeta, -probBeta + 1, depth - 4, thread, pv);
 
-        UndoMove(move, board);
+        PROFILED_VOID(data, PROFILE_UNDO_MOVE, UndoMove(move, board));
         data->ply--;
 
-        if (score >= probBeta)
+        if (Stopped(thread))
+          return 0;
+
+        if (score >= probBeta) {
+          STAT(thread, probcutCutoffs);
           return score;
+        }
       }
     }
   }
 
-  Move quiets[64];
-  int totalMoves = 0, nonPrunedMoves = 0, numQuiets = 0, skipQuiets = 0;
+  Move quiets[64], tacticals[32];
+  int totalMoves = 0, nonPrunedMoves = 0, numQuiets = 0, numTacticals = 0, skipQuiets = 0;
   InitAllMoves(&moves, hashMove, data);
 
-  while ((move = NextMove(&moves, board, skipQuiets))) {
+  // the root plays its own list, where the moves leading the multipv lines
+  // above the one being searched come first and are passed over
+  int rootIdx = data->pvIdx;
+
+  while ((move = isRoot ? NextRootMove(thread, &rootIdx, skipQuiets) : NextMove(&moves, board, skipQuiets))) {
     // don't search this during singular
     if (skipMove == move)
       continue;
@@ -399,23 +700,27 @@ int Negamax(int alpha, int beta, int depth, ThreadData* thread, PV* pv) {
       if (totalMoves >= LMP[improving][depth])
         skipQuiets = 1;
 
-      if (!tactical && !specialQuiet && depth < 3 && counterHist <= -8192)
+      if (!tactical && !specialQuiet && depth < 3 && counterHist <= -4096)
         continue;
 
-      if (tactical && moves.phase > PLAY_GOOD_TACTICAL && SEE(board, move) < STATIC_PRUNE[1][depth])
+      if (tactical && (isRoot || moves.phase > PLAY_GOOD_TACTICAL) &&
+          !PROFILED(data, PROFILE_SEE, SEE(board, move, STATIC_PRUNE[1][depth])))
         continue;
 
-      if (!tactical && SEE(board, move) < STATIC_PRUNE[0][depth])
+      if (!tactical && !PROFILED(data, PROFILE_SEE, SEE(board, move, STATIC_PRUNE[0][depth])))
         continue;
     }
 
     nonPrunedMoves++;
 
-    if (isRoot && !thread->idx && GetTimeMS() - params->start > 2500)
-      printf("info depth %d currmove %s currmovenumber %d\n", depth, MoveToStr(move), nonPrunedMoves);
+    if (isRoot && !thread->idx && !params->quiet && GetTimeMS() - params->start > 2500)
+      UCIUpdate(OUTPUT_CURRMOVE, "info depth %d currmove %s currmovenumber %d\n", depth, MoveToStr(move),
+                nonPrunedMoves);
 
     if (!tactical)
       quiets[numQuiets++] = move;
+    else if (numTacticals < 32)
+      tacticals[numTacticals++] = move;
 
     // singular extension
     // if one move is better than all the rest, then we consider this singular
@@ -423,23 +728,29 @@ int Negamax(int alpha, int beta, int depth, ThreadData* thread, PV* pv) {
     // moves at a shallow depth on a nullwindow that is somewhere below the tt evaluation
     // implemented using "skip move" recursion like in SF (allows for reductions when doing singular search)
     int extension = 0;
-    if (depth >= 8 && !skipMove && !isRoot && ttHit && move == tt->move && tt->depth >= depth - 3 &&
+    if (depth >= 8 && !skipMove && !isRoot && ttHit && move == hashMove && tt->depth >= depth - 3 &&
         abs(ttScore) < MATE_BOUND && (tt->flags & TT_LOWER)) {
       int sBeta = max(ttScore - 3 * depth / 2, -CHECKMATE);
       int sDepth = depth / 2 - 1;
+      STAT(thread, seTries);
 
       data->skipMove[data->ply] = move;
       score = Negamax(sBeta - 1, sBeta, sDepth, thread, pv);
       data->skipMove[data->ply] = NULL_MOVE;
 
+      if (Stopped(thread))
+        return 0;
+
       // no score failed above sBeta, so this is singular
-      if (score < sBeta)
+      if (score < sBeta) {
+        STAT(thread, seExtensions);
         extension = 1 + (!isPV && score < sBeta - 50);
+      }
     }
 
     // history extension - if the tt move has a really good history score, extend.
     // thank you to Connor, author of Seer for this idea
-    else if (!isRoot && depth >= 8 && ttHit && move == tt->move && hist >= 98304)
+    else if (!isRoot && depth >= 8 && ttHit && move == hashMove && hist >= 49152)
       extension = 1;
 
     // castle extensions
@@ -451,8 +762,14 @@ int Negamax(int alpha, int beta, int depth, ThreadData* thread, PV* pv) {
     else if (isPV && !isRoot && IsRecapture(data, move))
       extension = 1;
 
+    uint64_t startNodes = data->nodes;
+
     data->moves[data->ply++] = move;
-    MakeMove(move, board);
+    PROFILED_VOID(data, PROFILE_MAKE_MOVE, MakeMove(move, board));
+
+    // a capture into tablebase range is probed by the child, warm the wdl cache
+    if (MoveCapture(move) && bits(board->occupancies[BOTH]) <= TB_LARGEST)
+      TBPrefetch(board->zobrist);
 
     // apply extensions
     int newDepth = depth + max(extension, !!board->checkers);
@@ -477,7 +794,7 @@ int Negamax(int alpha, int beta, int depth, ThreadData* thread, PV* pv) {
           R++;
 
         // adjust reduction based on historical score
-        R -= hist / 24576;
+        R -= hist / 12288;
       } else {
         R--;
       }
@@ -492,17 +809,30 @@ int Negamax(int alpha, int beta, int depth, ThreadData* thread, PV* pv) {
     } else {
       // potentially reduced search
       score = -Negamax(-alpha - 1, -alpha, newDepth - R, thread, &childPv);
+      if (R != 1)
+        STAT(thread, lmrSearches);
 
-      if (score > alpha && R != 1) // failed high on a reducede search, try again
+      if (score > alpha && R != 1) { // failed high on a reducede search, try again
+        STAT(thread, lmrResearches);
         score = -Negamax(-alpha - 1, -alpha, newDepth - 1, thread, &childPv);
+      }
 
       if (score > alpha && (isRoot || score < beta)) // failed high again, do full window
         score = -Negamax(-beta, -alpha, newDepth - 1, thread, &childPv);
     }
 
-    UndoMove(move, board);
+    PROFILED_VOID(data, PROFILE_UNDO_MOVE, UndoMove(move, board));
     data->ply--;
 
+    if (isRoot) {
+      RootMove* root = &thread->rootMoves[rootIdx - 1];
+      root->nodes += data->nodes - startNodes;
+      root->score = score > alpha ? score : -CHECKMATE;
+    }
+
+    if (Stopped(thread))
+      return 0;
+
     if (score > bestScore) {
       bestScore = score;
       bestMove = move;
@@ -518,7 +848,11 @@ int Negamax(int alpha, int beta, int depth, ThreadData* thread, PV* pv) {
 
       // we're failing high
       if (alpha >= beta) {
-        UpdateHistories(data, move, depth, board->side, quiets, numQuiets);
+        STAT(thread, failHighs);
+        if (nonPrunedMoves == 1)
+          STAT(thread, firstMoveFailHighs);
+
+        UpdateHistories(data, board, move, depth, quiets, numQuiets, tacticals, numTacticals);
         break;
       }
     }
@@ -531,46 +865,55 @@ int Negamax(int alpha, int beta, int depth, ThreadData* thread, PV* pv) {
   // don't let our score inflate too high (tb)
   bestScore = min(bestScore, maxScore);
 
-  // prevent saving when in singular search
-  if (!skipMove) {
+  // learn the eval error from scores that are not just a bound on the wrong
+  // side of the eval, tactical best moves say little about the eval
+  if (!skipMove && !board->checkers && !(bestMove && Tactical(bestMove)) && abs(bestScore) < TB_WIN_BOUND &&
+      !(bestScore >= beta && bestScore <= data->evals[data->ply]) &&
+      !(bestScore <= origAlpha && bestScore >= data->evals[data->ply]))
+    UpdateCorrection(data, board, depth, bestScore - data->evals[data->ply]);
+
+  // prevent saving when in singular search, or a root that skipped the best moves
+  if (!skipMove && !(isRoot && data->pvIdx)) {
     // save to the TT
     // TT_LOWER = we failed high, TT_UPPER = we didnt raise alpha, TT_EXACT = in
     int TTFlag = bestScore >= beta ? TT_LOWER : bestScore <= origAlpha ? TT_UPPER : TT_EXACT;
     TTPut(board->zobrist, depth, bestScore, TTFlag, bestMove, data->ply, data->evals[data->ply]);
+
+    if (CLUSTER.count && depth >= CLUSTER_TT_DEPTH)
+      ClusterShare(board->zobrist, depth, bestScore, TTFlag, bestMove, data->ply, data->evals[data->ply]);
   }
 
   return bestScore;
 }
 
 int Quiesce(int alpha, int beta, ThreadData* thread, PV* pv) {
-  SearchParams* params = thread->params;
   SearchData* data = &thread->data;
   Board* board = &thread->board;
 
   PV childPv;
   pv->count = 0;
 
+  // Either mainthread has ended us, we've hit our node budget OR we've run out of time.
+  // Nodes unwind with a meaningless score, every caller checks for this before using it
+  if (CheckStop(thread))
+    return 0;
+
   data->nodes++;
+  thread->qsNodes++;
   data->seldepth = max(data->ply, data->seldepth);
 
-  // Either mainthread has ended us OR we've run out of time
-  // this second check is more expensive and done only every 1024 nodes
-  // 1Mnps ~1ms
-  if (params->stopped ||
-      (!(data->nodes & 1023) && params->timeset && GetTimeMS() - params->start > min(params->alloc, params->max)))
-    longjmp(thread->exit, 1);
-
   // draw check
   if (IsMaterialDraw(board) || IsRepetition(board, data->ply) || (board->halfMove > 99))
     return 0;
 
   // prevent overflows
   if (data->ply > MAX_SEARCH_PLY - 1)
-    return Evaluate(board, thread);
+    return PROFILED(data, PROFILE_EVAL, Evaluate(board, thread));
 
   // check the transposition table for previous info
-  int ttHit = 0, ttScore = UNKNOWN;
-  TTEntry* tt = TTProbe(&ttHit, board->zobrist);
+  int ttScore = UNKNOWN;
+  TTData ttData = {0}, *tt = &ttData;
+  int ttHit = PROFILED(data, PROFILE_TT_PROBE, TTProbe(board->zobrist, tt));
   // TT score pruning - no depth check required since everything in QS is depth 0
   if (ttHit) {
     ttScore = TTScore(tt, data->ply);
@@ -584,10 +927,15 @@ int Quiesce(int alpha, int beta, ThreadData* thread, PV* pv) {
   int origAlpha = alpha;
   int bestScore = -CHECKMATE + data->ply;
 
-  // pull cached eval if it exists
-  int eval = data->evals[data->ply] = board->checkers ? UNKNOWN : (ttHit ? tt->eval : Evaluate(board, thread));
-  if (!ttHit)
-    TTPut(board->zobrist, INT8_MIN, UNKNOWN, TT_UNKNOWN, NULL_MOVE, data->ply, eval);
+  // pull cached eval if it exists, a lazy one only holds for this window
+  // and is kept out of the tt
+  int eval = UNKNOWN, lazy = 0;
+  if (!board->checkers)
+    eval = ttHit && tt->eval != UNKNOWN
+               ? tt->eval
+               : PROFILED(data, PROFILE_EVAL, EvaluateLazy(board, thread, alpha, beta, &lazy));
+  data->evals[data->ply] = eval;
+  int ttEval = lazy ? UNKNOWN : eval;
 
   // can we use an improved evaluation from the tt?
   if (ttHit && ttScore != UNKNOWN) {
@@ -617,13 +965,16 @@ int Quiesce(int alpha, int beta, ThreadData* thread, PV* pv) {
       break;
 
     data->moves[data->ply++] = move;
-    MakeMove(move, board);
+    PROFILED_VOID(data, PROFILE_MAKE_MOVE, MakeMove(move, board));
 
     int score = -Quiesce(-beta, -alpha, thread, &childPv);
 
-    UndoMove(move, board);
+    PROFILED_VOID(data, PROFILE_UNDO_MOVE, UndoMove(move, board));
     data->ply--;
 
+    if (Stopped(thread))
+      return 0;
+
     if (score > bestScore) {
       bestScore = score;
       bestMove = move;
@@ -644,44 +995,148 @@ int Quiesce(int alpha, int beta, ThreadData* thread, PV* pv) {
   }
 
   int TTFlag = bestScore >= beta ? TT_LOWER : bestScore <= origAlpha ? TT_UPPER : TT_EXACT;
-  TTPut(board->zobrist, 0, bestScore, TTFlag, bestMove, data->ply, data->evals[data->ply]);
+  TTPut(board->zobrist, 0, bestScore, TTFlag, bestMove, data->ply, ttEval);
 
   return bestScore;
 }
 
-inline void PrintInfo(PV* pv, int score, int depth, ThreadData* thread) {
+// Legal moves at the root, limited to "searchmoves" when they were given.
+// Nothing is known about them yet, so the hash move is tried first
+void InitRootMoves(ThreadData* thread) {
+  Board* board = &thread->board;
+  SearchParams* params = thread->params;
+
+  Move legal[MAX_MOVES];
+  int n = GenerateLegalMoves(legal, board);
+
+  TTData tt;
+  Move hashMove = TTProbe(board->zobrist, &tt) ? UnpackMove(tt.move, board) : NULL_MOVE;
+
+  thread->numRootMoves = 0;
+  for (int i = 0; i < n; i++) {
+    int allowed = !params->numSearchMoves;
+    for (int j = 0; j < params->numSearchMoves && !allowed; j++)
+      allowed = params->searchMoves[j] == legal[i];
+
+    if (!allowed)
+      continue;
+
+    RootMove* root = &thread->rootMoves[thread->numRootMoves++];
+    root->move = legal[i];
+    root->score = legal[i] == hashMove ? 0 : -CHECKMATE;
+    root->nodes = 0;
+  }
+}
+
+// Best scores of the last iteration first, this keeps the multipv lines in
+// order. Moves that never raised alpha follow by the effort they took to refute,
+// as the hardest to refute are the most likely to become best
+void SortRootMoves(ThreadData* thread) {
+  RootMove* moves = thread->rootMoves;
+
+  for (int i = 1; i < thread->numRootMoves; i++) {
+    RootMove curr = moves[i];
+
+    int j = i - 1;
+    for (; j >= 0 && (moves[j].score < curr.score || (moves[j].score == curr.score && moves[j].nodes < curr.nodes));
+         j--)
+      moves[j + 1] = moves[j];
+
+    moves[j + 1] = curr;
+  }
+
+  for (int i = 0; i < thread->numRootMoves; i++)
+    moves[i].score = -CHECKMATE, moves[i].nodes = 0;
+}
+
+// move the best move of the current multipv line up behind the lines above it,
+// so the searches of the lines below pass over it
+void PromoteRootMove(ThreadData* thread, Move move) {
+  RootMove* moves = thread->rootMoves;
+  int idx = thread->data.pvIdx;
+
+  for (int i = idx; i < thread->numRootMoves; i++) {
+    if (moves[i].move != move)
+      continue;
+
+    RootMove best = moves[i];
+    memmove(&moves[idx + 1], &moves[idx], (i - idx) * sizeof(RootMove));
+    moves[idx] = best;
+    return;
+  }
+}
+
+inline Move NextRootMove(ThreadData* thread, int* idx, int skipQuiets) {
+  while (*idx < thread->numRootMoves) {
+    Move move = thread->rootMoves[(*idx)++].move;
+
+    if (!skipQuiets || Tactical(move))
+      return move;
+  }
+
+  return NULL_MOVE;
+}
+
+// a later line can come back better than one above it, keep them ordered
+void SortLines(SearchData* data) {
+  for (int i = 1; i < data->multiPV; i++) {
+    for (int j = i; j > 0 && data->pvScores[j] > data->pvScores[j - 1]; j--) {
+      int score = data->pvScores[j];
+      data->pvScores[j] = data->pvScores[j - 1];
+      data->pvScores[j - 1] = score;
+
+      PV pv = data->pvs[j];
+      data->pvs[j] = data->pvs[j - 1];
+      data->pvs[j - 1] = pv;
+    }
+  }
+}
+
+void PrintLines(int depth, ThreadData* thread) {
+  for (int i = 0; i < thread->data.multiPV; i++)
+    PrintInfo(&thread->data.pvs[i], thread->data.pvScores[i], depth, i + 1, thread);
+}
+
+// line is the multipv rank of the pv, 0 when not in multipv mode
+inline void PrintInfo(PV* pv, int score, int depth, int line, ThreadData* thread) {
   uint64_t nodes = NodesSearched(thread->threads);
   uint64_t tbhits = TBHits(thread->threads);
   uint64_t time = GetTimeMS() - thread->params->start;
   uint64_t nps = 1000 * nodes / max(time, 1);
-  int hashfull = TTFull();
+  int hashfull = thread->threads->data.hashfull;
+
+  char multiPV[16] = "";
+  if (line)
+    sprintf(multiPV, "multipv %d ", line);
 
+  char scoreStr[24];
   if (score > MATE_BOUND) {
     int movesToMate = (CHECKMATE - score) / 2 + ((CHECKMATE - score) & 1);
-
-    printf("info depth %d seldepth %d score mate %d time %" PRId64 " nodes %" PRId64 " nps %" PRId64 " tbhits %" PRId64
-           " hashfull %d pv ",
-           depth, thread->data.seldepth, movesToMate, time, nodes, nps, tbhits, hashfull);
+    sprintf(scoreStr, "mate %d", movesToMate);
   } else if (score < -MATE_BOUND) {
     int movesToMate = (CHECKMATE + score) / 2 - ((CHECKMATE - score) & 1);
-
-    printf("info depth %d seldepth %d score mate -%d time %" PRId64 " nodes %" PRId64 " nps %" PRId64 " tbhits %" PRId64
-           " hashfull %d pv ",
-           depth, thread->data.seldepth, movesToMate, time, nodes, nps, tbhits, hashfull);
+    sprintf(scoreStr, "mate -%d", movesToMate);
   } else {
-    printf("info depth %d seldepth %d score cp %d time %" PRId64 " nodes %" PRId64 " nps %" PRId64 " tbhits %" PRId64
-           " hashfull %d pv ",
-           depth, thread->data.seldepth, score, time, nodes, nps, tbhits, hashfull);
+    sprintf(scoreStr, "cp %d", score);
   }
 
+  char pvStr[OUTPUT_LINE / 2];
   if (pv->count)
-    PrintPV(pv);
+    PVToStr(pvStr, pv);
   else
-    printf("%s\n", MoveToStr(pv->moves[0]));
+    strcpy(pvStr, MoveToStr(pv->moves[0]));
+
+  // each multipv line is coalesced on its own
+  UCIUpdate(OUTPUT_INFO + line,
+            "info depth %d seldepth %d %sscore %s time %" PRId64 " nodes %" PRId64 " nps %" PRId64 " tbhits %" PRId64
+            " hashfull %d pv %s\n",
+            depth, thread->data.seldepth, multiPV, scoreStr, time, nodes, nps, tbhits, hashfull, pvStr);
 }
 
-void PrintPV(PV* pv) {
-  for (int i = 0; i < pv->count; i++)
-    printf("%s ", MoveToStr(pv->moves[i]));
-  printf("\n");
+void PVToStr(char* buffer, PV* pv) {
+  buffer[0] = '\0';
+  for (int i = 0; i < pv->count; i++) {
+    strcat(buffer, MoveToStr(pv->moves[i]));
+    strcat(buffer, " ");
+  }
 }
\ No newline at end of file
@@ -42,15 +42,28 @@
 // base window value
 #define WINDOW 8
 
+extern int MULTI_PV;
+
 void InitPruningAndReductionTables();
 
+void* TimerThread(void* arg);
+void TimerStart(SearchParams* params);
+void TimerStop();
 void* UCISearch(void* arg);
 int BestMove(Board* board, SearchParams* params, ThreadData* threads);
+ThreadData* BestThread(ThreadData* threads);
+int CheckStop(ThreadData* thread);
 void* Search(void* arg);
 int Negamax(int alpha, int beta, int depth, ThreadData* thread, PV* pv);
 int Quiesce(int alpha, int beta, ThreadData* thread, PV* pv);
 
-void PrintInfo(PV* pv, int score, int depth, ThreadData* thread);
-void PrintPV(PV* pv);
+void InitRootMoves(ThreadData* thread);
+void SortRootMoves(ThreadData* thread);
+void PromoteRootMove(ThreadData* thread, Move move);
+Move NextRootMove(ThreadData* thread, int* idx, int skipQuiets);
+void SortLines(SearchData* data);
+void PrintLines(int depth, ThreadData* thread);
+void PrintInfo(PV* pv, int score, int depth, int line, ThreadData* thread);
+void PVToStr(char* buffer, PV* pv);
 
 #endif
@@ -24,79 +24,73 @@
 #include "types.h"
 #include "util.h"
 
-// Static exchange evaluation using The Swap Algorithm - https://www.chessprogramming.org/SEE_-_The_Swap_Algorithm
-inline int SEE(Board* board, Move move) {
+// which sliders a capturer can uncover behind it, by piece type. Indexed
+// rather than tested so that the x-ray update of a capture does not branch
+const BitBoard XRAY_DIAGONAL[6] = {-1ULL, 0, -1ULL, 0, -1ULL, 0};
+const BitBoard XRAY_STRAIGHT[6] = {0, 0, 0, -1ULL, -1ULL, 0};
+
+// Static exchange evaluation, does the exchange started by move win at least
+// threshold. This is The Swap Algorithm without the swap list, the balance of
+// the exchange is held against the threshold and the exchange stops as soon
+// as the side to recapture can no longer change the answer.
+// https://www.chessprogramming.org/SEE_-_The_Swap_Algorithm
+inline int SEE(Board* board, Move move, int threshold) {
   if (MoveCastle(move) || (!MoveCapture(move) && PIECE_TYPE[MovePiece(move)] == KING_TYPE))
-    return 0;
-
-  BitBoard occupied = board->occupancies[BOTH];
-  int side = board->side;
-
-  int gain[32];
-  int captureCount = 1;
+    return 0 >= threshold;
 
   int start = MoveStart(move);
   int end = MoveEnd(move);
+  int type = PIECE_TYPE[MovePiece(move)];
 
-  BitBoard attackers = AttacksToSquare(board, end, board->occupancies[BOTH]);
-  int attackedPieceVal = MoveEP(move) ? STATIC_MATERIAL_VALUE[PAWN_TYPE]
-                                      : STATIC_MATERIAL_VALUE[PIECE_TYPE[board->squares[MoveEnd(move)]]];
-  popBit(occupied, start);
-  if (MoveEP(move))
-    popBit(occupied, end - PAWN_DIRECTIONS[side]);
+  // not enough even if the capture stands
+  int swap = STATIC_MATERIAL_VALUE[MoveEP(move) ? PAWN_TYPE : PIECE_TYPE[board->squares[end]]] - threshold;
+  if (swap < 0)
+    return 0;
 
-  side ^= 1;
-  gain[0] = attackedPieceVal;
+  // still enough when the capturer is lost for nothing
+  swap = STATIC_MATERIAL_VALUE[type] - swap;
+  if (swap <= 0)
+    return 1;
 
-  int piece = MovePiece(move);
-  attackedPieceVal = STATIC_MATERIAL_VALUE[PIECE_TYPE[piece]];
+  BitBoard diagonal = board->pieces[BISHOP[WHITE]] | board->pieces[BISHOP[BLACK]] | board->pieces[QUEEN[WHITE]] |
+                      board->pieces[QUEEN[BLACK]];
+  BitBoard straight = board->pieces[ROOK[WHITE]] | board->pieces[ROOK[BLACK]] | board->pieces[QUEEN[WHITE]] |
+                      board->pieces[QUEEN[BLACK]];
 
-  // Recalculate attacks if xray now open
-  if (PIECE_TYPE[piece] == PAWN_TYPE || PIECE_TYPE[piece] == BISHOP_TYPE || PIECE_TYPE[piece] == QUEEN_TYPE)
-    attackers |= GetBishopAttacks(end, occupied) & (board->pieces[BISHOP[WHITE]] | board->pieces[BISHOP[BLACK]] |
-                                                    board->pieces[QUEEN[WHITE]] | board->pieces[QUEEN[BLACK]]);
+  BitBoard occupied = board->occupancies[BOTH];
+  BitBoard attackers = AttacksToSquare(board, end, occupied);
 
-  // Recalculate attacks if xray now open
-  if (PIECE_TYPE[piece] == ROOK_TYPE || PIECE_TYPE[piece] == QUEEN_TYPE)
-    attackers |= GetRookAttacks(end, occupied) & (board->pieces[ROOK[WHITE]] | board->pieces[ROOK[BLACK]] |
-                                                  board->pieces[QUEEN[WHITE]] | board->pieces[QUEEN[BLACK]]);
+  popBit(occupied, start);
+  if (MoveEP(move))
+    popBit(occupied, end - PAWN_DIRECTIONS[board->side]);
 
-  BitBoard attackee = 0;
-  attackers &= occupied;
+  int side = board->side;
+  int result = 1; // for the side that made the last capture
 
-  while (attackers) {
-    for (piece = PAWN[side]; piece <= KING[side]; piece += 2)
-      if ((attackee = board->pieces[piece] & attackers))
-        break;
+  while (1) {
+    attackers |= (GetBishopAttacks(end, occupied) & diagonal & XRAY_DIAGONAL[type]) |
+                 (GetRookAttacks(end, occupied) & straight & XRAY_STRAIGHT[type]);
+    attackers &= occupied;
 
-    if (piece > KING[BLACK])
+    side ^= 1;
+    BitBoard ours = attackers & board->occupancies[side];
+    if (!ours)
       break;
 
-    occupied ^= (attackee & -attackee);
-
-    // Recalculate attacks if xray now open
-    if (PIECE_TYPE[piece] == PAWN_TYPE || PIECE_TYPE[piece] == BISHOP_TYPE || PIECE_TYPE[piece] == QUEEN_TYPE)
-      attackers |= GetBishopAttacks(end, occupied) & (board->pieces[BISHOP[WHITE]] | board->pieces[BISHOP[BLACK]] |
-                                                      board->pieces[QUEEN[WHITE]] | board->pieces[QUEEN[BLACK]]);
+    // recapture with the least valuable attacker, which only pays off if
+    // it also holds up when that attacker is lost in turn
+    int piece = PAWN[side];
+    while (!(board->pieces[piece] & ours))
+      piece += 2;
 
-    // Recalculate attacks if xray now open
-    if (PIECE_TYPE[piece] == ROOK_TYPE || PIECE_TYPE[piece] == QUEEN_TYPE)
-      attackers |= GetRookAttacks(end, occupied) & (board->pieces[ROOK[WHITE]] | board->pieces[ROOK[BLACK]] |
-                                                    board->pieces[QUEEN[WHITE]] | board->pieces[QUEEN[BLACK]]);
+    result ^= 1;
+    type = PIECE_TYPE[piece];
 
-    gain[captureCount] = -gain[captureCount - 1] + attackedPieceVal;
-    attackedPieceVal = STATIC_MATERIAL_VALUE[PIECE_TYPE[piece]];
-
-    // Stand pat if the capture is not good
-    if (gain[captureCount++] - attackedPieceVal > 0)
+    if ((swap = STATIC_MATERIAL_VALUE[type] - swap) < result)
       break;
 
-    side ^= 1;
-    attackers &= occupied;
+    occupied ^= board->pieces[piece] & ours & -(board->pieces[piece] & ours);
   }
 
-  while (--captureCount)
-    gain[captureCount - 1] = -max(-gain[captureCount - 1], gain[captureCount]);
-
-  return gain[0];
-}
+  return result;
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "stats.h"
+#include "util.h"
+
+#define PCT(a, b) (100.0 * (a) / max(1, (b)))
+
+// Totals of every thread in the pool since it was created
+void PrintStats(ThreadData* threads) {
+#ifdef STATS
+  SearchStats s;
+  memset(&s, 0, sizeof(SearchStats));
+
+  uint64_t qsNodes = 0;
+  for (int i = 0; i < threads->count; i++) {
+    SearchStats* t = &threads[i].stats;
+    uint64_t* dest = (uint64_t*)&s;
+    uint64_t* src = (uint64_t*)t;
+
+    for (size_t j = 0; j < sizeof(SearchStats) / sizeof(uint64_t); j++)
+      dest[j] += src[j];
+
+    qsNodes += threads[i].qsNodes;
+  }
+
+  printf("Search statistics over %d thread(s)\n", threads->count);
+  printf("Nodes:       %14" PRIu64 " total %8.2f%% quiescence\n", s.nodes, PCT(qsNodes, s.nodes));
+  printf("TT:          %14" PRIu64 " probes %7.2f%% hits %7.2f%% cutoffs\n", s.ttProbes, PCT(s.ttHits, s.ttProbes),
+         PCT(s.ttCutoffs, s.ttProbes));
+  printf("Fail highs:  %14" PRIu64 " total %8.2f%% first move\n", s.failHighs, PCT(s.firstMoveFailHighs, s.failHighs));
+  printf("RFP:         %14" PRIu64 " prunes\n", s.rfpPrunes);
+  printf("Null move:   %14" PRIu64 " tries %8.2f%% cutoffs\n", s.nullTries, PCT(s.nullCutoffs, s.nullTries));
+  printf("Probcut:     %14" PRIu64 " tries %8.2f%% cutoffs\n", s.probcutTries, PCT(s.probcutCutoffs, s.probcutTries));
+  printf("Singular:    %14" PRIu64 " tries %8.2f%% extended\n", s.seTries, PCT(s.seExtensions, s.seTries));
+  printf("LMR:         %14" PRIu64 " reduced %6.2f%% re-searched\n", s.lmrSearches,
+         PCT(s.lmrResearches, s.lmrSearches));
+
+  // effective branching factor, the growth in nodes from one depth to the next
+  printf("Depth  Searches      Avg nodes    EBF\n");
+  for (int d = 1; d <= MAX_SEARCH_PLY; d++) {
+    if (!s.depthCount[d])
+      continue;
+
+    double avg = (double)s.depthNodes[d] / s.depthCount[d];
+    double prev = s.depthCount[d - 1] ? (double)s.depthNodes[d - 1] / s.depthCount[d - 1] : 0;
+
+    if (prev > 0)
+      printf("%5d %9" PRIu64 " %14.0f %6.2f\n", d, s.depthCount[d], avg, avg / prev);
+    else
+      printf("%5d %9" PRIu64 " %14.0f %6s\n", d, s.depthCount[d], avg, "-");
+  }
+  printf("\n");
+#else
+  (void)threads;
+  printf("info string search statistics need a STATS build (make stats)\n");
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef STATS_H
+#define STATS_H
+
+#include "types.h"
+
+// Counters only exist in a STATS build (make stats), elsewhere these compile
+// to nothing. Each thread counts into its own stats, so no atomics are needed
+#ifdef STATS
+#define STAT(thread, counter) ((thread)->stats.counter++)
+#define STAT_ADD(thread, counter, n) ((thread)->stats.counter += (n))
+#else
+#define STAT(thread, counter) ((void)0)
+#define STAT_ADD(thread, counter, n) ((void)0)
+#endif
+
+void PrintStats(ThreadData* threads);
+
+#endif
\ No newline at end of file
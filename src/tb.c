@@ -14,17 +14,244 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <inttypes.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "board.h"
 #include "move.h"
 #include "pyrrhic/tbprobe.h"
 #include "tb.h"
-
+#include "transposition.h"
+#include "util.h"
 
 #define vf(bb) __builtin_bswap64((bb))
 
+// size of the wdl cache shared by all threads, 0 disables it
+int TB_CACHE_MB = 4;
+
+// WDL results in front of the tables, a cold probe can mean a disk read.
+// Each entry is a single word of (key & ~7) | (result + 1), so that entries
+// are written and read lock free and a torn entry can never verify.
+// Probes that failed (missing tables) are cached too
+uint64_t* tbCache = NULL;
+uint64_t tbCacheMask = 0;
+
+void TBCacheInit(int mb) {
+  AlignedFree(tbCache);
+  tbCache = NULL;
+  tbCacheMask = 0;
+
+  if (mb <= 0)
+    return;
+
+  // largest power of two entries that fits
+  uint64_t entries = 1;
+  while (2 * entries * sizeof(uint64_t) <= (uint64_t)mb * MEGABYTE)
+    entries *= 2;
+
+  tbCache = AlignedMalloc(entries * sizeof(uint64_t));
+  tbCacheMask = entries - 1;
+  TBCacheClear();
+}
+
+// results depend on the tables found, so this follows every tb_init
+void TBCacheClear() {
+  if (tbCache)
+    memset(tbCache, 0, (tbCacheMask + 1) * sizeof(uint64_t));
+}
+
+inline void TBPrefetch(uint64_t hash) {
+  if (tbCache)
+    __builtin_prefetch(&tbCache[hash & tbCacheMask]);
+}
+
+// tables of at most this many pieces are read into memory once a path is set, 0 disables
+int TB_PRELOAD = 0;
+
+#if defined(__linux__)
+#define TB_PRELOAD_THREADS 4
+
+typedef struct {
+  char* file;
+  size_t size;
+  void* data;
+  int locked, huge;
+} PreloadedTable;
+
+char* preloadPath = NULL;
+PreloadedTable* preloaded = NULL;
+int preloadCount = 0;
+atomic_int preloadNext, preloadDone, preloadStop;
+atomic_uint_fast64_t preloadBytes;
+pthread_t preloadThreads[TB_PRELOAD_THREADS];
+int preloadThreadCount = 0;
+
+// KRvKP.rtbw has 5 pieces
+int TableFilePieces(const char* name) {
+  const char* ext = strrchr(name, '.');
+  if (!ext || (strcmp(ext, ".rtbw") && strcmp(ext, ".rtbz")))
+    return 0;
+
+  int pieces = 0;
+  for (const char* c = name; c < ext; c++)
+    pieces += *c != 'v';
+
+  return pieces;
+}
+
+// Maps a table and keeps its page cache pages resident, locked when the
+// memlock limit allows and touched otherwise. Pyrrhic maps the same file
+// when it first probes the table, which then never has to go to disk
+void PreloadTable(PreloadedTable* table) {
+  int fd = open(table->file, O_RDONLY);
+  if (fd < 0)
+    return;
+
+  struct stat st;
+  if (fstat(fd, &st) || !st.st_size) {
+    close(fd);
+    return;
+  }
+
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return;
+
+  table->data = data;
+  table->size = st.st_size;
+  table->huge = !madvise(data, st.st_size, MADV_HUGEPAGE);
+  madvise(data, st.st_size, MADV_WILLNEED);
+
+  table->locked = !mlock(data, st.st_size);
+  if (!table->locked) {
+    volatile uint8_t sink = 0;
+    for (size_t i = 0; i < table->size && !atomic_load(&preloadStop); i += 4096)
+      sink += ((uint8_t*)data)[i];
+    (void)sink;
+  }
+
+  atomic_fetch_add(&preloadBytes, table->size);
+}
+
+void* PreloadWorker(void* arg) {
+  (void)arg;
+
+  int i;
+  while (!atomic_load(&preloadStop) && (i = atomic_fetch_add(&preloadNext, 1)) < preloadCount) {
+    PreloadTable(&preloaded[i]);
+
+    int done = atomic_fetch_add(&preloadDone, 1) + 1;
+    uint64_t mb = atomic_load(&preloadBytes) / MEGABYTE;
+    if (done == preloadCount) {
+      int locked = 0, huge = 0;
+      for (int j = 0; j < preloadCount; j++)
+        locked += preloaded[j].locked, huge += preloaded[j].huge;
+
+      printf("info string Syzygy preload done: %d files, %" PRIu64 " MB resident, %d locked, "
+             "%d with huge pages advised\n",
+             preloadCount, mb, locked, huge);
+    } else if (done % max(1, preloadCount / 10) == 0) {
+      printf("info string Syzygy preload %d/%d files, %" PRIu64 " MB\n", done, preloadCount, mb);
+    }
+  }
+
+  return NULL;
+}
+
+// stops a running preload and releases what it holds
+void TBPreloadStop() {
+  atomic_store(&preloadStop, 1);
+  for (int i = 0; i < preloadThreadCount; i++)
+    pthread_join(preloadThreads[i], NULL);
+  preloadThreadCount = 0;
+
+  for (int i = 0; i < preloadCount; i++) {
+    if (preloaded[i].data)
+      munmap(preloaded[i].data, preloaded[i].size);
+    free(preloaded[i].file);
+  }
+
+  free(preloaded);
+  preloaded = NULL;
+  preloadCount = 0;
+}
+
+// Restarts the preload for path (NULL for the last path given), in the background
+void TBPreload(const char* path) {
+  TBPreloadStop();
+
+  if (path) {
+    free(preloadPath);
+    preloadPath = strdup(path);
+  }
+
+  if (!TB_PRELOAD || !preloadPath || !preloadPath[0] || !strcmp(preloadPath, "<empty>"))
+    return;
+
+  int capacity = 0;
+  char* dirs = strdup(preloadPath);
+  for (char* dir = strtok(dirs, ":"); dir; dir = strtok(NULL, ":")) {
+    DIR* d = opendir(dir);
+    if (!d)
+      continue;
+
+    for (struct dirent* e; (e = readdir(d));) {
+      int pieces = TableFilePieces(e->d_name);
+      if (!pieces || pieces > TB_PRELOAD)
+        continue;
+
+      if (preloadCount == capacity) {
+        capacity = max(64, 2 * capacity);
+        preloaded = realloc(preloaded, capacity * sizeof(PreloadedTable));
+      }
+
+      PreloadedTable* table = &preloaded[preloadCount++];
+      memset(table, 0, sizeof(PreloadedTable));
+      table->file = malloc(strlen(dir) + strlen(e->d_name) + 2);
+      sprintf(table->file, "%s/%s", dir, e->d_name);
+    }
+
+    closedir(d);
+  }
+  free(dirs);
+
+  printf("info string Syzygy preload of %d files with up to %d pieces started\n", preloadCount, TB_PRELOAD);
+  if (!preloadCount)
+    return;
+
+  atomic_store(&preloadNext, 0);
+  atomic_store(&preloadDone, 0);
+  atomic_store(&preloadStop, 0);
+  atomic_store(&preloadBytes, 0);
+
+  preloadThreadCount = min(TB_PRELOAD_THREADS, preloadCount);
+  for (int i = 0; i < preloadThreadCount; i++)
+    pthread_create(&preloadThreads[i], NULL, PreloadWorker, NULL);
+}
+#else
+void TBPreloadStop() {}
+
+void TBPreload(const char* path) {
+  (void)path;
+
+  if (TB_PRELOAD)
+    printf("info string SyzygyPreload is not supported on this platform\n");
+}
+#endif
+
 Move TBRootProbe(Board* board) {
   if (board->castling || bits(board->occupancies[BOTH]) > TB_LARGEST)
     return NULL_MOVE;
@@ -59,12 +286,24 @@ unsigned TBProbe(Board* board) {
   if (board->castling || board->halfMove || bits(board->occupancies[BOTH]) > TB_LARGEST)
     return TB_RESULT_FAILED;
 
-  return tb_probe_wdl(vf(board->occupancies[WHITE]), vf(board->occupancies[BLACK]),
-                      vf(board->pieces[KING_WHITE] | board->pieces[KING_BLACK]),
-                      vf(board->pieces[QUEEN_WHITE] | board->pieces[QUEEN_BLACK]),
-                      vf(board->pieces[ROOK_WHITE] | board->pieces[ROOK_BLACK]),
-                      vf(board->pieces[BISHOP_WHITE] | board->pieces[BISHOP_BLACK]),
-                      vf(board->pieces[KNIGHT_WHITE] | board->pieces[KNIGHT_BLACK]),
-                      vf(board->pieces[PAWN_WHITE] | board->pieces[PAWN_BLACK]),
-                      board->epSquare ? MIRROR[board->epSquare] : 0, board->side == WHITE ? 1 : 0);
+  uint64_t* entry = tbCache ? &tbCache[board->zobrist & tbCacheMask] : NULL;
+  if (entry) {
+    uint64_t cached = *entry;
+    if (cached && (cached & ~7ULL) == (board->zobrist & ~7ULL))
+      return (cached & 7) == 7 ? TB_RESULT_FAILED : (cached & 7) - 1;
+  }
+
+  unsigned result = tb_probe_wdl(vf(board->occupancies[WHITE]), vf(board->occupancies[BLACK]),
+                                  vf(board->pieces[KING_WHITE] | board->pieces[KING_BLACK]),
+                                  vf(board->pieces[QUEEN_WHITE] | board->pieces[QUEEN_BLACK]),
+                                  vf(board->pieces[ROOK_WHITE] | board->pieces[ROOK_BLACK]),
+                                  vf(board->pieces[BISHOP_WHITE] | board->pieces[BISHOP_BLACK]),
+                                  vf(board->pieces[KNIGHT_WHITE] | board->pieces[KNIGHT_BLACK]),
+                                  vf(board->pieces[PAWN_WHITE] | board->pieces[PAWN_BLACK]),
+                                  board->epSquare ? MIRROR[board->epSquare] : 0, board->side == WHITE ? 1 : 0);
+
+  if (entry)
+    *entry = (board->zobrist & ~7ULL) | (result == TB_RESULT_FAILED ? 7 : result + 1);
+
+  return result;
 }
\ No newline at end of file
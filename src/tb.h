@@ -19,6 +19,14 @@
 
 #include "types.h"
 
+extern int TB_CACHE_MB;
+extern int TB_PRELOAD;
+
+void TBCacheInit(int mb);
+void TBCacheClear();
+void TBPrefetch(uint64_t hash);
+void TBPreloadStop();
+void TBPreload(const char* path);
 Move TBRootProbe(Board* board);
 unsigned TBProbe(Board* board);
 
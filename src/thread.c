@@ -14,27 +14,150 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "eval.h"
+#include "numa.h"
+#include "pawns.h"
+#include "thread.h"
+#include "transposition.h"
 #include "types.h"
 #include "util.h"
 
+// the first write to a page decides which node it lives on, so each
+// thread clears its own (large) search, pawn and eval tables
+void* ThreadFirstTouch(void* arg) {
+  ThreadData* thread = (ThreadData*)arg;
+
+  memset(&thread->data, 0, sizeof(SearchData));
+  memset(&thread->board, 0, sizeof(Board));
+  memset(&thread->materialTable, 0, sizeof(thread->materialTable));
+  memset(&thread->accumulators, 0, sizeof(thread->accumulators));
+#ifdef STATS
+  memset(&thread->stats, 0, sizeof(thread->stats));
+#endif
+
+  // largest power of two buckets/entries that fits
+  uint64_t buckets = 1;
+  while (2 * buckets * sizeof(PawnHashBucket) <= PAWN_HASH_MB * MEGABYTE)
+    buckets *= 2;
+
+  thread->pawnHashTable = AlignedMalloc(buckets * sizeof(PawnHashBucket));
+  thread->pawnHashMask = buckets - 1;
+  thread->pawnProbes = thread->pawnHits = 0;
+  thread->qsNodes = thread->lazyEvals = 0;
+  memset(thread->pawnHashTable, 0, buckets * sizeof(PawnHashBucket));
+
+  uint64_t entries = 1;
+  while (2 * entries * sizeof(EvalHashEntry) <= EVAL_HASH_MB * MEGABYTE)
+    entries *= 2;
+
+  thread->evalHashTable = AlignedMalloc(entries * sizeof(EvalHashEntry));
+  thread->evalHashMask = entries - 1;
+  memset(thread->evalHashTable, 0, entries * sizeof(EvalHashEntry));
+
+  return NULL;
+}
+
+// every pool thread lives in here, it parks until it is handed a job
+// and informs anyone waiting on it when the job is complete
+void* ThreadIdleLoop(void* arg) {
+  ThreadData* thread = (ThreadData*)arg;
+
+  BindThread(thread->idx);
+
+  pthread_mutex_lock(&thread->mutex);
+  while (1) {
+    while (!thread->job && !thread->destroy)
+      pthread_cond_wait(&thread->sleep, &thread->mutex);
+
+    if (thread->destroy)
+      break;
+
+    void* (*job)(void*) = thread->job;
+    pthread_mutex_unlock(&thread->mutex);
+
+    job(thread);
+
+    pthread_mutex_lock(&thread->mutex);
+    thread->job = NULL;
+    pthread_cond_broadcast(&thread->sleep);
+  }
+  pthread_mutex_unlock(&thread->mutex);
+
+  return NULL;
+}
+
 // initialize a pool of threads
 ThreadData* CreatePool(int count) {
-  ThreadData* threads = malloc(count * sizeof(ThreadData));
+  ThreadData* threads = AlignedMalloc(count * sizeof(ThreadData));
 
   for (int i = 0; i < count; i++) {
     // allow reference to one another
     threads[i].idx = i;
     threads[i].threads = threads;
     threads[i].count = count;
+
+    threads[i].job = ThreadFirstTouch;
+    threads[i].destroy = 0;
+    pthread_mutex_init(&threads[i].mutex, NULL);
+    pthread_cond_init(&threads[i].sleep, NULL);
   }
 
+  // threads are only started once all of the pool is setup
+  for (int i = 0; i < count; i++)
+    pthread_create(&threads[i].nativeThread, NULL, &ThreadIdleLoop, &threads[i]);
+
+  for (int i = 0; i < count; i++)
+    ThreadWaitUntilSleep(&threads[i]);
+
   return threads;
 }
 
+// stop and join all native threads, then release the pool
+void FreePool(ThreadData* threads) {
+  int count = threads->count;
+
+  for (int i = 0; i < count; i++) {
+    ThreadWaitUntilSleep(&threads[i]);
+
+    pthread_mutex_lock(&threads[i].mutex);
+    threads[i].destroy = 1;
+    pthread_cond_broadcast(&threads[i].sleep);
+    pthread_mutex_unlock(&threads[i].mutex);
+
+    pthread_join(threads[i].nativeThread, NULL);
+    pthread_mutex_destroy(&threads[i].mutex);
+    pthread_cond_destroy(&threads[i].sleep);
+
+    AlignedFree(threads[i].data.hist);
+    AlignedFree(threads[i].evalHashTable);
+    AlignedFree(threads[i].pawnHashTable);
+  }
+
+  AlignedFree(threads);
+}
+
+// hand a parked thread a job to run
+void ThreadWake(ThreadData* thread, void* (*job)(void*)) {
+  pthread_mutex_lock(&thread->mutex);
+  thread->job = job;
+  pthread_cond_broadcast(&thread->sleep);
+  pthread_mutex_unlock(&thread->mutex);
+}
+
+// block until the thread has finished its job and parked
+void ThreadWaitUntilSleep(ThreadData* thread) {
+  pthread_mutex_lock(&thread->mutex);
+  while (thread->job)
+    pthread_cond_wait(&thread->sleep, &thread->mutex);
+  pthread_mutex_unlock(&thread->mutex);
+}
+
 // initialize a pool prepping to start a search
+// the main thread may already be searching from its own board copy
 void InitPool(Board* board, SearchParams* params, ThreadData* threads) {
   for (int i = 0; i < threads->count; i++) {
     threads[i].params = params;
@@ -43,6 +166,9 @@ void InitPool(Board* board, SearchParams* params, ThreadData* threads) {
     threads[i].data.seldepth = 0;
     threads[i].data.ply = 0;
     threads[i].data.tbhits = 0;
+    threads[i].data.depth = 0;
+    threads[i].data.stopped = 0;
+    threads[i].pv.count = 0;
 
     // empty unneeded data
     memset(&threads[i].data.skipMove, 0, sizeof(threads[i].data.skipMove));
@@ -50,38 +176,61 @@ void InitPool(Board* board, SearchParams* params, ThreadData* threads) {
     memset(&threads[i].data.moves, 0, sizeof(threads[i].data.moves));
 
     // need full copies of the board
-    memcpy(&threads[i].board, board, sizeof(Board));
+    if (&threads[i].board != board)
+      memcpy(&threads[i].board, board, sizeof(Board));
   }
 }
 
+// each thread empties its own tables, they are done in parallel
+// rather than one after another on the uci thread
+void* ThreadClearTables(void* arg) {
+  ThreadData* thread = (ThreadData*)arg;
+
+  memset(&thread->data.killers, 0, sizeof(thread->data.killers));
+  memset(&thread->data.counters, 0, sizeof(thread->data.counters));
+  memset(&thread->data.corrections, 0, sizeof(thread->data.corrections));
+  memset(thread->pawnHashTable, 0, (thread->pawnHashMask + 1) * sizeof(PawnHashBucket));
+  memset(thread->evalHashTable, 0, (thread->evalHashMask + 1) * sizeof(EvalHashEntry));
+
+  if (thread->data.hist)
+    memset(thread->data.hist, 0, sizeof(HistoryTables));
+
+  return NULL;
+}
+
 void ResetThreadPool(Board* board, SearchParams* params, ThreadData* threads) {
   for (int i = 0; i < threads->count; i++) {
+    ThreadWaitUntilSleep(&threads[i]);
+    ThreadWake(&threads[i], ThreadClearTables);
+  }
+
+  for (int i = 0; i < threads->count; i++) {
+    ThreadWaitUntilSleep(&threads[i]);
+
     threads[i].params = params;
 
     threads[i].data.nodes = 0;
     threads[i].data.seldepth = 0;
     threads[i].data.ply = 0;
     threads[i].data.tbhits = 0;
+    threads[i].data.stopped = 0;
 
     // empty ALL data
     memset(&threads[i].data.skipMove, 0, sizeof(threads[i].data.skipMove));
     memset(&threads[i].data.evals, 0, sizeof(threads[i].data.evals));
     memset(&threads[i].data.moves, 0, sizeof(threads[i].data.moves));
-    memset(&threads[i].data.killers, 0, sizeof(threads[i].data.killers));
-    memset(&threads[i].data.counters, 0, sizeof(threads[i].data.counters));
-    memset(&threads[i].data.hh, 0, sizeof(threads[i].data.hh));
-    memset(&threads[i].pawnHashTable, 0, PAWN_TABLE_SIZE * sizeof(PawnHashEntry));
 
     // need full copies of the board
     memcpy(&threads[i].board, board, sizeof(Board));
   }
 }
 
-// sum node counts
+// counters are written by their owners without synchronization,
+// relaxed loads are enough as the sums are only for reporting
 uint64_t NodesSearched(ThreadData* threads) {
   uint64_t nodes = 0;
   for (int i = 0; i < threads->count; i++)
-    nodes += threads[i].data.nodes;
+    nodes += __atomic_load_n(&threads[i].data.nodes, __ATOMIC_RELAXED);
 
   return nodes;
 }
@@ -89,15 +238,15 @@ uint64_t NodesSearched(ThreadData* threads) {
 uint64_t TBHits(ThreadData* threads) {
   uint64_t tbhits = 0;
   for (int i = 0; i < threads->count; i++)
-    tbhits += threads[i].data.tbhits;
+    tbhits += __atomic_load_n(&threads[i].data.tbhits, __ATOMIC_RELAXED);
 
   return tbhits;
 }
 
 uint64_t Seldepth(ThreadData* threads) {
-  int seldepth = threads[0].data.seldepth;
+  int seldepth = __atomic_load_n(&threads[0].data.seldepth, __ATOMIC_RELAXED);
   for (int i = 1; i < threads->count; i++)
-    seldepth = max(seldepth, threads[i].data.seldepth);
+    seldepth = max(seldepth, __atomic_load_n(&threads[i].data.seldepth, __ATOMIC_RELAXED));
 
   return seldepth;
 }
\ No newline at end of file
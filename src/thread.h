@@ -20,6 +20,9 @@
 #include "types.h"
 
 ThreadData* CreatePool(int count);
+void FreePool(ThreadData* threads);
+void ThreadWake(ThreadData* thread, void* (*job)(void*));
+void ThreadWaitUntilSleep(ThreadData* thread);
 void InitPool(Board* board, SearchParams* params, ThreadData* threads);
 void ResetThreadPool(Board* board, SearchParams* params, ThreadData* threads);
 uint64_t NodesSearched(ThreadData* threads);
@@ -0,0 +1,100 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2021 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "move.h"
+#include "search.h"
+#include "timeman.h"
+#include "types.h"
+#include "util.h"
+
+int MOVE_OVERHEAD = 100;
+
+// The soft limit is what a move should take and the hard limit what it may
+// take. A fixed move time leaves nothing to manage, both are the same then
+void TMInit(SearchParams* params, int time, int inc, int movesToGo, int moveTime) {
+  params->tmBestMove = NULL_MOVE;
+  params->tmStability = 0;
+  params->tmScore = UNKNOWN;
+
+  if (moveTime != -1) {
+    params->timeset = 1;
+    params->alloc = moveTime;
+    params->max = moveTime;
+  } else if (time != -1) {
+    params->timeset = 1;
+
+    time = max(0, time - MOVE_OVERHEAD);
+    int spend = max(1, time / movesToGo + inc);
+
+    params->max = min(4 * spend, time * 0.9);
+    params->alloc = min(spend, params->max / 3);
+  } else {
+    // no time control
+    params->timeset = 0;
+  }
+}
+
+// Called by the main thread after every completed depth, decides if there is
+// time for another. The soft limit is scaled by
+//  - stability: a best move that has held for many depths needs less time
+//  - effort: little of the tree under the best move means others came close
+//  - score: a falling score wants more time to find a way out
+// The hard limit is left to the timer thread
+int TMStop(ThreadData* thread) {
+  SearchParams* params = thread->params;
+  SearchData* data = &thread->data;
+
+  if (data->bestMove == params->tmBestMove) {
+    params->tmStability = min(params->tmStability + 1, 10);
+  } else {
+    params->tmBestMove = data->bestMove;
+    params->tmStability = 0;
+  }
+
+  int prevScore = params->tmScore;
+  params->tmScore = data->score;
+
+  if (!params->timeset || params->alloc >= params->max || data->depth < 5)
+    return 0;
+
+  uint64_t total = 0, best = 0;
+  for (int i = 0; i < thread->numRootMoves; i++) {
+    total += thread->rootMoves[i].nodes;
+    if (thread->rootMoves[i].move == data->bestMove)
+      best = thread->rootMoves[i].nodes;
+  }
+
+  double stability = 1.25 - 0.05 * params->tmStability;
+  double effort = total ? fmax(0.5, 2.0 * (1.0 - (double)best / total) + 0.4) : 1.0;
+  double drop = prevScore != UNKNOWN && abs(data->score) < MATE_BOUND ? prevScore - data->score : 0;
+  double score = 1.0 + fmin(fmax(drop, 0), 8 * WINDOW) / (16 * WINDOW);
+
+  return GetTimeMS() - params->start >= params->alloc * stability * effort * score;
+}
+
+// The expected move was played and our clock starts now. The time spent
+// pondering counts towards the soft limit as the search is that far along
+// already, but the hard limit is on the clock
+void TMPonderHit(SearchParams* params) {
+  params->max += GetTimeMS() - params->start;
+  params->ponder = 0;
+
+  if (params->stopOnPonderhit)
+    params->stopped = 1;
+}
\ No newline at end of file
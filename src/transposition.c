@@ -22,44 +22,212 @@
 #include <string.h>
 
 #if defined(__linux__)
+#include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 #include "bits.h"
+#include "move.h"
+#include "numa.h"
 #include "search.h"
+#include "thread.h"
 #include "transposition.h"
 #include "types.h"
+#include "util.h"
+#include "zobrist.h"
 
 // Global TT
 TTTable TT = {0};
 
-size_t TTInit(int mb) {
+#define EntryCheck(shortHash, move, score, eval, depth, flags)                                                      \
+  ((uint16_t)((shortHash) ^ (move) ^ (uint16_t)(score) ^ (uint16_t)(eval) ^ ((uint8_t)(depth) | ((flags) << 8))))
+#define EntryValid(e, shortHash)                                                                                       \
+  ((e)->key == EntryCheck(shortHash, (e)->move, (e)->score, (e)->eval, (e)->depth, (e)->genBound & TT_FLAG_MASK))
+#define EntryEmpty(e) (!(e)->key && !(e)->move && !(e)->genBound)
+#define EntryAge(e) ((e)->genBound >> 3)
+
+#if defined(__linux__) && !defined(__ANDROID__)
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+// Attach to (or create) a named segment that every process configured with
+// the same name shares. The segment outlives the process so that others can
+// keep using it, remove it from /dev/shm when no longer wanted
+void* TTSharedAlloc(size_t bytes) {
+  int fd = shm_open(TT.sharedName, O_CREAT | O_RDWR, 0600);
+  if (fd < 0)
+    return NULL;
+
+  struct stat st;
+  if (fstat(fd, &st) || (st.st_size && (size_t)st.st_size != bytes) || (!st.st_size && ftruncate(fd, bytes))) {
+    close(fd);
+    return NULL;
+  }
+
+  void* mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (mem == MAP_FAILED)
+    return NULL;
+
+  TT.alloc = TT_ALLOC_SHARED;
+  TT.pages = "shared";
+  return mem;
+}
+
+// Reserved hugetlbfs pages are tried largest first, then transparent huge
+// pages and finally whatever the allocator hands back
+void* TTAlloc(size_t bytes) {
+  if (TT.sharedName[0]) {
+    void* mem = TTSharedAlloc(bytes);
+    if (mem)
+      return mem;
+
+    printf("info string FAILED to attach shared hash %s, using a private table\n", TT.sharedName);
+  }
+
+  const int hugeShifts[] = {30, 21};
+  const char* hugeNames[] = {"1GB", "2MB"};
+
+  for (int i = 0; i < 2; i++) {
+    if (bytes % (1ULL << hugeShifts[i]))
+      continue;
+
+    void* mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (hugeShifts[i] << MAP_HUGE_SHIFT), -1, 0);
+    if (mem != MAP_FAILED) {
+      TT.alloc = TT_ALLOC_MMAP;
+      TT.pages = hugeNames[i];
+      return mem;
+    }
+  }
+
+  // On Linux systems we align on 2MB boundaries and request Huge Pages,
+  // what was granted is only known once the table has been touched
+  void* mem = aligned_alloc(2 * MEGABYTE, bytes);
+  TT.alloc = TT_ALLOC_MALLOC;
+  TT.pages = mem && !madvise(mem, bytes, MADV_HUGEPAGE) ? "requested transparent huge" : "4KB";
+  return mem;
+}
+
+// Reads the transparent huge pages backing the table from the mapping
+// that holds it, the report stays as it was when smaps is unreadable
+void TTCheckPages() {
+  FILE* fp = fopen("/proc/self/smaps", "r");
+  if (fp == NULL)
+    return;
+
+  uintptr_t addr = (uintptr_t)TT.buckets;
+  unsigned long long lo, hi, kb;
+  int inside = 0;
+
+  char line[256];
+  while (fgets(line, sizeof(line), fp)) {
+    if (sscanf(line, "%llx-%llx ", &lo, &hi) == 2)
+      inside = lo <= addr && addr < hi;
+    else if (inside && sscanf(line, "AnonHugePages: %llu kB", &kb) == 1) {
+      TT.pages = kb ? "transparent huge" : "4KB";
+      break;
+    }
+  }
+
+  fclose(fp);
+}
+#endif
+
+// the table is a power of two buckets, the largest that fits in mb
+uint64_t TTBuckets(int mb) {
+  return 1ULL << ((uint64_t)log2(mb) + (uint64_t)log2(MEGABYTE / sizeof(TTBucket)));
+}
+
+size_t TTInit(int mb, ThreadData* threads) {
   if (TT.mask)
     TTFree();
 
-  uint64_t keySize = (uint64_t)log2(mb) + (uint64_t)log2(MEGABYTE / sizeof(TTBucket));
+  uint64_t buckets = TTBuckets(mb);
+  size_t bytes = buckets * sizeof(TTBucket);
 
 #if defined(__linux__) && !defined(__ANDROID__)
-  // On Linux systems we align on 2MB boundaries and request Huge Pages
-  TT.buckets = aligned_alloc(2 * MEGABYTE, (1ULL << keySize) * sizeof(TTBucket));
-  madvise(TT.buckets, (1ULL << keySize) * sizeof(TTBucket), MADV_HUGEPAGE);
+  TT.buckets = TTAlloc(bytes);
+  InterleaveMemory(TT.buckets, bytes);
 #else
-  TT.buckets = calloc((1ULL << keySize), sizeof(TTBucket));
+  TT.buckets = calloc(buckets, sizeof(TTBucket));
+  TT.alloc = TT_ALLOC_MALLOC;
+  TT.pages = "default";
 #endif
 
-  TT.mask = (1ULL << keySize) - 1ULL;
+  if (!TT.buckets) {
+    printf("info string FAILED to allocate %zu bytes for the TT\n", bytes);
+    exit(1);
+  }
+
+  TT.mask = buckets - 1ULL;
+  TT.size = mb;
+
+  // a shared table is either new (and zeroed) or already in use by others
+  if (TT.alloc != TT_ALLOC_SHARED)
+    TTClear(threads);
 
-  TTClear();
-  return (TT.mask + 1ULL) * sizeof(TTBucket);
+#if defined(__linux__) && !defined(__ANDROID__)
+  if (TT.alloc == TT_ALLOC_MALLOC)
+    TTCheckPages();
+#endif
+
+  return bytes;
 }
 
-void TTFree() { free(TT.buckets); }
+void TTFree() {
+  if (!TT.buckets)
+    return;
 
-inline void TTClear() { memset(TT.buckets, 0, (TT.mask + 1ULL) * sizeof(TTBucket)); }
+#if defined(__linux__) && !defined(__ANDROID__)
+  if (TT.alloc == TT_ALLOC_MMAP || TT.alloc == TT_ALLOC_SHARED)
+    munmap(TT.buckets, (TT.mask + 1ULL) * sizeof(TTBucket));
+  else
+#endif
+    free(TT.buckets);
+
+  TT.buckets = NULL;
+  TT.mask = 0;
+}
+
+// each pool thread zeroes an equal slice of the table, which also
+// spreads the first touch of fresh memory across the pool
+void* TTClearSlice(void* arg) {
+  ThreadData* thread = (ThreadData*)arg;
+
+  uint64_t buckets = TT.mask + 1ULL;
+  uint64_t slice = (buckets + thread->count - 1) / thread->count;
+  uint64_t start = slice * thread->idx;
+
+  if (start < buckets)
+    memset(TT.buckets + start, 0, min(slice, buckets - start) * sizeof(TTBucket));
+
+  return NULL;
+}
+
+// threads may be NULL before a pool exists (startup)
+void TTClear(ThreadData* threads) {
+  if (!threads || threads->count == 1) {
+    memset(TT.buckets, 0, (TT.mask + 1ULL) * sizeof(TTBucket));
+    return;
+  }
+
+  for (int i = 0; i < threads->count; i++) {
+    ThreadWaitUntilSleep(&threads[i]);
+    ThreadWake(&threads[i], TTClearSlice);
+  }
+
+  for (int i = 0; i < threads->count; i++)
+    ThreadWaitUntilSleep(&threads[i]);
+}
 
 inline void TTUpdate() { TT.age += 1; }
 
-inline int TTScore(TTEntry* e, int ply) {
+inline int TTScore(TTData* e, int ply) {
   if (e->score == UNKNOWN)
     return UNKNOWN;
 
@@ -68,17 +236,27 @@ inline int TTScore(TTEntry* e, int ply) {
 
 inline void TTPrefetch(uint64_t hash) { __builtin_prefetch(&TT.buckets[TT.mask & hash]); }
 
-inline TTEntry* TTProbe(int* hit, uint64_t hash) {
+// Each entry is copied out once and verified against that copy, the
+// search never looks at the shared entry again after this point
+inline int TTProbe(uint64_t hash, TTData* tt) {
 #ifndef TUNE
   TTEntry* bucket = TT.buckets[TT.mask & hash].entries;
-  uint32_t shortHash = hash >> 32;
+  uint16_t shortHash = hash >> 48;
+
+  for (int i = 0; i < BUCKET_SIZE; i++) {
+    TTEntry entry = bucket[i];
 
-  for (int i = 0; i < BUCKET_SIZE; i++)
-    if (bucket[i].hash == shortHash) {
-      *hit = 1;
-      bucket[i].age = TT.age;
-      return &bucket[i];
+    if (EntryValid(&entry, shortHash)) {
+      bucket[i].genBound = ((TT.age & TT_AGE_MASK) << 3) | (entry.genBound & TT_FLAG_MASK);
+
+      tt->move = entry.move;
+      tt->score = entry.score;
+      tt->eval = entry.eval;
+      tt->depth = entry.depth;
+      tt->flags = entry.genBound & TT_FLAG_MASK;
+      return 1;
     }
+  }
 #endif
 
   return 0;
@@ -90,7 +268,7 @@ inline void TTPut(uint64_t hash, int8_t depth, int16_t score, uint8_t flag, Move
 #else
 
   TTBucket* bucket = &TT.buckets[TT.mask & hash];
-  uint32_t shortHash = hash >> 32;
+  uint16_t shortHash = hash >> 48;
   TTEntry* toReplace = bucket->entries;
 
   if (score > MATE_BOUND)
@@ -99,12 +277,13 @@ inline void TTPut(uint64_t hash, int8_t depth, int16_t score, uint8_t flag, Move
     score -= ply;
 
   for (TTEntry* entry = bucket->entries; entry < bucket->entries + BUCKET_SIZE; entry++) {
-    if (!entry->hash) {
+    if (EntryEmpty(entry)) {
       toReplace = entry;
       break;
     }
 
-    if (entry->hash == shortHash) {
+    // a torn entry will simply fail this check and be treated as foreign
+    if (EntryValid(entry, shortHash)) {
       if (entry->depth > depth * 2 && !(flag & TT_EXACT))
         return;
 
@@ -112,12 +291,18 @@ inline void TTPut(uint64_t hash, int8_t depth, int16_t score, uint8_t flag, Move
       break;
     }
 
-    if (entry->depth - (256 + TT.age - entry->age) * 4 < toReplace->depth - (256 + TT.age - toReplace->age) * 4)
+    if (entry->depth - ((TT.age - EntryAge(entry)) & TT_AGE_MASK) * 4 <
+        toReplace->depth - ((TT.age - EntryAge(toReplace)) & TT_AGE_MASK) * 4)
       toReplace = entry;
   }
 
-  *toReplace = (TTEntry){
-      .flags = flag, .depth = depth, .eval = eval, .score = score, .hash = shortHash, .move = move, .age = TT.age};
+  uint16_t packed = PackMove(move);
+  *toReplace = (TTEntry){.key = EntryCheck(shortHash, packed, score, eval, depth, flag),
+                         .move = packed,
+                         .eval = eval,
+                         .score = score,
+                         .depth = depth,
+                         .genBound = ((TT.age & TT_AGE_MASK) << 3) | flag};
 #endif
 }
 
@@ -128,10 +313,95 @@ inline int TTFull() {
   for (int i = 0; i < c; i++) {
     TTBucket b = TT.buckets[i];
     for (int j = 0; j < BUCKET_SIZE; j++) {
-      if (b.entries[j].hash && b.entries[j].age == TT.age)
+      if (!EntryEmpty(&b.entries[j]) && EntryAge(&b.entries[j]) == (TT.age & TT_AGE_MASK))
         t++;
     }
   }
 
   return t * 1000 / (c * BUCKET_SIZE);
-}
\ No newline at end of file
+}
+#define TT_FILE_MAGIC 0x3154547273726542ULL // "BersrTT1"
+#define TT_FILE_VERSION 1
+
+typedef struct {
+  uint64_t magic;
+  uint32_t version, bucketSize;
+  uint64_t buckets, size;
+  uint64_t zobrist; // entries are only meaningful with the same keys
+  uint8_t age;
+} TTFileHeader;
+
+// fold all zobrist keys, tables written by a build seeded differently are rejected
+uint64_t ZobristSignature() {
+  uint64_t sig = ZOBRIST_SIDE_KEY;
+
+  for (int i = 0; i < 12; i++)
+    for (int j = 0; j < 64; j++)
+      sig ^= ZOBRIST_PIECES[i][j] * (i * 64 + j + 1);
+
+  for (int i = 0; i < 64; i++)
+    sig ^= ZOBRIST_EP_KEYS[i] + i;
+
+  for (int i = 0; i < 16; i++)
+    sig ^= ZOBRIST_CASTLE_KEYS[i] - i;
+
+  return sig;
+}
+
+int TTSave(char* path) {
+  FILE* fp = fopen(path, "wb");
+  if (fp == NULL)
+    return 0;
+
+  TTFileHeader header = {.magic = TT_FILE_MAGIC,
+                         .version = TT_FILE_VERSION,
+                         .bucketSize = sizeof(TTBucket),
+                         .buckets = TT.mask + 1ULL,
+                         .size = TT.size,
+                         .zobrist = ZobristSignature(),
+                         .age = TT.age};
+
+  int success = fwrite(&header, sizeof(TTFileHeader), 1, fp) == 1 &&
+                fwrite(TT.buckets, sizeof(TTBucket), header.buckets, fp) == header.buckets;
+
+  fclose(fp);
+  return success;
+}
+
+// The table is resized to match the file if needed, a shared table is
+// never resized under the other processes. The current contents are lost
+// whenever this fails after the header checks
+int TTLoad(char* path, ThreadData* threads) {
+  FILE* fp = fopen(path, "rb");
+  if (fp == NULL)
+    return 0;
+
+  TTFileHeader header;
+  if (fread(&header, sizeof(TTFileHeader), 1, fp) != 1 || header.magic != TT_FILE_MAGIC ||
+      header.version != TT_FILE_VERSION || header.bucketSize != sizeof(TTBucket) ||
+      header.zobrist != ZobristSignature()) {
+    fclose(fp);
+    return 0;
+  }
+
+  // the size is checked as the Hash option would be
+  if (header.size < 4 || header.size > 65536 || header.buckets != TTBuckets(header.size) ||
+      (TT.alloc == TT_ALLOC_SHARED && header.buckets != TT.mask + 1ULL)) {
+    fclose(fp);
+    return 0;
+  }
+
+  if (header.buckets != TT.mask + 1ULL)
+    TTInit(header.size, threads);
+
+  int success = header.buckets == TT.mask + 1ULL &&
+                fread(TT.buckets, sizeof(TTBucket), header.buckets, fp) == header.buckets;
+
+  if (success)
+    TT.age = header.age;
+  else
+    TTClear(threads);
+
+  fclose(fp);
+  return success;
+}
@@ -21,38 +21,63 @@
 
 #define NO_ENTRY 0ULL
 #define MEGABYTE 0x100000ULL
-#define BUCKET_SIZE 4
+#define BUCKET_SIZE 3
 
+#define TT_AGE_MASK 0x1F
+#define TT_FLAG_MASK 0x07
+
+// Entries are read and written by every search thread without locks.
+// The key is the upper hash bits xor'd with the rest of the entry, so an
+// entry whose fields come from different writes fails to verify and is ignored
 typedef struct {
-  uint32_t hash, move;
+  uint16_t key;
+  uint16_t move; // see PackMove
   int16_t eval, score;
   int8_t depth;
-  uint8_t flags, age;
+  uint8_t genBound; // age (5) | flags (3)
 } TTEntry;
 
+// Verified copy of an entry, as seen by the search
+typedef struct {
+  uint16_t move;
+  int16_t eval, score;
+  int8_t depth;
+  uint8_t flags;
+} TTData;
+
+// 3 entries of 10 bytes fit into half a cache line
 typedef struct {
   TTEntry entries[BUCKET_SIZE];
+  uint16_t padding;
 } TTBucket;
 
 typedef struct {
   TTBucket* buckets;
   uint64_t mask;
-  uint64_t size;
+  uint64_t size; // requested size in MB
   uint8_t age;
+  int alloc;         // how buckets must be released, see TTFree
+  const char* pages; // page size obtained, for reporting
+  char sharedName[128]; // POSIX shm name to share the table across processes, empty if private
 } TTTable;
 
+enum { TT_ALLOC_MALLOC, TT_ALLOC_MMAP, TT_ALLOC_SHARED };
+
 enum { TT_UNKNOWN = 0, TT_LOWER = 1, TT_UPPER = 2, TT_EXACT = 4 };
 
 extern TTTable TT;
 
-size_t TTInit(int mb);
+uint64_t TTBuckets(int mb);
+size_t TTInit(int mb, ThreadData* threads);
 void TTFree();
-void TTClear();
+void TTClear(ThreadData* threads);
 void TTUpdate();
 void TTPrefetch(uint64_t hash);
-TTEntry* TTProbe(int* hit, uint64_t hash);
-int TTScore(TTEntry* e, int ply);
+int TTProbe(uint64_t hash, TTData* tt);
+int TTScore(TTData* e, int ply);
 void TTPut(uint64_t hash, int8_t depth, int16_t score, uint8_t flag, Move move, int ply, int16_t eval);
 int TTFull();
+int TTSave(char* path);
+int TTLoad(char* path, ThreadData* threads);
 
 #endif
\ No newline at end of file
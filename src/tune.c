@@ -17,15 +17,23 @@
 #ifdef TUNE
 
 #include <math.h>
-#include <pthread.h>
+#include <omp.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include "bits.h"
 #include "board.h"
+#include "datagen.h"
 #include "eval.h"
+#include "random.h"
 #include "search.h"
 #include "thread.h"
 #include "tune.h"
@@ -42,7 +50,70 @@ const double EPSILON = 1e-8;
 
 double K = 2.878242507;
 
-void Tune() {
+int TUNE_THREADS = 1;
+int BATCH_SIZE = 0; // 0 for full batch
+
+// Every term the eval applies linearly, as a run of EvalCoeffs entries and the
+// Weights they scale. Weights is only Weight members, so it is indexed flat
+#define LINEAR(field)                                                                                                  \
+  {                                                                                                                    \
+    offsetof(EvalCoeffs, field), sizeof(((EvalCoeffs*)0)->field) / (sizeof(((Weights*)0)->field) / sizeof(Weight)),    \
+        sizeof(((Weights*)0)->field) / sizeof(Weight), offsetof(Weights, field) / sizeof(Weight)                       \
+  }
+
+const CoeffMap LINEAR_COEFFS[] = {
+    LINEAR(pieces),
+    LINEAR(psqt),
+    LINEAR(bishopPair),
+    LINEAR(knightPostPsqt),
+    LINEAR(bishopPostPsqt),
+    LINEAR(knightMobilities),
+    LINEAR(bishopMobilities),
+    LINEAR(rookMobilities),
+    LINEAR(queenMobilities),
+    LINEAR(minorBehindPawn),
+    LINEAR(knightPostReachable),
+    LINEAR(bishopPostReachable),
+    LINEAR(bishopTrapped),
+    LINEAR(rookTrapped),
+    LINEAR(badBishopPawns),
+    LINEAR(dragonBishop),
+    LINEAR(rookOpenFile),
+    LINEAR(rookSemiOpen),
+    LINEAR(defendedPawns),
+    LINEAR(doubledPawns),
+    LINEAR(isolatedPawns),
+    LINEAR(openIsolatedPawns),
+    LINEAR(backwardsPawns),
+    LINEAR(connectedPawn),
+    LINEAR(candidatePasser),
+    LINEAR(candidateEdgeDistance),
+    LINEAR(passedPawn),
+    LINEAR(passedPawnEdgeDistance),
+    LINEAR(passedPawnKingProximity),
+    LINEAR(passedPawnAdvance),
+    LINEAR(passedPawnEnemySliderBehind),
+    LINEAR(passedPawnSqRule),
+    LINEAR(knightThreats),
+    LINEAR(bishopThreats),
+    LINEAR(rookThreats),
+    LINEAR(kingThreat),
+    LINEAR(pawnThreat),
+    LINEAR(pawnPushThreat),
+    LINEAR(hangingThreat),
+    LINEAR(imbalance),
+    LINEAR(pawnShelter),
+    LINEAR(pawnStorm),
+    LINEAR(blockedPawnStorm),
+    LINEAR(castlingRights),
+};
+
+_Thread_local CoeffEntry* coeffBlock = NULL;
+_Thread_local int coeffBlockUsed = 0;
+CoeffEntry** coeffBlocks = NULL;
+int nCoeffBlocks = 0;
+
+void Tune(char* path, int threads, int batchSize) {
   Weights weights = {0};
 
   InitMaterialWeights(&weights);
@@ -59,18 +130,40 @@ void Tune() {
 
   PrintWeights(&weights, 0, 0);
 
+  // loading already runs on the threads asked for
+  TUNE_THREADS = threads > 0 ? threads : omp_get_max_threads();
+
   int n = 0;
-  Position* positions = LoadPositions(&n, &weights);
-  ALPHA *= sqrt(n);
+  Position* positions = LoadPositions(&n, &weights, path);
+  if (!positions) {
+    printf("Unable to load positions from %s\n", path);
+    return;
+  }
+
+  BATCH_SIZE = batchSize > 0 && batchSize < n ? batchSize : n;
+  printf("Tuning with %d threads, batches of %d positions\n", TUNE_THREADS, BATCH_SIZE);
+
+  Weights* local = malloc(sizeof(Weights) * TUNE_THREADS);
+
+  ALPHA *= sqrt(BATCH_SIZE);
 
   for (int epoch = 1; epoch <= 100000; epoch++) {
-    double error = UpdateAndTrain(epoch, n, positions, &weights);
+    if (BATCH_SIZE < n)
+      ShufflePositions(n, positions);
+
+    double error = 0;
+    for (int b = 0; b < n; b += BATCH_SIZE)
+      error += UpdateAndTrain(min(BATCH_SIZE, n - b), &positions[b], &weights, local);
+
+    printf("Epoch: %5d, Error: %9.8f\n", epoch, error / n);
 
     if (epoch % 10 == 0)
       PrintWeights(&weights, epoch, error);
   }
 
+  free(local);
   free(positions);
+  FreeCoeffs();
 }
 
 // Finn Eggers method for determining K
@@ -99,7 +192,7 @@ void ComputeK(int n, Position* positions) {
 double TotalStaticError(int n, Position* positions) {
   double e = 0;
 
-#pragma omp parallel for schedule(static) num_threads(THREADS) reduction(+ : e)
+#pragma omp parallel for schedule(static) num_threads(TUNE_THREADS) reduction(+ : e)
   for (int i = 0; i < n; i++) {
 
     double sigmoid = Sigmoid(positions[i].staticEval);
@@ -266,225 +359,59 @@ void MergeWeightGradients(Weight* dest, Weight* src) {
   dest->eg.g += src->eg.g;
 }
 
-double UpdateAndTrain(int epoch, int n, Position* positions, Weights* weights) {
-  pthread_t threads[THREADS];
-  GradientUpdate jobs[THREADS];
-  Weights local[THREADS];
+void MergeGradients(Weights* dest, Weights* src) {
+  Weight* d = (Weight*)dest;
+  Weight* s = (Weight*)src;
 
-  int chunk = (n / THREADS) + 1;
-
-  for (int t = 0; t < THREADS; t++) {
-    memcpy(&local[t], weights, sizeof(Weights));
-
-    jobs[t].error = 0.0;
-    jobs[t].n = t < THREADS - 1 ? chunk : (n - ((THREADS - 1) * chunk));
-    jobs[t].positions = &positions[t * chunk];
-    jobs[t].weights = &local[t];
-
-    pthread_create(&threads[t], NULL, &UpdateGradients, &jobs[t]);
-  }
-
-  for (int t = 0; t < THREADS; t++)
-    pthread_join(threads[t], NULL);
+  for (int i = 0; i < N_WEIGHTS; i++)
+    MergeWeightGradients(&d[i], &s[i]);
+}
 
+// One optimizer step over the given positions, each thread fills its own
+// gradient copy and the copies are summed pairwise in log2(threads) rounds
+double UpdateAndTrain(int n, Position* positions, Weights* weights, Weights* local) {
   double error = 0;
-  for (int t = 0; t < THREADS; t++) {
-    error += jobs[t].error;
-    Weights* w = jobs[t].weights;
-
-    for (int pc = PAWN_TYPE; pc < KING_TYPE; pc++) {
-      weights->pieces[pc].mg.g += w->pieces[pc].mg.g;
-      weights->pieces[pc].eg.g += w->pieces[pc].eg.g;
-    }
-
-    weights->bishopPair.mg.g += w->bishopPair.mg.g;
-    weights->bishopPair.eg.g += w->bishopPair.eg.g;
-
-    for (int pc = PAWN_TYPE; pc <= KING_TYPE; pc++) {
-      for (int sq = 0; sq < 32; sq++) {
-        for (int i = 0; i < 2; i++) {
-          weights->psqt[pc][i][sq].mg.g += w->psqt[pc][i][sq].mg.g;
-          weights->psqt[pc][i][sq].eg.g += w->psqt[pc][i][sq].eg.g;
-        }
-      }
-    }
-
-    for (int sq = 0; sq < 12; sq++) {
-      weights->knightPostPsqt[sq].mg.g += w->knightPostPsqt[sq].mg.g;
-      weights->knightPostPsqt[sq].eg.g += w->knightPostPsqt[sq].eg.g;
-
-      weights->bishopPostPsqt[sq].mg.g += w->bishopPostPsqt[sq].mg.g;
-      weights->bishopPostPsqt[sq].eg.g += w->bishopPostPsqt[sq].eg.g;
-    }
-
-    for (int c = 0; c < 9; c++) {
-      weights->knightMobilities[c].mg.g += w->knightMobilities[c].mg.g;
-      weights->knightMobilities[c].eg.g += w->knightMobilities[c].eg.g;
-    }
-
-    for (int c = 0; c < 14; c++) {
-      weights->bishopMobilities[c].mg.g += w->bishopMobilities[c].mg.g;
-      weights->bishopMobilities[c].eg.g += w->bishopMobilities[c].eg.g;
-    }
-
-    for (int c = 0; c < 15; c++) {
-      weights->rookMobilities[c].mg.g += w->rookMobilities[c].mg.g;
-      weights->rookMobilities[c].eg.g += w->rookMobilities[c].eg.g;
-    }
-
-    for (int c = 0; c < 28; c++) {
-      weights->queenMobilities[c].mg.g += w->queenMobilities[c].mg.g;
-      weights->queenMobilities[c].eg.g += w->queenMobilities[c].eg.g;
-    }
-
-    for (int pc = 0; pc < 6; pc++) {
-      weights->knightThreats[pc].mg.g += w->knightThreats[pc].mg.g;
-      weights->knightThreats[pc].eg.g += w->knightThreats[pc].eg.g;
-
-      weights->bishopThreats[pc].mg.g += w->bishopThreats[pc].mg.g;
-      weights->bishopThreats[pc].eg.g += w->bishopThreats[pc].eg.g;
-
-      weights->rookThreats[pc].mg.g += w->rookThreats[pc].mg.g;
-      weights->rookThreats[pc].eg.g += w->rookThreats[pc].eg.g;
-    }
-
-    weights->kingThreat.mg.g += w->kingThreat.mg.g;
-    weights->kingThreat.eg.g += w->kingThreat.eg.g;
-
-    weights->pawnThreat.mg.g += w->pawnThreat.mg.g;
-    weights->pawnThreat.eg.g += w->pawnThreat.eg.g;
-
-    weights->pawnPushThreat.mg.g += w->pawnPushThreat.mg.g;
-    weights->pawnPushThreat.eg.g += w->pawnPushThreat.eg.g;
+  int chunk = (n + TUNE_THREADS - 1) / TUNE_THREADS;
 
-    weights->hangingThreat.mg.g += w->hangingThreat.mg.g;
-    weights->hangingThreat.eg.g += w->hangingThreat.eg.g;
-
-    for (int i = 0; i < 5; i++) {
-      for (int j = 0; j < 5; j++) {
-        weights->imbalance[i][j].mg.g += w->imbalance[i][j].mg.g;
-        weights->imbalance[i][j].eg.g += w->imbalance[i][j].eg.g;
-      }
-    }
-
-    weights->minorBehindPawn.mg.g += w->minorBehindPawn.mg.g;
-    weights->minorBehindPawn.eg.g += w->minorBehindPawn.eg.g;
-
-    weights->knightPostReachable.mg.g += w->knightPostReachable.mg.g;
-    weights->knightPostReachable.eg.g += w->knightPostReachable.eg.g;
-
-    weights->bishopPostReachable.mg.g += w->bishopPostReachable.mg.g;
-    weights->bishopPostReachable.eg.g += w->bishopPostReachable.eg.g;
-
-    weights->bishopTrapped.mg.g += w->bishopTrapped.mg.g;
-    weights->bishopTrapped.eg.g += w->bishopTrapped.eg.g;
-
-    weights->rookTrapped.mg.g += w->rookTrapped.mg.g;
-    weights->rookTrapped.eg.g += w->rookTrapped.eg.g;
-
-    weights->badBishopPawns.mg.g += w->badBishopPawns.mg.g;
-    weights->badBishopPawns.eg.g += w->badBishopPawns.eg.g;
-
-    weights->dragonBishop.mg.g += w->dragonBishop.mg.g;
-    weights->dragonBishop.eg.g += w->dragonBishop.eg.g;
-
-    weights->rookOpenFile.mg.g += w->rookOpenFile.mg.g;
-    weights->rookOpenFile.eg.g += w->rookOpenFile.eg.g;
-
-    weights->rookSemiOpen.mg.g += w->rookSemiOpen.mg.g;
-    weights->rookSemiOpen.eg.g += w->rookSemiOpen.eg.g;
-
-    weights->defendedPawns.mg.g += w->defendedPawns.mg.g;
-    weights->defendedPawns.eg.g += w->defendedPawns.eg.g;
-
-    weights->doubledPawns.mg.g += w->doubledPawns.mg.g;
-    weights->doubledPawns.eg.g += w->doubledPawns.eg.g;
-
-    for (int f = 0; f < 4; f++) {
-      weights->isolatedPawns[f].mg.g += w->isolatedPawns[f].mg.g;
-      weights->isolatedPawns[f].eg.g += w->isolatedPawns[f].eg.g;
-    }
-
-    weights->openIsolatedPawns.mg.g += w->openIsolatedPawns.mg.g;
-    weights->openIsolatedPawns.eg.g += w->openIsolatedPawns.eg.g;
-
-    weights->backwardsPawns.mg.g += w->backwardsPawns.mg.g;
-    weights->backwardsPawns.eg.g += w->backwardsPawns.eg.g;
-
-    weights->candidateEdgeDistance.mg.g += w->candidateEdgeDistance.mg.g;
-    weights->candidateEdgeDistance.eg.g += w->candidateEdgeDistance.eg.g;
-
-    for (int r = 0; r < 8; r++) {
-      weights->connectedPawn[r].mg.g += w->connectedPawn[r].mg.g;
-      weights->connectedPawn[r].eg.g += w->connectedPawn[r].eg.g;
-
-      weights->candidatePasser[r].mg.g += w->candidatePasser[r].mg.g;
-      weights->candidatePasser[r].eg.g += w->candidatePasser[r].eg.g;
-    }
-
-    for (int r = 0; r < 8; r++) {
-      weights->passedPawn[r].mg.g += w->passedPawn[r].mg.g;
-      weights->passedPawn[r].eg.g += w->passedPawn[r].eg.g;
-    }
-
-    weights->passedPawnEdgeDistance.mg.g += w->passedPawnEdgeDistance.mg.g;
-    weights->passedPawnEdgeDistance.eg.g += w->passedPawnEdgeDistance.eg.g;
-
-    weights->passedPawnKingProximity.mg.g += w->passedPawnKingProximity.mg.g;
-    weights->passedPawnKingProximity.eg.g += w->passedPawnKingProximity.eg.g;
-
-    for (int r = 0; r < 5; r++) {
-      weights->passedPawnAdvance[r].mg.g += w->passedPawnAdvance[r].mg.g;
-      weights->passedPawnAdvance[r].eg.g += w->passedPawnAdvance[r].eg.g;
-    }
-
-    weights->passedPawnEnemySliderBehind.mg.g += w->passedPawnEnemySliderBehind.mg.g;
-    weights->passedPawnEnemySliderBehind.eg.g += w->passedPawnEnemySliderBehind.eg.g;
-
-    weights->passedPawnSqRule.mg.g += w->passedPawnSqRule.mg.g;
-    weights->passedPawnSqRule.eg.g += w->passedPawnSqRule.eg.g;
-
-    for (int f = 0; f < 4; f++) {
-      for (int r = 0; r < 8; r++) {
-        weights->pawnShelter[f][r].mg.g += w->pawnShelter[f][r].mg.g;
-        weights->pawnShelter[f][r].eg.g += w->pawnShelter[f][r].eg.g;
-
-        weights->pawnStorm[f][r].mg.g += w->pawnStorm[f][r].mg.g;
-        weights->pawnStorm[f][r].eg.g += w->pawnStorm[f][r].eg.g;
-      }
-    }
-
-    for (int r = 0; r < 8; r++) {
-      weights->blockedPawnStorm[r].mg.g += w->blockedPawnStorm[r].mg.g;
-      weights->blockedPawnStorm[r].eg.g += w->blockedPawnStorm[r].eg.g;
-    }
+#pragma omp parallel for schedule(static, 1) num_threads(TUNE_THREADS) reduction(+ : error)
+  for (int t = 0; t < TUNE_THREADS; t++) {
+    memcpy(&local[t], weights, sizeof(Weights));
 
-    weights->castlingRights.mg.g += w->castlingRights.mg.g;
-    weights->castlingRights.eg.g += w->castlingRights.eg.g;
+    Weight* w = (Weight*)&local[t];
+    for (int i = 0; i < N_WEIGHTS; i++)
+      w[i].mg.g = w[i].eg.g = 0;
 
-    weights->space.mg.g += w->space.mg.g;
+    int start = min(n, t * chunk);
+    GradientUpdate job = {
+        .error = 0.0, .n = min(n, start + chunk) - start, .positions = &positions[start], .weights = &local[t]};
+    UpdateGradients(&job);
 
-    for (int i = 0; i < 5; i++)
-      weights->ksAttackerWeight[i].mg.g += w->ksAttackerWeight[i].mg.g;
-
-    weights->ksWeakSqs.mg.g += w->ksWeakSqs.mg.g;
-    weights->ksPinned.mg.g += w->ksPinned.mg.g;
-    weights->ksKnightCheck.mg.g += w->ksKnightCheck.mg.g;
-    weights->ksBishopCheck.mg.g += w->ksBishopCheck.mg.g;
-    weights->ksRookCheck.mg.g += w->ksRookCheck.mg.g;
-    weights->ksQueenCheck.mg.g += w->ksQueenCheck.mg.g;
-    weights->ksUnsafeCheck.mg.g += w->ksUnsafeCheck.mg.g;
-    weights->ksEnemyQueen.mg.g += w->ksEnemyQueen.mg.g;
-    weights->ksKnightDefense.mg.g += w->ksKnightDefense.mg.g;
+    error += job.error;
   }
 
-  printf("Epoch: %5d, Error: %9.8f\n", epoch, error / n);
+  for (int stride = 1; stride < TUNE_THREADS; stride *= 2) {
+#pragma omp parallel for num_threads(TUNE_THREADS)
+    for (int t = 0; t < TUNE_THREADS - stride; t += 2 * stride)
+      MergeGradients(&local[t], &local[t + stride]);
+  }
 
+  MergeGradients(weights, &local[0]);
   UpdateWeights(weights);
 
   return error;
 }
 
+// Fisher-Yates, new mini-batches each epoch
+void ShufflePositions(int n, Position* positions) {
+  for (int i = n - 1; i > 0; i--) {
+    int j = RandomUInt64() % (i + 1);
+
+    Position temp = positions[i];
+    positions[i] = positions[j];
+    positions[j] = temp;
+  }
+}
+
 void* UpdateGradients(void* arg) {
   GradientUpdate* job = (GradientUpdate*)arg;
 
@@ -499,15 +426,7 @@ void* UpdateGradients(void* arg) {
     double sigmoid = Sigmoid(actual);
     double loss = (positions[i].result - sigmoid) * sigmoid * (1 - sigmoid);
 
-    UpdateMaterialGradients(&positions[i], loss, weights);
-    UpdatePsqtGradients(&positions[i], loss, weights);
-    UpdatePostPsqtGradients(&positions[i], loss, weights);
-    UpdateMobilityGradients(&positions[i], loss, weights);
-    UpdateThreatGradients(&positions[i], loss, weights);
-    UpdatePieceBonusGradients(&positions[i], loss, weights);
-    UpdatePawnBonusGradients(&positions[i], loss, weights);
-    UpdatePasserBonusGradients(&positions[i], loss, weights);
-    UpdatePawnShelterGradients(&positions[i], loss, weights);
+    UpdateLinearGradients(&positions[i], loss, weights);
     UpdateSpaceGradients(&positions[i], loss, weights);
     UpdateKingSafetyGradients(&positions[i], loss, weights, ks);
 
@@ -517,226 +436,23 @@ void* UpdateGradients(void* arg) {
   return NULL;
 }
 
-void UpdateMaterialGradients(Position* position, double loss, Weights* weights) {
-  double mgBase = position->phaseMg * position->scale * loss / MAX_SCALE;
-  double egBase = position->phaseEg * position->scale * loss / MAX_SCALE;
-
-  for (int pc = PAWN_TYPE; pc < KING_TYPE; pc++) {
-    weights->pieces[pc].mg.g += position->coeffs.pieces[pc] * mgBase;
-    weights->pieces[pc].eg.g += position->coeffs.pieces[pc] * egBase;
-  }
-}
-
-void UpdatePsqtGradients(Position* position, double loss, Weights* weights) {
-  double mgBase = position->phaseMg * position->scale * loss / MAX_SCALE;
-  double egBase = position->phaseEg * position->scale * loss / MAX_SCALE;
-
-  for (int pc = PAWN_TYPE; pc <= KING_TYPE; pc++) {
-    for (int sq = 0; sq < 32; sq++) {
-      for (int i = 0; i < 2; i++) {
-        weights->psqt[pc][i][sq].mg.g += position->coeffs.psqt[pc][i][sq] * mgBase;
-        weights->psqt[pc][i][sq].eg.g += position->coeffs.psqt[pc][i][sq] * egBase;
-      }
-    }
-  }
-}
-
-void UpdatePostPsqtGradients(Position* position, double loss, Weights* weights) {
-  double mgBase = position->phaseMg * position->scale * loss / MAX_SCALE;
-  double egBase = position->phaseEg * position->scale * loss / MAX_SCALE;
-
-  for (int sq = 0; sq < 12; sq++) {
-    weights->knightPostPsqt[sq].mg.g += position->coeffs.knightPostPsqt[sq] * mgBase;
-    weights->knightPostPsqt[sq].eg.g += position->coeffs.knightPostPsqt[sq] * egBase;
-
-    weights->bishopPostPsqt[sq].mg.g += position->coeffs.bishopPostPsqt[sq] * mgBase;
-    weights->bishopPostPsqt[sq].eg.g += position->coeffs.bishopPostPsqt[sq] * egBase;
-  }
-}
-
-void UpdateMobilityGradients(Position* position, double loss, Weights* weights) {
-  double mgBase = position->phaseMg * position->scale * loss / MAX_SCALE;
-  double egBase = position->phaseEg * position->scale * loss / MAX_SCALE;
-
-  for (int c = 0; c < 9; c++) {
-    weights->knightMobilities[c].mg.g += position->coeffs.knightMobilities[c] * mgBase;
-    weights->knightMobilities[c].eg.g += position->coeffs.knightMobilities[c] * egBase;
-  }
-
-  for (int c = 0; c < 14; c++) {
-    weights->bishopMobilities[c].mg.g += position->coeffs.bishopMobilities[c] * mgBase;
-    weights->bishopMobilities[c].eg.g += position->coeffs.bishopMobilities[c] * egBase;
-  }
-
-  for (int c = 0; c < 15; c++) {
-    weights->rookMobilities[c].mg.g += position->coeffs.rookMobilities[c] * mgBase;
-    weights->rookMobilities[c].eg.g += position->coeffs.rookMobilities[c] * egBase;
-  }
-
-  for (int c = 0; c < 28; c++) {
-    weights->queenMobilities[c].mg.g += position->coeffs.queenMobilities[c] * mgBase;
-    weights->queenMobilities[c].eg.g += position->coeffs.queenMobilities[c] * egBase;
-  }
-}
-
-void UpdateThreatGradients(Position* position, double loss, Weights* weights) {
-  double mgBase = position->phaseMg * position->scale * loss / MAX_SCALE;
-  double egBase = position->phaseEg * position->scale * loss / MAX_SCALE;
-
-  for (int pc = 0; pc < 6; pc++) {
-    weights->knightThreats[pc].mg.g += position->coeffs.knightThreats[pc] * mgBase;
-    weights->knightThreats[pc].eg.g += position->coeffs.knightThreats[pc] * egBase;
-
-    weights->bishopThreats[pc].mg.g += position->coeffs.bishopThreats[pc] * mgBase;
-    weights->bishopThreats[pc].eg.g += position->coeffs.bishopThreats[pc] * egBase;
-
-    weights->rookThreats[pc].mg.g += position->coeffs.rookThreats[pc] * mgBase;
-    weights->rookThreats[pc].eg.g += position->coeffs.rookThreats[pc] * egBase;
-  }
-
-  weights->kingThreat.mg.g += position->coeffs.kingThreat * mgBase;
-  weights->kingThreat.eg.g += position->coeffs.kingThreat * egBase;
-
-  weights->pawnThreat.mg.g += position->coeffs.pawnThreat * mgBase;
-  weights->pawnThreat.eg.g += position->coeffs.pawnThreat * egBase;
-
-  weights->pawnPushThreat.mg.g += position->coeffs.pawnPushThreat * mgBase;
-  weights->pawnPushThreat.eg.g += position->coeffs.pawnPushThreat * egBase;
-
-  weights->hangingThreat.mg.g += position->coeffs.hangingThreat * mgBase;
-  weights->hangingThreat.eg.g += position->coeffs.hangingThreat * egBase;
-}
-
-void UpdatePieceBonusGradients(Position* position, double loss, Weights* weights) {
-  double mgBase = position->phaseMg * position->scale * loss / MAX_SCALE;
-  double egBase = position->phaseEg * position->scale * loss / MAX_SCALE;
-
-  weights->bishopPair.mg.g += position->coeffs.bishopPair * mgBase;
-  weights->bishopPair.eg.g += position->coeffs.bishopPair * egBase;
-
-  for (int i = 0; i < 5; i++) {
-    for (int j = 0; j < 5; j++) {
-      weights->imbalance[i][j].mg.g += position->coeffs.imbalance[i][j] * mgBase;
-      weights->imbalance[i][j].eg.g += position->coeffs.imbalance[i][j] * egBase;
-    }
-  }
-
-  weights->minorBehindPawn.mg.g += position->coeffs.minorBehindPawn * mgBase;
-  weights->minorBehindPawn.eg.g += position->coeffs.minorBehindPawn * egBase;
-
-  weights->knightPostReachable.mg.g += position->coeffs.knightPostReachable * mgBase;
-  weights->knightPostReachable.eg.g += position->coeffs.knightPostReachable * egBase;
-
-  weights->bishopPostReachable.mg.g += position->coeffs.bishopPostReachable * mgBase;
-  weights->bishopPostReachable.eg.g += position->coeffs.bishopPostReachable * egBase;
-
-  weights->bishopTrapped.mg.g += position->coeffs.bishopTrapped * mgBase;
-  weights->bishopTrapped.eg.g += position->coeffs.bishopTrapped * egBase;
-
-  weights->rookTrapped.mg.g += position->coeffs.rookTrapped * mgBase;
-  weights->rookTrapped.eg.g += position->coeffs.rookTrapped * egBase;
-
-  weights->badBishopPawns.mg.g += position->coeffs.badBishopPawns * mgBase;
-  weights->badBishopPawns.eg.g += position->coeffs.badBishopPawns * egBase;
-
-  weights->dragonBishop.mg.g += position->coeffs.dragonBishop * mgBase;
-  weights->dragonBishop.eg.g += position->coeffs.dragonBishop * egBase;
-
-  weights->rookOpenFile.mg.g += position->coeffs.rookOpenFile * mgBase;
-  weights->rookOpenFile.eg.g += position->coeffs.rookOpenFile * egBase;
-
-  weights->rookSemiOpen.mg.g += position->coeffs.rookSemiOpen * mgBase;
-  weights->rookSemiOpen.eg.g += position->coeffs.rookSemiOpen * egBase;
-}
-
-void UpdatePawnBonusGradients(Position* position, double loss, Weights* weights) {
-  double mgBase = position->phaseMg * position->scale * loss / MAX_SCALE;
-  double egBase = position->phaseEg * position->scale * loss / MAX_SCALE;
-
-  weights->defendedPawns.mg.g += position->coeffs.defendedPawns * mgBase;
-  weights->defendedPawns.eg.g += position->coeffs.defendedPawns * egBase;
-
-  weights->doubledPawns.mg.g += position->coeffs.doubledPawns * mgBase;
-  weights->doubledPawns.eg.g += position->coeffs.doubledPawns * egBase;
-
-  for (int f = 0; f < 4; f++) {
-    weights->isolatedPawns[f].mg.g += position->coeffs.isolatedPawns[f] * mgBase;
-    weights->isolatedPawns[f].eg.g += position->coeffs.isolatedPawns[f] * egBase;
-  }
-
-  weights->openIsolatedPawns.mg.g += position->coeffs.openIsolatedPawns * mgBase;
-  weights->openIsolatedPawns.eg.g += position->coeffs.openIsolatedPawns * egBase;
-
-  weights->backwardsPawns.mg.g += position->coeffs.backwardsPawns * mgBase;
-  weights->backwardsPawns.eg.g += position->coeffs.backwardsPawns * egBase;
-
-  weights->candidateEdgeDistance.mg.g += position->coeffs.candidateEdgeDistance * mgBase;
-  weights->candidateEdgeDistance.eg.g += position->coeffs.candidateEdgeDistance * egBase;
-
-  for (int r = 0; r < 8; r++) {
-    weights->connectedPawn[r].mg.g += position->coeffs.connectedPawn[r] * mgBase;
-    weights->connectedPawn[r].eg.g += position->coeffs.connectedPawn[r] * egBase;
-
-    weights->candidatePasser[r].mg.g += position->coeffs.candidatePasser[r] * mgBase;
-    weights->candidatePasser[r].eg.g += position->coeffs.candidatePasser[r] * egBase;
-  }
-}
-
-void UpdatePasserBonusGradients(Position* position, double loss, Weights* weights) {
+void UpdateLinearGradients(Position* position, double loss, Weights* weights) {
   double mgBase = position->phaseMg * position->scale * loss / MAX_SCALE;
   double egBase = position->phaseEg * position->scale * loss / MAX_SCALE;
 
-  for (int r = 0; r < 8; r++) {
-    weights->passedPawn[r].mg.g += position->coeffs.passedPawn[r] * mgBase;
-    weights->passedPawn[r].eg.g += position->coeffs.passedPawn[r] * egBase;
+  Weight* w = (Weight*)weights;
+  for (int i = 0; i < position->nCoeffs; i++) {
+    CoeffEntry c = position->coeffs[i];
+    w[c.index].mg.g += c.coeff * mgBase;
+    w[c.index].eg.g += c.coeff * egBase;
   }
-
-  weights->passedPawnEdgeDistance.mg.g += position->coeffs.passedPawnEdgeDistance * mgBase;
-  weights->passedPawnEdgeDistance.eg.g += position->coeffs.passedPawnEdgeDistance * egBase;
-
-  weights->passedPawnKingProximity.mg.g += position->coeffs.passedPawnKingProximity * mgBase;
-  weights->passedPawnKingProximity.eg.g += position->coeffs.passedPawnKingProximity * egBase;
-
-  for (int r = 0; r < 5; r++) {
-    weights->passedPawnAdvance[r].mg.g += position->coeffs.passedPawnAdvance[r] * mgBase;
-    weights->passedPawnAdvance[r].eg.g += position->coeffs.passedPawnAdvance[r] * egBase;
-  }
-
-  weights->passedPawnEnemySliderBehind.mg.g += position->coeffs.passedPawnEnemySliderBehind * mgBase;
-  weights->passedPawnEnemySliderBehind.eg.g += position->coeffs.passedPawnEnemySliderBehind * egBase;
-
-  weights->passedPawnSqRule.mg.g += position->coeffs.passedPawnSqRule * mgBase;
-  weights->passedPawnSqRule.eg.g += position->coeffs.passedPawnSqRule * egBase;
-}
-
-void UpdatePawnShelterGradients(Position* position, double loss, Weights* weights) {
-  double mgBase = position->phaseMg * position->scale * loss / MAX_SCALE;
-  double egBase = position->phaseEg * position->scale * loss / MAX_SCALE;
-
-  for (int f = 0; f < 4; f++) {
-    for (int r = 0; r < 8; r++) {
-      weights->pawnShelter[f][r].mg.g += position->coeffs.pawnShelter[f][r] * mgBase;
-      weights->pawnShelter[f][r].eg.g += position->coeffs.pawnShelter[f][r] * egBase;
-
-      weights->pawnStorm[f][r].mg.g += position->coeffs.pawnStorm[f][r] * mgBase;
-      weights->pawnStorm[f][r].eg.g += position->coeffs.pawnStorm[f][r] * egBase;
-    }
-  }
-
-  for (int f = 0; f < 8; f++) {
-    weights->blockedPawnStorm[f].mg.g += position->coeffs.blockedPawnStorm[f] * mgBase;
-    weights->blockedPawnStorm[f].eg.g += position->coeffs.blockedPawnStorm[f] * egBase;
-  }
-
-  weights->castlingRights.mg.g += position->coeffs.castlingRights * mgBase;
-  weights->castlingRights.eg.g += position->coeffs.castlingRights * egBase;
 }
 
 void UpdateSpaceGradients(Position* position, double loss, Weights* weights) {
   double mgBase = position->phaseMg * position->scale * loss / MAX_SCALE;
   double egBase = position->phaseEg * position->scale * loss / MAX_SCALE;
 
-  weights->space.mg.g += position->coeffs.space * mgBase / 1024.0;
+  weights->space.mg.g += position->space * mgBase / 1024.0;
 }
 
 void UpdateKingSafetyGradients(Position* position, double loss, Weights* weights, KSGradient* ks) {
@@ -745,64 +461,64 @@ void UpdateKingSafetyGradients(Position* position, double loss, Weights* weights
 
   for (int i = 1; i < 5; i++) {
     weights->ksAttackerWeight[i].mg.g += (mgBase / 512) * fmax(ks->bDanger, 0) *
-                                         position->coeffs.ksAttackerWeights[BLACK][i] *
-                                         position->coeffs.ksAttackerCount[BLACK];
+                                         position->kingSafety.ksAttackerWeights[BLACK][i] *
+                                         position->kingSafety.ksAttackerCount[BLACK];
     weights->ksAttackerWeight[i].mg.g += (egBase / 32) * (ks->bDanger > 0) *
-                                         position->coeffs.ksAttackerWeights[BLACK][i] *
-                                         position->coeffs.ksAttackerCount[BLACK];
+                                         position->kingSafety.ksAttackerWeights[BLACK][i] *
+                                         position->kingSafety.ksAttackerCount[BLACK];
 
     weights->ksAttackerWeight[i].mg.g -= (mgBase / 512) * fmax(ks->wDanger, 0) *
-                                         position->coeffs.ksAttackerWeights[WHITE][i] *
-                                         position->coeffs.ksAttackerCount[WHITE];
+                                         position->kingSafety.ksAttackerWeights[WHITE][i] *
+                                         position->kingSafety.ksAttackerCount[WHITE];
     weights->ksAttackerWeight[i].mg.g -= (egBase / 32) * (ks->wDanger > 0) *
-                                         position->coeffs.ksAttackerWeights[WHITE][i] *
-                                         position->coeffs.ksAttackerCount[WHITE];
+                                         position->kingSafety.ksAttackerWeights[WHITE][i] *
+                                         position->kingSafety.ksAttackerCount[WHITE];
   }
 
-  weights->ksWeakSqs.mg.g += (mgBase / 512) * fmax(ks->bDanger, 0) * position->coeffs.ksWeakSqs[BLACK];
-  weights->ksWeakSqs.mg.g += (egBase / 32) * (ks->bDanger > 0) * position->coeffs.ksWeakSqs[BLACK];
-  weights->ksWeakSqs.mg.g -= (mgBase / 512) * fmax(ks->wDanger, 0) * position->coeffs.ksWeakSqs[WHITE];
-  weights->ksWeakSqs.mg.g -= (egBase / 32) * (ks->wDanger > 0) * position->coeffs.ksWeakSqs[WHITE];
-
-  weights->ksPinned.mg.g += (mgBase / 512) * fmax(ks->bDanger, 0) * position->coeffs.ksPinned[BLACK];
-  weights->ksPinned.mg.g += (egBase / 32) * (ks->bDanger > 0) * position->coeffs.ksPinned[BLACK];
-  weights->ksPinned.mg.g -= (mgBase / 512) * fmax(ks->wDanger, 0) * position->coeffs.ksPinned[WHITE];
-  weights->ksPinned.mg.g -= (egBase / 32) * (ks->wDanger > 0) * position->coeffs.ksPinned[WHITE];
-
-  weights->ksKnightCheck.mg.g += (mgBase / 512) * fmax(ks->bDanger, 0) * position->coeffs.ksKnightCheck[BLACK];
-  weights->ksKnightCheck.mg.g += (egBase / 32) * (ks->bDanger > 0) * position->coeffs.ksKnightCheck[BLACK];
-  weights->ksKnightCheck.mg.g -= (mgBase / 512) * fmax(ks->wDanger, 0) * position->coeffs.ksKnightCheck[WHITE];
-  weights->ksKnightCheck.mg.g -= (egBase / 32) * (ks->wDanger > 0) * position->coeffs.ksKnightCheck[WHITE];
-
-  weights->ksBishopCheck.mg.g += (mgBase / 512) * fmax(ks->bDanger, 0) * position->coeffs.ksBishopCheck[BLACK];
-  weights->ksBishopCheck.mg.g += (egBase / 32) * (ks->bDanger > 0) * position->coeffs.ksBishopCheck[BLACK];
-  weights->ksBishopCheck.mg.g -= (mgBase / 512) * fmax(ks->wDanger, 0) * position->coeffs.ksBishopCheck[WHITE];
-  weights->ksBishopCheck.mg.g -= (egBase / 32) * (ks->wDanger > 0) * position->coeffs.ksBishopCheck[WHITE];
-
-  weights->ksRookCheck.mg.g += (mgBase / 512) * fmax(ks->bDanger, 0) * position->coeffs.ksRookCheck[BLACK];
-  weights->ksRookCheck.mg.g += (egBase / 32) * (ks->bDanger > 0) * position->coeffs.ksRookCheck[BLACK];
-  weights->ksRookCheck.mg.g -= (mgBase / 512) * fmax(ks->wDanger, 0) * position->coeffs.ksRookCheck[WHITE];
-  weights->ksRookCheck.mg.g -= (egBase / 32) * (ks->wDanger > 0) * position->coeffs.ksRookCheck[WHITE];
-
-  weights->ksQueenCheck.mg.g += (mgBase / 512) * fmax(ks->bDanger, 0) * position->coeffs.ksQueenCheck[BLACK];
-  weights->ksQueenCheck.mg.g += (egBase / 32) * (ks->bDanger > 0) * position->coeffs.ksQueenCheck[BLACK];
-  weights->ksQueenCheck.mg.g -= (mgBase / 512) * fmax(ks->wDanger, 0) * position->coeffs.ksQueenCheck[WHITE];
-  weights->ksQueenCheck.mg.g -= (egBase / 32) * (ks->wDanger > 0) * position->coeffs.ksQueenCheck[WHITE];
-
-  weights->ksUnsafeCheck.mg.g += (mgBase / 512) * fmax(ks->bDanger, 0) * position->coeffs.ksUnsafeCheck[BLACK];
-  weights->ksUnsafeCheck.mg.g += (egBase / 32) * (ks->bDanger > 0) * position->coeffs.ksUnsafeCheck[BLACK];
-  weights->ksUnsafeCheck.mg.g -= (mgBase / 512) * fmax(ks->wDanger, 0) * position->coeffs.ksUnsafeCheck[WHITE];
-  weights->ksUnsafeCheck.mg.g -= (egBase / 32) * (ks->wDanger > 0) * position->coeffs.ksUnsafeCheck[WHITE];
-
-  weights->ksEnemyQueen.mg.g += (mgBase / 512) * fmax(ks->bDanger, 0) * position->coeffs.ksEnemyQueen[BLACK];
-  weights->ksEnemyQueen.mg.g += (egBase / 32) * (ks->bDanger > 0) * position->coeffs.ksEnemyQueen[BLACK];
-  weights->ksEnemyQueen.mg.g -= (mgBase / 512) * fmax(ks->wDanger, 0) * position->coeffs.ksEnemyQueen[WHITE];
-  weights->ksEnemyQueen.mg.g -= (egBase / 32) * (ks->wDanger > 0) * position->coeffs.ksEnemyQueen[WHITE];
-
-  weights->ksKnightDefense.mg.g += (mgBase / 512) * fmax(ks->bDanger, 0) * position->coeffs.ksKnightDefense[BLACK];
-  weights->ksKnightDefense.mg.g += (egBase / 32) * (ks->bDanger > 0) * position->coeffs.ksKnightDefense[BLACK];
-  weights->ksKnightDefense.mg.g -= (mgBase / 512) * fmax(ks->wDanger, 0) * position->coeffs.ksKnightDefense[WHITE];
-  weights->ksKnightDefense.mg.g -= (egBase / 32) * (ks->wDanger > 0) * position->coeffs.ksKnightDefense[WHITE];
+  weights->ksWeakSqs.mg.g += (mgBase / 512) * fmax(ks->bDanger, 0) * position->kingSafety.ksWeakSqs[BLACK];
+  weights->ksWeakSqs.mg.g += (egBase / 32) * (ks->bDanger > 0) * position->kingSafety.ksWeakSqs[BLACK];
+  weights->ksWeakSqs.mg.g -= (mgBase / 512) * fmax(ks->wDanger, 0) * position->kingSafety.ksWeakSqs[WHITE];
+  weights->ksWeakSqs.mg.g -= (egBase / 32) * (ks->wDanger > 0) * position->kingSafety.ksWeakSqs[WHITE];
+
+  weights->ksPinned.mg.g += (mgBase / 512) * fmax(ks->bDanger, 0) * position->kingSafety.ksPinned[BLACK];
+  weights->ksPinned.mg.g += (egBase / 32) * (ks->bDanger > 0) * position->kingSafety.ksPinned[BLACK];
+  weights->ksPinned.mg.g -= (mgBase / 512) * fmax(ks->wDanger, 0) * position->kingSafety.ksPinned[WHITE];
+  weights->ksPinned.mg.g -= (egBase / 32) * (ks->wDanger > 0) * position->kingSafety.ksPinned[WHITE];
+
+  weights->ksKnightCheck.mg.g += (mgBase / 512) * fmax(ks->bDanger, 0) * position->kingSafety.ksKnightCheck[BLACK];
+  weights->ksKnightCheck.mg.g += (egBase / 32) * (ks->bDanger > 0) * position->kingSafety.ksKnightCheck[BLACK];
+  weights->ksKnightCheck.mg.g -= (mgBase / 512) * fmax(ks->wDanger, 0) * position->kingSafety.ksKnightCheck[WHITE];
+  weights->ksKnightCheck.mg.g -= (egBase / 32) * (ks->wDanger > 0) * position->kingSafety.ksKnightCheck[WHITE];
+
+  weights->ksBishopCheck.mg.g += (mgBase / 512) * fmax(ks->bDanger, 0) * position->kingSafety.ksBishopCheck[BLACK];
+  weights->ksBishopCheck.mg.g += (egBase / 32) * (ks->bDanger > 0) * position->kingSafety.ksBishopCheck[BLACK];
+  weights->ksBishopCheck.mg.g -= (mgBase / 512) * fmax(ks->wDanger, 0) * position->kingSafety.ksBishopCheck[WHITE];
+  weights->ksBishopCheck.mg.g -= (egBase / 32) * (ks->wDanger > 0) * position->kingSafety.ksBishopCheck[WHITE];
+
+  weights->ksRookCheck.mg.g += (mgBase / 512) * fmax(ks->bDanger, 0) * position->kingSafety.ksRookCheck[BLACK];
+  weights->ksRookCheck.mg.g += (egBase / 32) * (ks->bDanger > 0) * position->kingSafety.ksRookCheck[BLACK];
+  weights->ksRookCheck.mg.g -= (mgBase / 512) * fmax(ks->wDanger, 0) * position->kingSafety.ksRookCheck[WHITE];
+  weights->ksRookCheck.mg.g -= (egBase / 32) * (ks->wDanger > 0) * position->kingSafety.ksRookCheck[WHITE];
+
+  weights->ksQueenCheck.mg.g += (mgBase / 512) * fmax(ks->bDanger, 0) * position->kingSafety.ksQueenCheck[BLACK];
+  weights->ksQueenCheck.mg.g += (egBase / 32) * (ks->bDanger > 0) * position->kingSafety.ksQueenCheck[BLACK];
+  weights->ksQueenCheck.mg.g -= (mgBase / 512) * fmax(ks->wDanger, 0) * position->kingSafety.ksQueenCheck[WHITE];
+  weights->ksQueenCheck.mg.g -= (egBase / 32) * (ks->wDanger > 0) * position->kingSafety.ksQueenCheck[WHITE];
+
+  weights->ksUnsafeCheck.mg.g += (mgBase / 512) * fmax(ks->bDanger, 0) * position->kingSafety.ksUnsafeCheck[BLACK];
+  weights->ksUnsafeCheck.mg.g += (egBase / 32) * (ks->bDanger > 0) * position->kingSafety.ksUnsafeCheck[BLACK];
+  weights->ksUnsafeCheck.mg.g -= (mgBase / 512) * fmax(ks->wDanger, 0) * position->kingSafety.ksUnsafeCheck[WHITE];
+  weights->ksUnsafeCheck.mg.g -= (egBase / 32) * (ks->wDanger > 0) * position->kingSafety.ksUnsafeCheck[WHITE];
+
+  weights->ksEnemyQueen.mg.g += (mgBase / 512) * fmax(ks->bDanger, 0) * position->kingSafety.ksEnemyQueen[BLACK];
+  weights->ksEnemyQueen.mg.g += (egBase / 32) * (ks->bDanger > 0) * position->kingSafety.ksEnemyQueen[BLACK];
+  weights->ksEnemyQueen.mg.g -= (mgBase / 512) * fmax(ks->wDanger, 0) * position->kingSafety.ksEnemyQueen[WHITE];
+  weights->ksEnemyQueen.mg.g -= (egBase / 32) * (ks->wDanger > 0) * position->kingSafety.ksEnemyQueen[WHITE];
+
+  weights->ksKnightDefense.mg.g += (mgBase / 512) * fmax(ks->bDanger, 0) * position->kingSafety.ksKnightDefense[BLACK];
+  weights->ksKnightDefense.mg.g += (egBase / 32) * (ks->bDanger > 0) * position->kingSafety.ksKnightDefense[BLACK];
+  weights->ksKnightDefense.mg.g -= (mgBase / 512) * fmax(ks->wDanger, 0) * position->kingSafety.ksKnightDefense[WHITE];
+  weights->ksKnightDefense.mg.g -= (egBase / 32) * (ks->wDanger > 0) * position->kingSafety.ksKnightDefense[WHITE];
 }
 
 void ApplyCoeff(double* mg, double* eg, int coeff, Weight* w) {
@@ -813,15 +529,7 @@ void ApplyCoeff(double* mg, double* eg, int coeff, Weight* w) {
 double EvaluateCoeffs(Position* position, Weights* weights, KSGradient* ks) {
   double mg = 0, eg = 0;
 
-  EvaluateMaterialValues(&mg, &eg, position, weights);
-  EvaluatePsqtValues(&mg, &eg, position, weights);
-  EvaluatePostPsqtValues(&mg, &eg, position, weights);
-  EvaluateMobilityValues(&mg, &eg, position, weights);
-  EvaluateThreatValues(&mg, &eg, position, weights);
-  EvaluatePieceBonusValues(&mg, &eg, position, weights);
-  EvaluatePawnBonusValues(&mg, &eg, position, weights);
-  EvaluatePasserBonusValues(&mg, &eg, position, weights);
-  EvaluatePawnShelterValues(&mg, &eg, position, weights);
+  EvaluateLinearValues(&mg, &eg, position, weights);
   EvaluateSpaceValues(&mg, &eg, position, weights);
   EvaluateKingSafetyValues(&mg, &eg, position, weights, ks);
 
@@ -830,116 +538,14 @@ double EvaluateCoeffs(Position* position, Weights* weights, KSGradient* ks) {
   return result + (position->stm == WHITE ? TEMPO : -TEMPO);
 }
 
-void EvaluateMaterialValues(double* mg, double* eg, Position* position, Weights* weights) {
-  for (int pc = PAWN_TYPE; pc < KING_TYPE; pc++)
-    ApplyCoeff(mg, eg, position->coeffs.pieces[pc], &weights->pieces[pc]);
-}
-
-void EvaluatePsqtValues(double* mg, double* eg, Position* position, Weights* weights) {
-  for (int pc = PAWN_TYPE; pc <= KING_TYPE; pc++)
-    for (int sq = 0; sq < 32; sq++)
-      for (int i = 0; i < 2; i++)
-        ApplyCoeff(mg, eg, position->coeffs.psqt[pc][i][sq], &weights->psqt[pc][i][sq]);
-}
-
-void EvaluatePostPsqtValues(double* mg, double* eg, Position* position, Weights* weights) {
-  for (int sq = 0; sq < 12; sq++) {
-    ApplyCoeff(mg, eg, position->coeffs.knightPostPsqt[sq], &weights->knightPostPsqt[sq]);
-
-    ApplyCoeff(mg, eg, position->coeffs.bishopPostPsqt[sq], &weights->bishopPostPsqt[sq]);
-  }
-}
-
-void EvaluateMobilityValues(double* mg, double* eg, Position* position, Weights* weights) {
-  for (int c = 0; c < 9; c++)
-    ApplyCoeff(mg, eg, position->coeffs.knightMobilities[c], &weights->knightMobilities[c]);
-
-  for (int c = 0; c < 14; c++)
-    ApplyCoeff(mg, eg, position->coeffs.bishopMobilities[c], &weights->bishopMobilities[c]);
-
-  for (int c = 0; c < 15; c++)
-    ApplyCoeff(mg, eg, position->coeffs.rookMobilities[c], &weights->rookMobilities[c]);
-
-  for (int c = 0; c < 28; c++)
-    ApplyCoeff(mg, eg, position->coeffs.queenMobilities[c], &weights->queenMobilities[c]);
-}
-
-void EvaluateThreatValues(double* mg, double* eg, Position* position, Weights* weights) {
-  for (int pc = 0; pc < 6; pc++) {
-    ApplyCoeff(mg, eg, position->coeffs.knightThreats[pc], &weights->knightThreats[pc]);
-    ApplyCoeff(mg, eg, position->coeffs.bishopThreats[pc], &weights->bishopThreats[pc]);
-    ApplyCoeff(mg, eg, position->coeffs.rookThreats[pc], &weights->rookThreats[pc]);
-  }
-
-  ApplyCoeff(mg, eg, position->coeffs.kingThreat, &weights->kingThreat);
-  ApplyCoeff(mg, eg, position->coeffs.pawnThreat, &weights->pawnThreat);
-  ApplyCoeff(mg, eg, position->coeffs.pawnPushThreat, &weights->pawnPushThreat);
-  ApplyCoeff(mg, eg, position->coeffs.hangingThreat, &weights->hangingThreat);
-}
-
-void EvaluatePieceBonusValues(double* mg, double* eg, Position* position, Weights* weights) {
-  ApplyCoeff(mg, eg, position->coeffs.bishopPair, &weights->bishopPair);
-
-  for (int i = 0; i < 5; i++)
-    for (int j = 0; j < 5; j++)
-      ApplyCoeff(mg, eg, position->coeffs.imbalance[i][j], &weights->imbalance[i][j]);
-
-  ApplyCoeff(mg, eg, position->coeffs.minorBehindPawn, &weights->minorBehindPawn);
-  ApplyCoeff(mg, eg, position->coeffs.knightPostReachable, &weights->knightPostReachable);
-  ApplyCoeff(mg, eg, position->coeffs.bishopPostReachable, &weights->bishopPostReachable);
-  ApplyCoeff(mg, eg, position->coeffs.bishopTrapped, &weights->bishopTrapped);
-  ApplyCoeff(mg, eg, position->coeffs.rookTrapped, &weights->rookTrapped);
-  ApplyCoeff(mg, eg, position->coeffs.badBishopPawns, &weights->badBishopPawns);
-  ApplyCoeff(mg, eg, position->coeffs.dragonBishop, &weights->dragonBishop);
-  ApplyCoeff(mg, eg, position->coeffs.rookOpenFile, &weights->rookOpenFile);
-  ApplyCoeff(mg, eg, position->coeffs.rookSemiOpen, &weights->rookSemiOpen);
-}
-
-void EvaluatePawnBonusValues(double* mg, double* eg, Position* position, Weights* weights) {
-  ApplyCoeff(mg, eg, position->coeffs.defendedPawns, &weights->defendedPawns);
-  ApplyCoeff(mg, eg, position->coeffs.doubledPawns, &weights->doubledPawns);
-  ApplyCoeff(mg, eg, position->coeffs.openIsolatedPawns, &weights->openIsolatedPawns);
-  ApplyCoeff(mg, eg, position->coeffs.backwardsPawns, &weights->backwardsPawns);
-  ApplyCoeff(mg, eg, position->coeffs.candidateEdgeDistance, &weights->candidateEdgeDistance);
-
-  for (int f = 0; f < 4; f++)
-    ApplyCoeff(mg, eg, position->coeffs.isolatedPawns[f], &weights->isolatedPawns[f]);
-
-  for (int r = 0; r < 8; r++) {
-    ApplyCoeff(mg, eg, position->coeffs.connectedPawn[r], &weights->connectedPawn[r]);
-    ApplyCoeff(mg, eg, position->coeffs.candidatePasser[r], &weights->candidatePasser[r]);
-  }
-}
-
-void EvaluatePasserBonusValues(double* mg, double* eg, Position* position, Weights* weights) {
-  for (int r = 0; r < 8; r++)
-    ApplyCoeff(mg, eg, position->coeffs.passedPawn[r], &weights->passedPawn[r]);
-
-  ApplyCoeff(mg, eg, position->coeffs.passedPawnEdgeDistance, &weights->passedPawnEdgeDistance);
-  ApplyCoeff(mg, eg, position->coeffs.passedPawnKingProximity, &weights->passedPawnKingProximity);
-  ApplyCoeff(mg, eg, position->coeffs.passedPawnEnemySliderBehind, &weights->passedPawnEnemySliderBehind);
-  ApplyCoeff(mg, eg, position->coeffs.passedPawnSqRule, &weights->passedPawnSqRule);
-
-  for (int r = 0; r < 5; r++)
-    ApplyCoeff(mg, eg, position->coeffs.passedPawnAdvance[r], &weights->passedPawnAdvance[r]);
-}
-
-void EvaluatePawnShelterValues(double* mg, double* eg, Position* position, Weights* weights) {
-  for (int f = 0; f < 4; f++) {
-    for (int r = 0; r < 8; r++) {
-      ApplyCoeff(mg, eg, position->coeffs.pawnShelter[f][r], &weights->pawnShelter[f][r]);
-      ApplyCoeff(mg, eg, position->coeffs.pawnStorm[f][r], &weights->pawnStorm[f][r]);
-    }
-  }
-
-  for (int r = 0; r < 8; r++)
-    ApplyCoeff(mg, eg, position->coeffs.blockedPawnStorm[r], &weights->blockedPawnStorm[r]);
-
-  ApplyCoeff(mg, eg, position->coeffs.castlingRights, &weights->castlingRights);
+void EvaluateLinearValues(double* mg, double* eg, Position* position, Weights* weights) {
+  Weight* w = (Weight*)weights;
+  for (int i = 0; i < position->nCoeffs; i++)
+    ApplyCoeff(mg, eg, position->coeffs[i].coeff, &w[position->coeffs[i].index]);
 }
 
 void EvaluateSpaceValues(double* mg, double* eg, Position* position, Weights* weights) {
-  *mg += position->coeffs.space * weights->space.mg.value / 1024.0;
+  *mg += position->space * weights->space.mg.value / 1024.0;
 }
 
 void EvaluateKingSafetyValues(double* mg, double* eg, Position* position, Weights* weights, KSGradient* ks) {
@@ -947,31 +553,31 @@ void EvaluateKingSafetyValues(double* mg, double* eg, Position* position, Weight
   float bDanger = 0.0;
 
   for (int i = 1; i < 5; i++) {
-    wDanger += position->coeffs.ksAttackerWeights[WHITE][i] * position->coeffs.ksAttackerCount[WHITE] *
+    wDanger += position->kingSafety.ksAttackerWeights[WHITE][i] * position->kingSafety.ksAttackerCount[WHITE] *
                weights->ksAttackerWeight[i].mg.value;
-    bDanger += position->coeffs.ksAttackerWeights[BLACK][i] * position->coeffs.ksAttackerCount[BLACK] *
+    bDanger += position->kingSafety.ksAttackerWeights[BLACK][i] * position->kingSafety.ksAttackerCount[BLACK] *
                weights->ksAttackerWeight[i].mg.value;
   }
 
-  wDanger += position->coeffs.ksWeakSqs[WHITE] * weights->ksWeakSqs.mg.value;
-  wDanger += position->coeffs.ksPinned[WHITE] * weights->ksPinned.mg.value;
-  wDanger += position->coeffs.ksKnightCheck[WHITE] * weights->ksKnightCheck.mg.value;
-  wDanger += position->coeffs.ksBishopCheck[WHITE] * weights->ksBishopCheck.mg.value;
-  wDanger += position->coeffs.ksRookCheck[WHITE] * weights->ksRookCheck.mg.value;
-  wDanger += position->coeffs.ksQueenCheck[WHITE] * weights->ksQueenCheck.mg.value;
-  wDanger += position->coeffs.ksUnsafeCheck[WHITE] * weights->ksUnsafeCheck.mg.value;
-  wDanger += position->coeffs.ksEnemyQueen[WHITE] * weights->ksEnemyQueen.mg.value;
-  wDanger += position->coeffs.ksKnightDefense[WHITE] * weights->ksKnightDefense.mg.value;
-
-  bDanger += position->coeffs.ksWeakSqs[BLACK] * weights->ksWeakSqs.mg.value;
-  bDanger += position->coeffs.ksPinned[BLACK] * weights->ksPinned.mg.value;
-  bDanger += position->coeffs.ksKnightCheck[BLACK] * weights->ksKnightCheck.mg.value;
-  bDanger += position->coeffs.ksBishopCheck[BLACK] * weights->ksBishopCheck.mg.value;
-  bDanger += position->coeffs.ksRookCheck[BLACK] * weights->ksRookCheck.mg.value;
-  bDanger += position->coeffs.ksQueenCheck[BLACK] * weights->ksQueenCheck.mg.value;
-  bDanger += position->coeffs.ksUnsafeCheck[BLACK] * weights->ksUnsafeCheck.mg.value;
-  bDanger += position->coeffs.ksEnemyQueen[BLACK] * weights->ksEnemyQueen.mg.value;
-  bDanger += position->coeffs.ksKnightDefense[BLACK] * weights->ksKnightDefense.mg.value;
+  wDanger += position->kingSafety.ksWeakSqs[WHITE] * weights->ksWeakSqs.mg.value;
+  wDanger += position->kingSafety.ksPinned[WHITE] * weights->ksPinned.mg.value;
+  wDanger += position->kingSafety.ksKnightCheck[WHITE] * weights->ksKnightCheck.mg.value;
+  wDanger += position->kingSafety.ksBishopCheck[WHITE] * weights->ksBishopCheck.mg.value;
+  wDanger += position->kingSafety.ksRookCheck[WHITE] * weights->ksRookCheck.mg.value;
+  wDanger += position->kingSafety.ksQueenCheck[WHITE] * weights->ksQueenCheck.mg.value;
+  wDanger += position->kingSafety.ksUnsafeCheck[WHITE] * weights->ksUnsafeCheck.mg.value;
+  wDanger += position->kingSafety.ksEnemyQueen[WHITE] * weights->ksEnemyQueen.mg.value;
+  wDanger += position->kingSafety.ksKnightDefense[WHITE] * weights->ksKnightDefense.mg.value;
+
+  bDanger += position->kingSafety.ksWeakSqs[BLACK] * weights->ksWeakSqs.mg.value;
+  bDanger += position->kingSafety.ksPinned[BLACK] * weights->ksPinned.mg.value;
+  bDanger += position->kingSafety.ksKnightCheck[BLACK] * weights->ksKnightCheck.mg.value;
+  bDanger += position->kingSafety.ksBishopCheck[BLACK] * weights->ksBishopCheck.mg.value;
+  bDanger += position->kingSafety.ksRookCheck[BLACK] * weights->ksRookCheck.mg.value;
+  bDanger += position->kingSafety.ksQueenCheck[BLACK] * weights->ksQueenCheck.mg.value;
+  bDanger += position->kingSafety.ksUnsafeCheck[BLACK] * weights->ksUnsafeCheck.mg.value;
+  bDanger += position->kingSafety.ksEnemyQueen[BLACK] * weights->ksEnemyQueen.mg.value;
+  bDanger += position->kingSafety.ksKnightDefense[BLACK] * weights->ksKnightDefense.mg.value;
 
   *ks = (KSGradient){.wDanger = wDanger, .bDanger = bDanger};
 
@@ -998,19 +604,134 @@ void LoadPosition(Board* board, Position* position, ThreadData* thread) {
 
   position->scale = Scale(board, C.ss);
 
-  memcpy(&position->coeffs, &C, sizeof(EvalCoeffs));
+  // only the non zero linear terms are kept
+  CoeffEntry coeffs[N_WEIGHTS];
+  int n = 0;
+
+  for (size_t i = 0; i < sizeof(LINEAR_COEFFS) / sizeof(CoeffMap); i++) {
+    const CoeffMap* m = &LINEAR_COEFFS[i];
+
+    for (int j = 0; j < m->count; j++) {
+      const char* field = (const char*)&C + m->offset;
+      int coeff = m->size == 1 ? ((const int8_t*)field)[j] : ((const int16_t*)field)[j];
+
+      if (coeff)
+        coeffs[n++] = (CoeffEntry){.index = m->weight + j, .coeff = coeff};
+    }
+  }
+
+  position->nCoeffs = n;
+  position->coeffs = AllocCoeffs(n);
+  memcpy(position->coeffs, coeffs, sizeof(CoeffEntry) * n);
+
+  position->space = C.space;
+  for (int side = WHITE; side <= BLACK; side++) {
+    position->kingSafety.ksAttackerCount[side] = C.ksAttackerCount[side];
+    memcpy(position->kingSafety.ksAttackerWeights[side], C.ksAttackerWeights[side], 5);
+    position->kingSafety.ksWeakSqs[side] = C.ksWeakSqs[side];
+    position->kingSafety.ksPinned[side] = C.ksPinned[side];
+    position->kingSafety.ksKnightCheck[side] = C.ksKnightCheck[side];
+    position->kingSafety.ksBishopCheck[side] = C.ksBishopCheck[side];
+    position->kingSafety.ksRookCheck[side] = C.ksRookCheck[side];
+    position->kingSafety.ksQueenCheck[side] = C.ksQueenCheck[side];
+    position->kingSafety.ksUnsafeCheck[side] = C.ksUnsafeCheck[side];
+    position->kingSafety.ksEnemyQueen[side] = C.ksEnemyQueen[side];
+    position->kingSafety.ksKnightDefense[side] = C.ksKnightDefense[side];
+  }
+}
+
+// Coefficient lists are carved out of large blocks, one in use per loading thread
+CoeffEntry* AllocCoeffs(int n) {
+  if (!coeffBlock || coeffBlockUsed + n > COEFF_BLOCK_SIZE) {
+    coeffBlock = malloc(sizeof(CoeffEntry) * COEFF_BLOCK_SIZE);
+    coeffBlockUsed = 0;
+
+#pragma omp critical
+    {
+      coeffBlocks = realloc(coeffBlocks, sizeof(CoeffEntry*) * (nCoeffBlocks + 1));
+      coeffBlocks[nCoeffBlocks++] = coeffBlock;
+    }
+  }
+
+  CoeffEntry* coeffs = coeffBlock + coeffBlockUsed;
+  coeffBlockUsed += n;
+  return coeffs;
+}
+
+void FreeCoeffs() {
+  for (int i = 0; i < nCoeffBlocks; i++)
+    free(coeffBlocks[i]);
+
+  free(coeffBlocks);
+  coeffBlocks = NULL;
+  nCoeffBlocks = 0;
+  coeffBlock = NULL;
+}
+
+// Fills in the position if it is one to train on, the coefficients
+// are checked against the real evaluation on the way
+int LoadTrainingPosition(Board* board, Position* position, float result, Weights* weights, ThreadData* thread) {
+  if (board->checkers)
+    return 0;
+
+  if (!(board->pieces[PAWN_WHITE] | board->pieces[PAWN_BLACK]))
+    return 0;
+
+  if (bits(board->occupancies[BOTH]) == 3 && (board->pieces[PAWN_WHITE] | board->pieces[PAWN_BLACK]))
+    return 0;
+
+  position->result = result;
+  LoadPosition(board, position, thread);
+  if (abs(position->staticEval) > 3000)
+    return 0;
+
+  KSGradient ks;
+  double eval = EvaluateCoeffs(position, weights, &ks);
+  if (floor(fabs(position->staticEval - eval)) > 3) {
+    char fen[128];
+    BoardToFen(fen, board);
+
+    printf("The coefficient based evaluation does NOT match the eval!\n");
+    printf("FEN: %s\n", fen);
+    printf("Static: %d, Coeffs: %f\n", position->staticEval, eval);
+    exit(1);
+  }
+
+  return 1;
+}
+
+// packed files are recognised by their extension
+Position* LoadPositions(int* n, Weights* weights, char* path) {
+  size_t length = strlen(path);
+  if (length > 4 && !strcmp(path + length - 4, ".bin"))
+    return LoadPackedPositions(n, weights, path);
+
+  return LoadTextPositions(n, weights, path);
 }
 
-Position* LoadPositions(int* n, Weights* weights) {
+float ParseResult(char* line) {
+  if (strstr(line, "[1.0]"))
+    return 1.0;
+  else if (strstr(line, "[0.5]"))
+    return 0.5;
+  else if (strstr(line, "[0.0]"))
+    return 0.0;
+
+  printf("Cannot Parse %s\n", line);
+  exit(EXIT_FAILURE);
+}
+
+Position* LoadTextPositions(int* n, Weights* weights, char* path) {
   FILE* fp;
-  fp = fopen(EPD_FILE_PATH, "r");
+  fp = fopen(path, "r");
 
   if (fp == NULL)
     return NULL;
 
-  Position* positions = calloc(MAX_POSITIONS, sizeof(Position));
+  // grown as needed, the position count in a text file is unknown up front
+  int size = 1 << 16;
+  Position* positions = malloc(sizeof(Position) * size);
 
-  KSGradient ks;
   Board board;
   ThreadData* threads = CreatePool(1);
 
@@ -1018,52 +739,140 @@ Position* LoadPositions(int* n, Weights* weights) {
 
   int p = 0;
   while (p < MAX_POSITIONS && fgets(buffer, 128, fp)) {
-    if (strstr(buffer, "[1.0]"))
-      positions[p].result = 1.0;
-    else if (strstr(buffer, "[0.5]"))
-      positions[p].result = 0.5;
-    else if (strstr(buffer, "[0.0]"))
-      positions[p].result = 0.0;
-    else {
-      printf("Cannot Parse %s\n", buffer);
-      exit(EXIT_FAILURE);
-    }
-
+    float result = ParseResult(buffer);
     ParseFen(buffer, &board);
 
-    if (board.checkers)
-      continue;
+    if (p == size) {
+      size = min(MAX_POSITIONS, 2 * size);
+      positions = realloc(positions, sizeof(Position) * size);
+    }
 
-    if (!(board.pieces[PAWN_WHITE] | board.pieces[PAWN_BLACK]))
+    if (!LoadTrainingPosition(&board, &positions[p], result, weights, threads))
       continue;
 
-    if (bits(board.occupancies[BOTH]) == 3 && (board.pieces[PAWN_WHITE] | board.pieces[PAWN_BLACK]))
-      continue;
+    if (!(++p & 4095))
+      printf("Loaded %d positions...\r", p);
+  }
 
-    LoadPosition(&board, &positions[p], threads);
-    if (abs(positions[p].staticEval) > 3000)
-      continue;
+  printf("Successfully loaded %d positions.\n", p);
+
+  *n = p;
+
+  fclose(fp);
+  FreePool(threads);
+
+  positions = realloc(positions, sizeof(Position) * max(1, p));
+  return positions;
+}
+
+// The packed file is mapped and split across the OpenMP threads, each with its
+// own board and eval context. Only the positions the file holds are allocated
+Position* LoadPackedPositions(int* n, Weights* weights, char* path) {
+  PackedPosition* packed = NULL;
+  size_t size = 0;
 
-    double eval = EvaluateCoeffs(&positions[p], weights, &ks);
-    if (floor(fabs(positions[p].staticEval - eval)) > 3) {
-      printf("The coefficient based evaluation does NOT match the eval!\n");
-      printf("FEN: %s\n", buffer);
-      printf("Static: %d, Coeffs: %f\n", positions[p].staticEval, eval);
-      exit(1);
+#if defined(__linux__)
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  struct stat st;
+  if (!fstat(fd, &st) && st.st_size > 0) {
+    size = st.st_size;
+    packed = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (packed == MAP_FAILED)
+      packed = NULL;
+    else
+      madvise(packed, size, MADV_SEQUENTIAL);
+  }
+  close(fd);
+#endif
+
+  if (!packed) {
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL)
+      return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    packed = malloc(size);
+    if (fread(packed, 1, size, fp) != size) {
+      fclose(fp);
+      free(packed);
+      return NULL;
     }
+    fclose(fp);
+  }
 
-    if (!(++p & 4095))
-      printf("Loaded %d positions...\r", p);
+  int count = min(MAX_POSITIONS, (int)(size / sizeof(PackedPosition)));
+  Position* positions = malloc(sizeof(Position) * max(1, count));
+  uint8_t* keep = calloc(max(1, count), 1);
+
+  ThreadData* threads = CreatePool(TUNE_THREADS);
+
+#pragma omp parallel for schedule(dynamic, 4096) num_threads(TUNE_THREADS)
+  for (int i = 0; i < count; i++) {
+    Board board;
+    float result = UnpackPosition(&packed[i], &board);
+    keep[i] = LoadTrainingPosition(&board, &positions[i], result, weights, &threads[omp_get_thread_num()]);
   }
 
+  int p = 0;
+  for (int i = 0; i < count; i++)
+    if (keep[i])
+      positions[p++] = positions[i];
+
   printf("Successfully loaded %d positions.\n", p);
 
   *n = p;
 
-  positions = realloc(positions, sizeof(Position) * p);
+  FreePool(threads);
+  free(keep);
+
+#if defined(__linux__)
+  munmap(packed, size);
+#else
+  free(packed);
+#endif
+
+  positions = realloc(positions, sizeof(Position) * max(1, p));
   return positions;
 }
 
+// text positions to the packed format, berserk convert <in> <out.bin>
+void ConvertPositions(char* in, char* out) {
+  FILE* fin = fopen(in, "r");
+  FILE* fout = fopen(out, "wb");
+
+  if (fin == NULL || fout == NULL) {
+    printf("Unable to open %s or %s\n", in, out);
+    exit(EXIT_FAILURE);
+  }
+
+  Board board;
+  PackedPosition packed;
+  char buffer[128];
+
+  int p = 0;
+  while (fgets(buffer, 128, fin)) {
+    float result = ParseResult(buffer);
+    ParseFen(buffer, &board);
+
+    PackPosition(&packed, &board, result, 0);
+    fwrite(&packed, sizeof(PackedPosition), 1, fout);
+
+    if (!(++p & 65535))
+      printf("Converted %d positions...\r", p);
+  }
+
+  printf("Converted %d positions.\n", p);
+
+  fclose(fin);
+  fclose(fout);
+}
+
 void InitMaterialWeights(Weights* weights) {
   for (int pc = PAWN_TYPE; pc < KING_TYPE; pc++) {
     weights->pieces[pc].mg.value = scoreMG(MATERIAL_VALUES[pc]);
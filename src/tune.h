@@ -24,7 +24,6 @@
 #include "types.h"
 
 #define EPD_FILE_PATH "C:\\Programming\\berserk-testing\\texel\\lichess-big3-resolved.book"
-#define THREADS 24
 #define TUNE_KS 0
 
 typedef struct {
@@ -108,6 +107,37 @@ typedef struct {
   Weight ksKnightDefense;
 } Weights;
 
+#define N_WEIGHTS ((int)(sizeof(Weights) / sizeof(Weight)))
+#define COEFF_BLOCK_SIZE (1 << 20)
+
+// a non zero white minus black coefficient of the Weight at index in the flattened Weights
+typedef struct {
+  uint16_t index;
+  int16_t coeff;
+} CoeffEntry;
+
+typedef struct {
+  size_t offset; // into EvalCoeffs
+  int size;      // bytes per coefficient
+  int count;
+  int weight; // first index in the flattened Weights
+} CoeffMap;
+
+// the per side king safety inputs, which are not linear in the weights
+typedef struct {
+  int8_t ksAttackerCount[2];
+  int8_t ksAttackerWeights[2][5];
+  int8_t ksWeakSqs[2];
+  int8_t ksPinned[2];
+  int8_t ksKnightCheck[2];
+  int8_t ksBishopCheck[2];
+  int8_t ksRookCheck[2];
+  int8_t ksQueenCheck[2];
+  int8_t ksUnsafeCheck[2];
+  int8_t ksEnemyQueen[2];
+  int8_t ksKnightDefense[2];
+} KSCoeffs;
+
 typedef struct {
   uint8_t phase;
   int8_t stm;
@@ -116,7 +146,10 @@ typedef struct {
   float phaseMg;
   float phaseEg;
   Score staticEval;
-  EvalCoeffs coeffs;
+  int16_t space;
+  uint16_t nCoeffs;
+  KSCoeffs kingSafety;
+  CoeffEntry* coeffs;
 } Position;
 
 typedef struct {
@@ -131,7 +164,7 @@ typedef struct {
   Weights* weights;
 } GradientUpdate;
 
-void Tune();
+void Tune(char* path, int threads, int batchSize);
 
 void ValidateEval(int n, Position* positions, Weights* weights);
 void ComputeK(int n, Position* positions);
@@ -141,32 +174,18 @@ void UpdateParam(Param* p);
 void UpdateWeight(Weight* w);
 void UpdateWeights(Weights* weights);
 void MergeWeightGradients(Weight* dest, Weight* src);
-double UpdateAndTrain(int epoch, int n, Position* positions, Weights* weights);
+void MergeGradients(Weights* dest, Weights* src);
+double UpdateAndTrain(int n, Position* positions, Weights* weights, Weights* local);
+void ShufflePositions(int n, Position* positions);
 
 void* UpdateGradients(void* arg);
-void UpdateMaterialGradients(Position* position, double loss, Weights* weights);
-void UpdatePsqtGradients(Position* position, double loss, Weights* weights);
-void UpdatePostPsqtGradients(Position* position, double loss, Weights* weights);
-void UpdateMobilityGradients(Position* position, double loss, Weights* weights);
-void UpdateThreatGradients(Position* position, double loss, Weights* weights);
-void UpdatePieceBonusGradients(Position* position, double loss, Weights* weights);
-void UpdatePawnBonusGradients(Position* position, double loss, Weights* weights);
-void UpdatePasserBonusGradients(Position* position, double loss, Weights* weights);
-void UpdatePawnShelterGradients(Position* position, double loss, Weights* weights);
+void UpdateLinearGradients(Position* position, double loss, Weights* weights);
 void UpdateSpaceGradients(Position* position, double loss, Weights* weights);
 void UpdateKingSafetyGradients(Position* position, double loss, Weights* weights, KSGradient* ks);
 
 void ApplyCoeff(double* mg, double* eg, int coeff, Weight* w);
 double EvaluateCoeffs(Position* position, Weights* weights, KSGradient* ks);
-void EvaluateMaterialValues(double* mg, double* eg, Position* position, Weights* weights);
-void EvaluatePsqtValues(double* mg, double* eg, Position* position, Weights* weights);
-void EvaluatePostPsqtValues(double* mg, double* eg, Position* position, Weights* weights);
-void EvaluateMobilityValues(double* mg, double* eg, Position* position, Weights* weights);
-void EvaluateThreatValues(double* mg, double* eg, Position* position, Weights* weights);
-void EvaluatePieceBonusValues(double* mg, double* eg, Position* position, Weights* weights);
-void EvaluatePawnBonusValues(double* mg, double* eg, Position* position, Weights* weights);
-void EvaluatePasserBonusValues(double* mg, double* eg, Position* position, Weights* weights);
-void EvaluatePawnShelterValues(double* mg, double* eg, Position* position, Weights* weights);
+void EvaluateLinearValues(double* mg, double* eg, Position* position, Weights* weights);
 void EvaluateSpaceValues(double* mg, double* eg, Position* position, Weights* weights);
 void EvaluateKingSafetyValues(double* mg, double* eg, Position* position, Weights* weights, KSGradient* ks);
 
@@ -184,7 +203,14 @@ void InitSpaceWeights(Weights* weights);
 void InitKingSafetyWeights(Weights* weights);
 
 void LoadPosition(Board* board, Position* position, ThreadData* thread);
-Position* LoadPositions(int* n, Weights* weights);
+CoeffEntry* AllocCoeffs(int n);
+void FreeCoeffs();
+int LoadTrainingPosition(Board* board, Position* position, float result, Weights* weights, ThreadData* thread);
+Position* LoadPositions(int* n, Weights* weights, char* path);
+Position* LoadTextPositions(int* n, Weights* weights, char* path);
+Position* LoadPackedPositions(int* n, Weights* weights, char* path);
+float ParseResult(char* line);
+void ConvertPositions(char* in, char* out);
 
 double Sigmoid(double s);
 
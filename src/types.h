@@ -17,26 +17,36 @@
 #ifndef TYPES_H
 #define TYPES_H
 
-#include <setjmp.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #ifdef TUNE
 #define MAX_SEARCH_PLY 16
 #define MAX_MOVES 256
-#define MAX_GAME_PLY 32
+#define BOARD_HISTORY_SIZE 32
 #else
 #define MAX_SEARCH_PLY INT8_MAX
 #define MAX_MOVES 256
-#define MAX_GAME_PLY 1024
+#define BOARD_HISTORY_SIZE 256
 #endif
 
-#ifdef TUNE
-#define PAWN_TABLE_MASK (0x1)
-#define PAWN_TABLE_SIZE (1ULL << 1)
-#else
-#define PAWN_TABLE_MASK (0xFFFF)
-#define PAWN_TABLE_SIZE (1ULL << 16)
-#endif
+#define MAX_MULTI_PV 64
+
+// Board history is a ring, it only has to reach back over the reversible moves
+// for repetitions plus the moves search will undo, so it must exceed both the
+// 50 move window and MAX_SEARCH_PLY
+#define BOARD_HISTORY_MASK (BOARD_HISTORY_SIZE - 1)
+
+#define PAWN_BUCKET_SIZE 2
+#define MATERIAL_TABLE_BITS 13
+#define NNUE_HIDDEN 256
+#define NNUE_MAX_REPLAY 8 // moves an accumulator is updated over before refreshing instead
+#define NO_SHELTER 64 // shelterKingSq when the shelter has not been computed
+
+// shared data that is written during a search gets a line to itself
+#define CACHE_LINE 64
+#define CACHE_ALIGN _Alignas(CACHE_LINE)
 
 typedef int Score;
 
@@ -44,8 +54,20 @@ typedef uint64_t BitBoard;
 
 typedef uint32_t Move;
 
-
-
+// Everything that can't be recovered from a move when it is undone,
+// MakeMove pushes one of these per ply and UndoMove pops it
+typedef struct {
+  uint64_t zobrist;
+  uint64_t pawnHash;
+  BitBoard checkers;
+  BitBoard pinned;
+  Score mat;
+  int16_t halfMove;
+  uint8_t castling;
+  uint8_t epSquare;
+  uint8_t capture;
+  Move move; // the move made from here, NULL_MOVE for a null move
+} BoardState;
 
 typedef struct {
   BitBoard pieces[12];     // individual piece data
@@ -67,16 +89,14 @@ typedef struct {
   uint64_t zobrist; // zobrist hash of the position
   uint64_t pawnHash;
 
-  // data that is hard to track, so it is "remembered" when search undoes moves
-  int castlingHistory[MAX_GAME_PLY];
-  int epSquareHistory[MAX_GAME_PLY];
-  int captureHistory[MAX_GAME_PLY];
-  int halfMoveHistory[MAX_GAME_PLY];
-  Score materialHistory[MAX_GAME_PLY];
-  uint64_t zobristHistory[MAX_GAME_PLY];
-  uint64_t pawnHashHistory[MAX_GAME_PLY];
-  BitBoard checkersHistory[MAX_GAME_PLY];
-  BitBoard pinnedHistory[MAX_GAME_PLY];
+  // mobility attacks of the slider on each square (see SliderAttacks), moves only
+  // record the squares they change and eval brings these up to date when needed
+  BitBoard sliderAttacks[64];
+  BitBoard sliderDirty;
+
+  // data that is hard to track, so it is "remembered" when search undoes moves,
+  // indexed by moveNo & BOARD_HISTORY_MASK
+  BoardState history[BOARD_HISTORY_SIZE];
 } Board;
 
 // Tracking the principal variation
@@ -85,6 +105,48 @@ typedef struct {
   Move moves[MAX_SEARCH_PLY];
 } PV;
 
+// A legal move at the root and what the last iteration learned about it
+typedef struct {
+  Move move;
+  int score;      // score of its last search, -CHECKMATE unless it raised alpha
+  uint64_t nodes; // nodes spent below it during the last iteration
+} RootMove;
+
+// correction history entries are in 1/256ths of a centipawn, with room for +-64cp
+#define CORRECTION_SIZE 16384
+#define CORRECTION_GRAIN 256
+#define CORRECTION_MAX (64 * CORRECTION_GRAIN)
+
+// History heuristics, kept out of SearchData so that each thread can allocate
+// (and first touch) its own copy only once it actually searches.
+// Entries are bounded by AddHistoryHeuristic to fit 16 bits
+typedef struct {
+  int16_t hh[2][64 * 64];    // history heuristic butterfly table (side)
+  int16_t caph[12][64][6];   // capture history table [piece][to][captured type]
+  int16_t ch[6][64][6][64];  // counter move history table
+  int16_t fh[6][64][6][64];  // follow up history table
+  int16_t fh4[6][64][6][64]; // follow up history of the move 4 plies back
+  int16_t gatherPad[2];      // 32 bit gathers of the last fh4 entry stay in bounds
+} HistoryTables;
+
+// Subsystems timed by a PROFILE build
+enum {
+  PROFILE_SEARCH, // the whole of the iterative deepening, the other phases are part of it
+  PROFILE_TACTICAL_MOVES,
+  PROFILE_QUIET_MOVES,
+  PROFILE_MAKE_MOVE,
+  PROFILE_UNDO_MOVE,
+  PROFILE_SEE,
+  PROFILE_EVAL,
+  PROFILE_TT_PROBE,
+  PROFILE_PHASES
+};
+
+typedef struct {
+  uint64_t cycles[PROFILE_PHASES];
+  uint64_t calls[PROFILE_PHASES];
+} ProfileData;
+
 // A general data object for use during search
 typedef struct {
   int score;     // analysis score result, from perspective of stm
@@ -93,20 +155,33 @@ typedef struct {
   Board* board; // reference to board
   int ply;      // ply depth of active search
 
-  // TODO: Put depth here as well? Just cause
-  uint64_t nodes; // node count
+  int depth;   // last completed depth
+  int stopped; // set once this thread has used up its node budget
+
+  // hot counters that other threads poll for reporting, on their own line
+  CACHE_ALIGN uint64_t nodes; // node count
   uint64_t tbhits;
   int seldepth; // seldepth count
 
-  Move skipMove[MAX_SEARCH_PLY]; // moves to skip during singular search
+  CACHE_ALIGN Move skipMove[MAX_SEARCH_PLY]; // moves to skip during singular search
   int evals[MAX_SEARCH_PLY];     // static evals at ply stack
   Move moves[MAX_SEARCH_PLY];    // moves for ply stack
 
   Move killers[MAX_SEARCH_PLY][2]; // killer moves, 2 per ply
+  int killersMoveNo;               // board moveNo of the root the killers were found from
   Move counters[64 * 64];          // counter move butterfly table
-  int hh[2][64 * 64];              // history heuristic butterfly table (side)
-  int ch[6][64][6][64];            // counter move history table
-  int fh[6][64][6][64];            // follow up history table
+
+  int16_t corrections[2][CORRECTION_SIZE]; // static eval error by pawn structure (side), see GetCorrection
+  HistoryTables* hist;             // NULL until the thread first searches
+
+  int multiPV, pvIdx;         // lines searched and the one being searched
+  int hashfull;               // TTFull of the current iteration, kept by the main thread
+  int pvScores[MAX_MULTI_PV]; // last completed score of each line
+  PV pvs[MAX_MULTI_PV];       // and its pv, ordered best first
+
+#ifdef PROFILE
+  ProfileData profile; // time spent per subsystem, see profile.h
+#endif
 } SearchData;
 
 typedef struct {
@@ -184,14 +259,31 @@ typedef struct {
 
 typedef struct {
   long start;
-  int alloc;
-  int max;
+  int alloc; // soft limit, weighed by the time manager between depths
+  int max;   // hard limit, enforced by the timer thread
 
   int timeset;
   int depth;
+  uint64_t nodes; // per thread node budget, 0 for none
   int movesToGo;
-  int stopped;
   int quit;
+  int quiet; // no uci output and no book or tablebase root moves, for datagen
+  int sharedTT; // searches run side by side on the table, the one driving them ages it
+  int clusterIdx; // node of a cluster search, 0 on the master, see ClusterGo
+
+  int numSearchMoves; // uci "searchmoves", the root is limited to these when set
+  Move searchMoves[MAX_MOVES];
+
+  // time manager state, owned by the main thread, see TMStop
+  Move tmBestMove; // best move of the last completed depth
+  int tmStability; // depths in a row it has stayed best
+  int tmScore;     // score of the last completed depth
+
+  // raised by the timer, uci or main thread and read by every searcher,
+  // kept clear of the time manager state the main thread updates
+  CACHE_ALIGN atomic_int stopped;
+  atomic_int ponder;          // searching on the opponent's time, the clock is not ours yet
+  atomic_int stopOnPonderhit; // the time manager would have stopped, see TMPonderHit
 } SearchParams;
 
 typedef struct {
@@ -208,35 +300,116 @@ typedef struct {
 
   BitBoard mobilitySquares[2];
   BitBoard outposts[2];
+
+  struct PawnHashEntry* pawnEntry; // entry for this pawn structure, NULL if not cached
 } EvalData;
 
-typedef struct {
-  Score s;
+// King shelter only depends on the pawns and the king square, so it is
+// cached alongside the pawn eval for the king square it was computed with
+typedef struct PawnHashEntry {
   uint64_t hash;
   BitBoard passedPawns;
+  Score s;
+  Score shelter[2];
+  uint8_t shelterKingSq[2];
 } PawnHashEntry;
 
+// most recently written entry first, 2 x 32 bytes is one cache line
+typedef struct {
+  PawnHashEntry entries[PAWN_BUCKET_SIZE];
+} PawnHashBucket;
+
+typedef struct {
+  uint32_t key; // upper 32 bits of the zobrist, the lower ones index the table
+  Score eval;
+} EvalHashEntry;
+
+// First layer of the network for both perspectives, valid for the
+// position with the zobrist key
+typedef struct {
+  CACHE_ALIGN int16_t values[2][NNUE_HIDDEN];
+  uint64_t key;
+} Accumulator;
+
+typedef int (*EndgameEval)(Board* board);
+
+typedef struct {
+  uint64_t key;        // board->piecesCounts
+  Score imbalance;     // white - black
+  EndgameEval endgame; // specialised evaluation for this material, NULL if none
+  uint8_t filled, draw, phase;
+  uint8_t ocbCandidate; // a bishop each and pawns only, IsOCB decides the rest
+  uint8_t scale[2];     // MaterialScale for either side being the stronger one
+} MaterialEntry;
+
+// Training positions in 32 bytes, as written by datagen and the tuner's converter.
+// Pieces are 4 bit codes in the order of the occupied squares (a8 first)
+typedef struct {
+  BitBoard occupancy;
+  uint8_t pieces[16];
+  uint8_t flags; // side (1) | castling (4) | result in half points from white's view (2)
+  uint8_t epSquare;
+  uint16_t halfMove;
+  int16_t score; // search score from white's view, 0 if unknown
+  uint8_t reserved[2];
+} PackedPosition;
+
+// Search counters of a STATS build, kept per thread and summed when printed
+typedef struct {
+  uint64_t nodes;
+  uint64_t ttProbes, ttHits, ttCutoffs;
+  uint64_t rfpPrunes;
+  uint64_t nullTries, nullCutoffs;
+  uint64_t probcutTries, probcutCutoffs;
+  uint64_t seTries, seExtensions;
+  uint64_t lmrSearches, lmrResearches;
+  uint64_t failHighs, firstMoveFailHighs;
+  uint64_t depthNodes[MAX_SEARCH_PLY + 1]; // nodes from the root until the depth completed
+  uint64_t depthCount[MAX_SEARCH_PLY + 1];
+} SearchStats;
+
 typedef struct ThreadData ThreadData;
 
+// Aligned so that no two threads ever share a cache line
 struct ThreadData {
-  int count, idx;
+  CACHE_ALIGN int count, idx;
   ThreadData* threads;
-  jmp_buf exit;
 
-  SearchParams* params;
+  // native thread that lives for the life of the pool, it is parked
+  // on the condition variable until it is given a job
+  CACHE_ALIGN pthread_t nativeThread;
+  pthread_mutex_t mutex;
+  pthread_cond_t sleep;
+  void* (*job)(void*); // work to run when woken, NULL while parked
+  int destroy;         // set when the pool is being torn down
+
+  CACHE_ALIGN SearchParams* params;
   SearchData data;
 
-  PawnHashEntry pawnHashTable[PAWN_TABLE_SIZE];
+  PawnHashBucket* pawnHashTable; // sized by PAWN_HASH_MB, allocated by the thread itself
+  uint64_t pawnHashMask;
+  uint64_t pawnProbes, pawnHits;
+  uint64_t qsNodes, lazyEvals;
+
+#ifdef STATS
+  SearchStats stats;
+#endif
+
+  MaterialEntry materialTable[1 << MATERIAL_TABLE_BITS];
+
+  EvalHashEntry* evalHashTable; // sized by EVAL_HASH_MB, allocated by the thread itself
+  uint64_t evalHashMask;
+
+  // nnue first layer outputs, indexed like board->history
+  Accumulator accumulators[BOARD_HISTORY_SIZE];
 
   Board board;
-  PV pv;
-};
+  PV pv; // pv of the last completed depth
 
-typedef struct {
-  Board* board;
-  SearchParams* params;
-  ThreadData* threads;
-} SearchArgs;
+  // moves searched at the root, reordered between iterations
+  int numRootMoves;
+  RootMove rootMoves[MAX_MOVES];
+};
 
 // Move generation storage
 // moves/scores idx's match
@@ -255,16 +428,20 @@ enum {
     NO_MORE_MOVES
 };
 
+typedef struct {
+  Move move;
+  int score;
+} ScoredMove;
+
+// A single array holds every stage: good tacticals from the front, bad tacticals
+// from the back and quiets from the front again once the good tacticals are played
 typedef struct {
   SearchData* data;
   Move hashMove, killer1, killer2, counter;
   int seeCutoff;
-  uint8_t type, phase, nTactical, nQuiets, nBadTactical;
+  uint8_t type, phase, nTactical, nQuiets, nBadTactical, quietIdx;
 
-  Move tactical[MAX_MOVES];
-  Move quiet[MAX_MOVES];
-  int sTactical[MAX_MOVES];
-  int sQuiet[MAX_MOVES];
+  ScoredMove moves[MAX_MOVES];
 } MoveList;
 
 enum { WHITE, BLACK, BOTH };
@@ -14,21 +14,32 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
-#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "board.h"
+#include "book.h"
+#include "cluster.h"
+#include "cpu.h"
 #include "eval.h"
 #include "move.h"
 #include "movegen.h"
 #include "movepick.h"
+#include "nnue.h"
 #include "noobprobe/noobprobe.h"
+#include "numa.h"
+#include "output.h"
+#include "params.h"
+#include "pawns.h"
 #include "perft.h"
+#include "profile.h"
 #include "pyrrhic/tbprobe.h"
 #include "search.h"
+#include "stats.h"
+#include "tb.h"
 #include "thread.h"
+#include "timeman.h"
 #include "transposition.h"
 #include "uci.h"
 #include "util.h"
@@ -38,23 +49,33 @@
 
 #define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
 
-int MOVE_OVERHEAD = 100;
-
 // uci "go" command
 void ParseGo(char* in, SearchParams* params, Board* board, ThreadData* threads) {
   in += 3;
 
+  // a search may still be winding down
+  ThreadWaitUntilSleep(threads);
+
   params->depth = MAX_SEARCH_PLY;
   params->start = GetTimeMS();
   params->timeset = 0;
+  params->nodes = 0;
   params->stopped = 0;
   params->quit = 0;
+  params->numSearchMoves = 0;
+  params->ponder = !!strstr(in, "ponder");
+  params->stopOnPonderhit = 0;
 
   char* ptrChar = in;
-  int perft = 0, movesToGo = 30, moveTime = -1, time = -1, inc = 0, depth = -1;
+  int perft = 0, perftHash = 0, movesToGo = 30, moveTime = -1, time = -1, inc = 0, depth = -1;
+
+  if ((ptrChar = strstr(in, "perft")) && (perft = atoi(ptrChar + 6)) < 1) {
+    printf("info string perft needs a depth of at least 1\n");
+    return;
+  }
 
-  if ((ptrChar = strstr(in, "perft")))
-    perft = atoi(ptrChar + 6);
+  if (perft && (ptrChar = strstr(in, "hash")))
+    perftHash = atoi(ptrChar + 5);
 
   if ((ptrChar = strstr(in, "binc")) && board->side == BLACK)
     inc = atoi(ptrChar + 5);
@@ -77,33 +98,31 @@ void ParseGo(char* in, SearchParams* params, Board* board, ThreadData* threads)
   if ((ptrChar = strstr(in, "depth")))
     depth = min(MAX_SEARCH_PLY - 1, atoi(ptrChar + 6));
 
+  if ((ptrChar = strstr(in, "nodes")))
+    params->nodes = strtoull(ptrChar + 6, NULL, 10);
+
+  // a list of moves up to the next token that is not one
+  if ((ptrChar = strstr(in, "searchmoves"))) {
+    ptrChar += 11;
+
+    Move move;
+    while (*ptrChar == ' ' && (move = ParseMove(ptrChar + 1, board)) && params->numSearchMoves < MAX_MOVES) {
+      params->searchMoves[params->numSearchMoves++] = move;
+
+      ptrChar++;
+      while (*ptrChar && *ptrChar != ' ')
+        ptrChar++;
+    }
+  }
+
   if (perft) {
-    PerftTest(perft, board);
+    PerftTest(perft, perftHash, board, threads);
     return;
   }
 
   params->depth = depth;
 
-  // "movetime" is essentially making a move with 1 to go for TC
-  if (moveTime != -1) {
-    params->timeset = 1;
-    params->alloc = moveTime;
-    params->max = moveTime;
-  } else {
-    if (time != -1) {
-      params->timeset = 1;
-
-      time = max(0, time - MOVE_OVERHEAD);
-      int spend = time / movesToGo + inc;
-      spend = max(1, spend);
-
-      params->max = min(4 * spend, time * 0.9);
-      params->alloc = min(spend, params->max / 3);
-    } else {
-      // no time control
-      params->timeset = 0;
-    }
-  }
+  TMInit(params, time, inc, movesToGo, moveTime);
 
   if (depth <= 0)
     params->depth = MAX_SEARCH_PLY - 1;
@@ -111,16 +130,10 @@ void ParseGo(char* in, SearchParams* params, Board* board, ThreadData* threads)
   printf("time %d start %ld alloc %d depth %d timeset %d\n", time, params->start, params->alloc, params->depth,
          params->timeset);
 
-  // this MUST be freed from within the search, or else massive leak
-  SearchArgs* args = malloc(sizeof(SearchArgs));
-  args->board = board;
-  args->params = params;
-  args->threads = threads;
-
-  // start the search!
-  pthread_t searchThread;
-  pthread_create(&searchThread, NULL, &UCISearch, args);
-  pthread_detach(searchThread);
+  // start the search on the main pool thread from its own copy of the board
+  memcpy(&threads->board, board, sizeof(Board));
+  threads->params = params;
+  ThreadWake(threads, UCISearch);
 }
 
 // uci "position" command
@@ -164,9 +177,23 @@ void PrintUCIOptions() {
   printf("id author Jay Honnold\n");
   printf("option name Hash type spin default 32 min 4 max 65536\n");
   printf("option name Threads type spin default 1 min 1 max 256\n");
+  printf("option name MultiPV type spin default 1 min 1 max %d\n", MAX_MULTI_PV);
+  printf("option name InfoInterval type spin default 50 min 0 max 5000\n");
+  printf("option name Ponder type check default false\n");
+  printf("option name BookFile type string default <empty>\n");
   printf("option name NoobBookLimit type spin default 8 min 0 max 32\n");
   printf("option name NoobBook type check default false\n");
+  printf("option name NoobBookTimeout type spin default 2000 min 100 max 60000\n");
+  printf("option name NoobBookCache type string default <empty>\n");
   printf("option name SyzygyPath type string default <empty>\n");
+  printf("option name SyzygyCache type spin default 4 min 0 max 1024\n");
+  printf("option name SyzygyPreload type spin default 0 min 0 max 7\n");
+  printf("option name SharedHash type string default <empty>\n");
+  printf("option name EvalHash type spin default 2 min 1 max 256\n");
+  printf("option name PawnHash type spin default 2 min 1 max 256\n");
+  printf("option name EvalFile type string default %s\n", USE_NNUE ? "<embedded>" : "<empty>");
+  printf("option name NUMA type check default false\n");
+  printf("option name ClusterNodes type string default <empty>\n");
   printf("uciok\n");
 }
 
@@ -193,6 +220,9 @@ void UCILoop() {
   setbuf(stdin, NULL);
   setbuf(stdout, NULL);
 
+  // search output goes through its own writer from here on
+  OutputStart();
+
   while (ReadLine(in)) {
     if (in[0] == '\n')
       continue;
@@ -202,19 +232,69 @@ void UCILoop() {
     } else if (!strncmp(in, "position", 8)) {
       ParsePosition(in, &board);
     } else if (!strncmp(in, "ucinewgame", 10)) {
+      ThreadWaitUntilSleep(threads);
       ParsePosition("position startpos\n", &board);
-      TTClear();
+      // other processes may still be using a shared table
+      if (TT.alloc != TT_ALLOC_SHARED)
+        TTClear(threads);
       ResetThreadPool(&board, &searchParameters, threads);
       failedQueries = 0;
     } else if (!strncmp(in, "go", 2)) {
       ParseGo(in, &searchParameters, &board, threads);
+    } else if (!strncmp(in, "ponderhit", 9)) {
+      TMPonderHit(&searchParameters);
     } else if (!strncmp(in, "stop", 4)) {
+      // also a ponder miss, the search ends and its move is discarded
+      searchParameters.ponder = 0;
       searchParameters.stopped = 1;
     } else if (!strncmp(in, "quit", 4)) {
       searchParameters.quit = 1;
+      searchParameters.stopped = 1;
       break;
+    } else if (!strncmp(in, "savehash ", 9)) {
+      ThreadWaitUntilSleep(threads);
+      in[strcspn(in, "\n")] = '\0';
+
+      if (TTSave(in + 9))
+        printf("info string saved hash to %s\n", in + 9);
+      else
+        printf("info string FAILED to save hash to %s\n", in + 9);
+    } else if (!strncmp(in, "loadhash ", 9)) {
+      ThreadWaitUntilSleep(threads);
+      in[strcspn(in, "\n")] = '\0';
+
+      if (TTLoad(in + 9, threads))
+        printf("info string loaded hash from %s (%" PRIu64 " MB)\n", in + 9, TT.size);
+      else
+        printf("info string FAILED to load hash from %s\n", in + 9);
+    } else if (!strncmp(in, "loadparams ", 11)) {
+      ThreadWaitUntilSleep(threads);
+      in[strcspn(in, "\n")] = '\0';
+
+      int count = LoadEvalParams(in + 11);
+      if (count > 0) {
+        board.mat = MaterialValue(&board, board.side) - MaterialValue(&board, board.xside);
+
+        // pawn, material and eval caches all hold scores of the old weights
+        int n = threads->count;
+        FreePool(threads);
+        threads = CreatePool(n);
+        TTClear(threads);
+
+        printf("info string loaded %d eval params from %s\n", count, in + 11);
+      } else {
+        printf("info string FAILED to load eval params from %s\n", in + 11);
+      }
+    } else if (!strncmp(in, "stats", 5)) {
+      ThreadWaitUntilSleep(threads);
+      PrintStats(threads);
+    } else if (!strncmp(in, "profile", 7)) {
+      ThreadWaitUntilSleep(threads);
+      PrintProfile(threads);
     } else if (!strncmp(in, "uci", 3)) {
       PrintUCIOptions();
+    } else if (!strncmp(in, "cpu", 3)) {
+      PrintCPU();
     } else if (!strncmp(in, "board", 5)) {
       PrintBoard(&board);
     } else if (!strncmp(in, "eval", 4)) {
@@ -225,19 +305,70 @@ void UCILoop() {
     } else if (!strncmp(in, "setoption name Hash value ", 26)) {
       int mb = GetOptionIntValue(in);
       mb = max(4, min(65536, mb));
-      size_t bytesAllocated = TTInit(mb);
+      size_t bytesAllocated = TTInit(mb, threads);
       printf("info string set Hash to value %d (%zu bytes)\n", mb, bytesAllocated);
+      printf("info string Hash allocated with %s pages\n", TT.pages);
+    } else if (!strncmp(in, "setoption name MultiPV value ", 29)) {
+      MULTI_PV = max(1, min(MAX_MULTI_PV, GetOptionIntValue(in)));
+      printf("info string set MultiPV to value %d\n", MULTI_PV);
+    } else if (!strncmp(in, "setoption name InfoInterval value ", 34)) {
+      INFO_INTERVAL = max(0, min(5000, GetOptionIntValue(in)));
+      printf("info string set InfoInterval to value %d ms\n", INFO_INTERVAL);
     } else if (!strncmp(in, "setoption name Threads value ", 29)) {
       int n = GetOptionIntValue(in);
-      free(threads);
+      FreePool(threads);
       threads = CreatePool(max(1, min(256, n)));
       printf("info string set Threads to value %d\n", n);
     } else if (!strncmp(in, "setoption name SyzygyPath value ", 32)) {
+      ThreadWaitUntilSleep(threads);
+
       int success = tb_init(in + 32);
+      TBCacheInit(TB_LARGEST ? TB_CACHE_MB : 0);
+      TBPreload(in + 32);
       if (success)
         printf("info string set SyzygyPath to value %s\n", in + 32);
       else
         printf("info string FAILED!\n");
+    } else if (!strncmp(in, "setoption name SyzygyCache value ", 33)) {
+      ThreadWaitUntilSleep(threads);
+
+      TB_CACHE_MB = max(0, min(1024, GetOptionIntValue(in)));
+      TBCacheInit(TB_LARGEST ? TB_CACHE_MB : 0);
+      printf("info string set SyzygyCache to value %d MB\n", TB_CACHE_MB);
+    } else if (!strncmp(in, "setoption name SyzygyPreload value ", 35)) {
+      TB_PRELOAD = max(0, min(7, GetOptionIntValue(in)));
+      printf("info string set SyzygyPreload to value %d\n", TB_PRELOAD);
+
+      TBPreload(NULL);
+    } else if (!strncmp(in, "setoption name SharedHash value ", 32)) {
+      ThreadWaitUntilSleep(threads);
+      in[strcspn(in, "\n")] = '\0';
+
+      char* name = in + 32;
+      if (!strcmp(name, "<empty>"))
+        name = "";
+
+      // shm names must start with a single slash, which leaves room for one more
+      if (strlen(name) > sizeof(TT.sharedName) - 2) {
+        printf("info string FAILED to set SharedHash, names are limited to %zu characters\n",
+               sizeof(TT.sharedName) - 2);
+      } else {
+        char* dst = TT.sharedName;
+        if (name[0] && name[0] != '/')
+          *dst++ = '/';
+        strcpy(dst, name);
+        TTInit(TT.size, threads);
+
+        printf("info string set SharedHash to value %s (%s)\n", TT.sharedName[0] ? TT.sharedName : "<empty>",
+               TT.alloc == TT_ALLOC_SHARED ? "shared" : "private");
+      }
+    } else if (!strncmp(in, "setoption name BookFile value ", 30)) {
+      ThreadWaitUntilSleep(threads);
+
+      if (BookLoad(in + 30))
+        printf("info string set BookFile to value %s (%zu entries)\n", in + 30, BOOK.count);
+      else
+        printf("info string FAILED to load book %s\n", in + 30);
     } else if (!strncmp(in, "setoption name NoobBookLimit value ", 35)) {
       NOOB_DEPTH_LIMIT = min(32, max(0, GetOptionIntValue(in)));
       printf("info string set NoobBookLimit to value %d\n", NOOB_DEPTH_LIMIT);
@@ -247,8 +378,80 @@ void UCILoop() {
 
       NOOB_BOOK = !strncmp(opt, "true", 4);
       printf("info string set NoobBook to value %s\n", NOOB_BOOK ? "true" : "false");
+    } else if (!strncmp(in, "setoption name NoobBookTimeout value ", 37)) {
+      NOOB_TIMEOUT_MS = min(60000, max(100, GetOptionIntValue(in)));
+      printf("info string set NoobBookTimeout to value %d\n", NOOB_TIMEOUT_MS);
+    } else if (!strncmp(in, "setoption name NoobBookCache value ", 35)) {
+      NoobLoadCache(in + 35);
+      printf("info string set NoobBookCache to value %s\n", NOOB_CACHE_FILE[0] ? NOOB_CACHE_FILE : "<empty>");
+    } else if (!strncmp(in, "setoption name EvalHash value ", 30)) {
+      EVAL_HASH_MB = max(1, min(256, GetOptionIntValue(in)));
+
+      // each thread allocates its own table when it is created
+      int n = threads->count;
+      FreePool(threads);
+      threads = CreatePool(n);
+
+      printf("info string set EvalHash to value %d MB per thread\n", EVAL_HASH_MB);
+    } else if (!strncmp(in, "setoption name PawnHash value ", 30)) {
+      PAWN_HASH_MB = max(1, min(256, GetOptionIntValue(in)));
+
+      int n = threads->count;
+      FreePool(threads);
+      threads = CreatePool(n);
+
+      printf("info string set PawnHash to value %d MB per thread\n", PAWN_HASH_MB);
+    } else if (!strncmp(in, "setoption name EvalFile value ", 30)) {
+      ThreadWaitUntilSleep(threads);
+      in[strcspn(in, "\n")] = '\0';
+
+      char* path = in + 30;
+      if (!strcmp(path, "<empty>")) {
+        USE_NNUE = 0;
+        printf("info string set EvalFile to value <empty> (classical eval)\n");
+      } else if (!strcmp(path, "<embedded>") && LoadDefaultNetwork()) {
+        printf("info string set EvalFile to value <embedded>\n");
+      } else if (LoadNetwork(path)) {
+        printf("info string set EvalFile to value %s\n", path);
+      } else {
+        printf("info string FAILED to load network %s\n", path);
+      }
+
+      // cached evals and accumulators belong to the old evaluation
+      int n = threads->count;
+      FreePool(threads);
+      threads = CreatePool(n);
+      TTClear(threads);
+    } else if (!strncmp(in, "setoption name ClusterNodes value ", 34)) {
+      ThreadWaitUntilSleep(threads);
+      in[strcspn(in, "\n")] = '\0';
+
+      char* nodes = in + 34;
+      if (!strcmp(nodes, "<empty>")) {
+        ClusterClose();
+        printf("info string set ClusterNodes to value <empty>\n");
+      } else {
+        printf("info string set ClusterNodes to value %s (%d connected)\n", nodes, ClusterConnect(nodes));
+      }
+    } else if (!strncmp(in, "setoption name NUMA value ", 26)) {
+      char opt[6];
+      sscanf(in, "%*s %*s %*s %*s %5s", opt);
+
+      NUMA = !strncmp(opt, "true", 4);
+
+      // threads are rebound and memory is placed again from scratch
+      int n = threads->count;
+      FreePool(threads);
+      threads = CreatePool(n);
+      TTInit(TT.size, threads);
+
+      printf("info string set NUMA to value %s\n", NUMA ? "true" : "false");
     }
   }
+
+  FreePool(threads);
+  ClusterClose();
+  OutputStop();
 }
 
 int GetOptionIntValue(char* in) {
@@ -14,6 +14,8 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <stdlib.h>
+
 #include "types.h"
 
 #ifdef WIN32
@@ -21,9 +23,16 @@
 
 long GetTimeMS() { return GetTickCount(); }
 
+void SleepMS(int ms) { Sleep(ms); }
+
+void* AlignedMalloc(size_t size) { return _aligned_malloc(size, CACHE_LINE); }
+
+void AlignedFree(void* ptr) { _aligned_free(ptr); }
+
 #else
 #include <stddef.h>
 #include <sys/time.h>
+#include <time.h>
 
 long GetTimeMS() {
   struct timeval time;
@@ -32,4 +41,16 @@ long GetTimeMS() {
   return time.tv_sec * 1000 + time.tv_usec / 1000;
 }
 
+void SleepMS(int ms) {
+  struct timespec duration = {.tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L};
+  nanosleep(&duration, NULL);
+}
+
+// size is rounded up as aligned_alloc requires
+void* AlignedMalloc(size_t size) {
+  return aligned_alloc(CACHE_LINE, (size + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE);
+}
+
+void AlignedFree(void* ptr) { free(ptr); }
+
 #endif
@@ -26,5 +26,8 @@
 #define stringize(x) stringize_(x)
 
 long GetTimeMS();
+void SleepMS(int ms);
+void* AlignedMalloc(size_t size);
+void AlignedFree(void* ptr);
 
 #endif
\ No newline at end of file